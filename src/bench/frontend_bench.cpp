@@ -0,0 +1,218 @@
+//Front end throughput benchmark. Times every phase from Tokenizer::tokenize to Emitter::print
+//separately on a set of synthetic workloads, each stressing one shape of program, and reports MB/s and nodes/s per phase with
+//mean, standard deviation and best of the repetitions.
+//
+//	bin/frontend_bench [reps] [file.forke]
+//
+//With a file only that file is measured.
+
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../include/source.hpp"
+#include "../include/constfold.hpp"
+#include "../include/dce.hpp"
+#include "../include/frame.hpp"
+#include "../include/gvn.hpp"
+#include "../include/typecheck.hpp"
+#include "../include/irbuilder.hpp"
+#include "../include/licm.hpp"
+#include "../include/peephole.hpp"
+#include "../include/promote.hpp"
+#include "../include/regalloc.hpp"
+#include "../include/ssa.hpp"
+#include "../include/strength.hpp"
+#include "../include/vectorize.hpp"
+#include "../include/emitter.hpp"
+#include "./synth.hpp"
+
+struct Workload
+{
+	std::string name;
+	std::string generated;
+	std::string_view src;
+};
+
+struct Samples
+{
+	const char* phase;
+	std::vector<double> secs;
+
+	inline double mean() const {
+		double sum = 0;
+		for (double s : secs)
+			sum += s;
+		return sum / secs.size();
+	}
+
+	inline double stddev() const {
+		if (secs.size() < 2)
+			return 0;
+		const double m = mean();
+		double sum = 0;
+		for (double s : secs)
+			sum += (s - m) * (s - m);
+		return std::sqrt(sum / (secs.size() - 1));
+	}
+
+	inline double best() const {
+		return *std::min_element(secs.begin(), secs.end());
+	}
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point t0) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static Workload synthetic(const std::string& name, void (*shape)(SynthParams&)) {
+	//every shape starts from a small common program and scales one dimension up
+	SynthParams params;
+	params.decls = 200;
+	params.exprs = 2;
+	params.expr_terms = 20;
+	params.nests = 2;
+	params.depth = 10;
+	params.chains = 2;
+	params.chain_len = 10;
+	params.loops = 20;
+	shape(params);
+
+	Workload workload {name, SynthProgram(params).generate(), {}};
+	workload.src = workload.generated;
+	return workload;
+}
+
+static void run(const Workload& workload, int reps) {
+	Samples phases[9] = {{"tokenize", {}}, {"parse", {}}, {"resolve", {}}, {"check", {}}, {"fold", {}}, {"lower", {}}, {"regalloc", {}}, {"select", {}}, {"peephole", {}}};
+	size_t token_count = 0;
+	size_t node_count = 0;
+	size_t asm_bytes = 0;
+
+	for (int r = 0; r < reps; r++)
+	{
+		Interner interner;
+
+		auto t0 = std::chrono::steady_clock::now();
+		Tokenizer tokenizer(workload.src, interner);
+		std::vector<Token> tokens = tokenizer.tokenize();
+		phases[0].secs.push_back(seconds_since(t0));
+
+		token_count = tokens.size();
+
+		t0 = std::chrono::steady_clock::now();
+		Parser parser(std::move(tokens), workload.src);
+		std::optional<Ast*> prog = parser.parse_prog();
+		phases[1].secs.push_back(seconds_since(t0));
+
+		node_count = prog.value()->size();
+
+		t0 = std::chrono::steady_clock::now();
+		Resolver resolver(workload.src);
+		resolver.resolve(prog.value());
+		phases[2].secs.push_back(seconds_since(t0));
+
+		t0 = std::chrono::steady_clock::now();
+		TypeChecker checker(resolver.get_symbols(), workload.src);
+		checker.check(prog.value());
+		phases[3].secs.push_back(seconds_since(t0));
+
+		t0 = std::chrono::steady_clock::now();
+		ConstFolder folder(resolver.get_symbols(), workload.src);
+		folder.fold(prog.value());
+		phases[4].secs.push_back(seconds_since(t0));
+
+		t0 = std::chrono::steady_clock::now();
+		IrBuilder builder(prog.value(), resolver.get_symbols(), workload.src);
+		IrProgram ir = builder.build();
+		StrengthReducer reducer(ir);
+		reducer.reduce();
+		phases[5].secs.push_back(seconds_since(t0));
+
+		t0 = std::chrono::steady_clock::now();
+		SlotPromoter promoter(ir);
+		promoter.promote();
+		DeadCodeEliminator eliminator(ir);
+		eliminator.eliminate();
+		SsaBuilder ssa(ir);
+		ssa.build();
+		ValueNumbering numbering(ir, ssa);
+		numbering.number();
+		ssa.destroy();
+		LoopHoister hoister(ir);
+		hoister.hoist();
+		LoopVectorizer vectorizer(ir, 16);
+		vectorizer.vectorize();
+		FrameLayout frame(ir);
+		frame.layout();
+		RegAlloc alloc(ir);
+		alloc.allocate();
+		phases[6].secs.push_back(seconds_since(t0));
+
+		t0 = std::chrono::steady_clock::now();
+		Emitter emitter(ir, alloc);
+		std::vector<X86Inst> code = emitter.select();
+		phases[7].secs.push_back(seconds_since(t0));
+
+		t0 = std::chrono::steady_clock::now();
+		Peephole peephole;
+		peephole.run(code);
+		const std::string text = emitter.print(code);
+		phases[8].secs.push_back(seconds_since(t0));
+
+		asm_bytes = text.size();
+	}
+
+	std::cout << "== " << workload.name << ": " << workload.src.size() << " bytes, "
+		  << token_count << " tokens, " << node_count << " nodes, " << asm_bytes << " asm bytes\n";
+	std::cout << "phase        mean ms   stddev    cv%   best ms      MB/s  Mnodes/s\n";
+
+	double total = 0;
+	for (const Samples& samples : phases)
+	{
+		const double mean = samples.mean();
+		total += mean;
+
+		char line[160];
+		snprintf(line, sizeof(line), "%-10s %9.3f %8.3f %6.1f %9.3f %9.1f %9.2f\n",
+			 samples.phase, mean * 1e3, samples.stddev() * 1e3, 100 * samples.stddev() / mean,
+			 samples.best() * 1e3, workload.src.size() / mean / (1 << 20), node_count / mean / 1e6);
+		std::cout << line;
+	}
+
+	char line[160];
+	snprintf(line, sizeof(line), "%-10s %9.3f %24s %9.1f %9.2f\n", "total", total * 1e3, "",
+		 workload.src.size() / total / (1 << 20), node_count / total / 1e6);
+	std::cout << line << '\n';
+}
+
+int main(int argc, char** argv) {
+	const int reps = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10;
+
+	if (argc > 2)
+	{
+		SourceFile file(argv[2]);
+		run({argv[2], "", file.view()}, reps);
+		return 0;
+	}
+
+	const Workload workloads[] = {
+		synthetic("declarations", [](SynthParams& p) { p.decls = 50000; }),
+		synthetic("long expressions", [](SynthParams& p) { p.exprs = 200; p.expr_terms = 2000; }),
+		synthetic("nested scopes", [](SynthParams& p) { p.nests = 200; p.depth = 200; }),
+		synthetic("if/elif chains", [](SynthParams& p) { p.chains = 200; p.chain_len = 500; }),
+		synthetic("loops", [](SynthParams& p) { p.loops = 50000; }),
+	};
+
+	std::cout << reps << " repetitions per workload\n\n";
+	for (const Workload& workload : workloads)
+		run(workload, reps);
+
+	return 0;
+}
@@ -0,0 +1,42 @@
+//Writes a synthetic .forke program to stdout.
+//
+//	bin/gen_forke [--decls N] [--exprs N] [--expr-terms N] [--nests N] [--depth N]
+//	              [--chains N] [--chain-len N] [--loops N] [--seed N]
+
+#include <iostream>
+#include <cstdlib>
+#include <string_view>
+
+#include "./synth.hpp"
+
+int main(int argc, char** argv) {
+	SynthParams params;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string_view arg = argv[i];
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Missing value for '" << arg << "'\n";
+			return 1;
+		}
+		const size_t value = std::strtoull(argv[++i], nullptr, 10);
+
+		if      (arg == "--decls")      params.decls = value;
+		else if (arg == "--exprs")      params.exprs = value;
+		else if (arg == "--expr-terms") params.expr_terms = value;
+		else if (arg == "--nests")      params.nests = value;
+		else if (arg == "--depth")      params.depth = value;
+		else if (arg == "--chains")     params.chains = value;
+		else if (arg == "--chain-len")  params.chain_len = value;
+		else if (arg == "--loops")      params.loops = value;
+		else if (arg == "--seed")       params.seed = value;
+		else {
+			std::cerr << "Unknown argument: '" << arg << "'\n";
+			return 1;
+		  }
+	}
+
+	std::cout << SynthProgram(params).generate();
+	return 0;
+}
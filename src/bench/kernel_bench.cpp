@@ -0,0 +1,335 @@
+//Runtime benchmark for the binaries forke produces. Every kernel in the kernel directory is
+//compiled with forke and, as a reference, its .c twin with gcc -O2. Both are checked to agree
+//on output and exit code, then executed repeatedly under perf_event_open counters.
+//Medians are compared against a stored baseline and regressions fail the run.
+//
+//	bin/kernel_bench [--reps N] [--kernels dir] [--forke path] [--baseline file]
+//	                 [--save-baseline] [--threshold pct]
+//
+//--threshold replaces the per metric tolerances in METRIC_THRESHOLDS with one value.
+//
+//Run from out/, the defaults point at bin/forke and ../src/bench/kernels. Hardware counters
+//need a PMU and perf_event_paranoid <= 2; without them cycles, instructions and branch misses
+//show as n/a and only task clock and wall time are compared.
+
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+enum Metric
+{
+	WALL_MS,
+	TASK_MS,
+	CYCLES,
+	INSTRUCTIONS,
+	BRANCH_MISSES,
+	METRIC_COUNT
+};
+
+static const char* METRIC_NAMES[METRIC_COUNT] = {"wall_ms", "task_ms", "cycles", "instructions", "branch_misses"};
+
+//allowed growth over the baseline before a metric counts as regressed, in percent.
+//instruction counts are nearly deterministic, times on a shared box are not.
+static const double METRIC_THRESHOLDS[METRIC_COUNT] = {10, 10, 5, 1, 10};
+
+struct Sample
+{
+	double values[METRIC_COUNT];
+	bool hw;
+	int exit_code;
+};
+
+static long perf_event_open(perf_event_attr* attr, pid_t pid, int group_fd) {
+	return syscall(SYS_perf_event_open, attr, pid, -1, group_fd, 0);
+}
+
+static int open_counter(pid_t pid, uint32_t type, uint64_t config, int group_fd) {
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = group_fd == -1;
+	attr.enable_on_exec = group_fd == -1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+	return perf_event_open(&attr, pid, group_fd);
+}
+
+//Runs exe once with stdout sent to out_path. The child blocks on a pipe until the counters
+//are attached, and they only start counting at its exec.
+static Sample measure(const std::string& exe, const std::string& out_path) {
+	int go[2];
+	if (pipe(go) < 0)
+	{
+		std::cerr << "pipe failed\n";
+		exit(EXIT_FAILURE);
+	}
+
+	const pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(go[1]);
+		char byte;
+		if (read(go[0], &byte, 1) != 1)
+			_exit(127);
+
+		const int fd = open(out_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		dup2(fd, STDOUT_FILENO);
+		execl(exe.c_str(), exe.c_str(), (char*)nullptr);
+		_exit(127);
+	}
+	close(go[0]);
+
+	Sample sample = {};
+	const int hw_leader = open_counter(pid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+	int hw_siblings[2] = {-1, -1};
+	sample.hw = hw_leader >= 0;
+	if (sample.hw)
+	{
+		hw_siblings[0] = open_counter(pid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, hw_leader);
+		hw_siblings[1] = open_counter(pid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, hw_leader);
+	}
+	const int task_clock = open_counter(pid, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, -1);
+
+	const auto t0 = std::chrono::steady_clock::now();
+	if (write(go[1], "x", 1) != 1)
+	{
+		std::cerr << "could not start '" << exe << "'\n";
+		exit(EXIT_FAILURE);
+	}
+	close(go[1]);
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	sample.values[WALL_MS] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	sample.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+	uint64_t group[4] = {};
+	if (sample.hw && read(hw_leader, group, sizeof(group)) > 0)
+	{
+		sample.values[CYCLES] = group[1];
+		sample.values[INSTRUCTIONS] = group[2];
+		sample.values[BRANCH_MISSES] = group[3];
+	}
+	if (task_clock >= 0 && read(task_clock, group, sizeof(group)) > 0)
+		sample.values[TASK_MS] = group[1] / 1e6;
+
+	for (int fd : {hw_leader, hw_siblings[0], hw_siblings[1], task_clock})
+		if (fd >= 0)
+			close(fd);
+
+	return sample;
+}
+
+static double median(std::vector<double> values) {
+	std::sort(values.begin(), values.end());
+	const size_t mid = values.size() / 2;
+	return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+static std::string read_file(const std::string& path) {
+	std::ifstream file(path);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+//baseline lines: <kernel> <metric> <value>
+static std::map<std::string, double> load_baseline(const std::string& path) {
+	std::map<std::string, double> baseline;
+	std::ifstream file(path);
+	std::string kernel, metric;
+	double value;
+	while (file >> kernel >> metric >> value)
+		baseline[kernel + ' ' + metric] = value;
+	return baseline;
+}
+
+static void run_or_die(const std::string& cmd) {
+	if (system(cmd.c_str()) != 0)
+	{
+		std::cerr << "command failed: " << cmd << '\n';
+		exit(EXIT_FAILURE);
+	}
+}
+
+int main(int argc, char** argv) {
+	int reps = 5;
+	std::string kernel_dir = "../src/bench/kernels";
+	std::string forke = "bin/forke";
+	std::string baseline_path;
+	bool save_baseline = false;
+	double threshold = -1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--save-baseline")
+			save_baseline = true;
+		else if (i + 1 < argc && arg == "--reps")
+			reps = std::max(1, std::atoi(argv[++i]));
+		else if (i + 1 < argc && arg == "--kernels")
+			kernel_dir = argv[++i];
+		else if (i + 1 < argc && arg == "--forke")
+			forke = argv[++i];
+		else if (i + 1 < argc && arg == "--baseline")
+			baseline_path = argv[++i];
+		else if (i + 1 < argc && arg == "--threshold")
+			threshold = std::atof(argv[++i]);
+		else {
+			std::cerr << "Unknown argument: '" << arg << "'\n";
+			return 1;
+		  }
+	}
+	if (baseline_path.empty())
+		baseline_path = kernel_dir + "/baseline.txt";
+
+	std::vector<std::string> kernels;
+	for (const fs::directory_entry& entry : fs::directory_iterator(kernel_dir))
+		if (entry.path().extension() == ".forke")
+			kernels.push_back(entry.path().stem());
+	std::sort(kernels.begin(), kernels.end());
+
+	char tmp_template[] = "/tmp/forke_kernels_XXXXXX";
+	const std::string tmp = mkdtemp(tmp_template);
+	fs::create_directory(tmp + "/bin");
+	const std::string forke_abs = fs::absolute(forke);
+	const std::string dir_abs = fs::absolute(kernel_dir);
+
+	const std::map<std::string, double> baseline = load_baseline(baseline_path);
+	std::ostringstream saved;
+	int regressions = 0;
+	bool any_hw = false;
+
+	std::cout << reps << " runs per binary, medians shown\n\n";
+	std::cout << "kernel     variant     wall ms   task ms        cycles  instructions  br misses   vs gcc\n";
+
+	for (const std::string& kernel : kernels)
+	{
+		//forke writes bin/out.asm and bin/out relative to its working directory
+		const std::string forke_exe = tmp + "/" + kernel + "_forke";
+		const std::string c_exe = tmp + "/" + kernel + "_gcc";
+		run_or_die("cd " + tmp + " && " + forke_abs + " " + dir_abs + "/" + kernel + ".forke > /dev/null");
+		fs::rename(tmp + "/bin/out", forke_exe);
+		run_or_die("gcc -O2 " + dir_abs + "/" + kernel + ".c -o " + c_exe);
+
+		const std::string variants[2] = {forke_exe, c_exe};
+		double medians[2][METRIC_COUNT];
+		int exit_codes[2];
+		std::string outputs[2];
+
+		for (int v = 0; v < 2; v++)
+		{
+			const std::string out_path = variants[v] + ".stdout";
+			std::vector<double> values[METRIC_COUNT];
+			bool hw = true;
+
+			for (int r = 0; r < reps; r++)
+			{
+				const Sample sample = measure(variants[v], out_path);
+				for (int m = 0; m < METRIC_COUNT; m++)
+					values[m].push_back(sample.values[m]);
+				hw = hw && sample.hw;
+				exit_codes[v] = sample.exit_code;
+			}
+
+			any_hw = any_hw || hw;
+			outputs[v] = read_file(out_path);
+			for (int m = 0; m < METRIC_COUNT; m++)
+				medians[v][m] = (m >= CYCLES && !hw) ? -1 : median(values[m]);
+		}
+
+		if (exit_codes[0] != exit_codes[1] || outputs[0] != outputs[1])
+		{
+			std::cout << kernel << ": MISMATCH, forke exited " << exit_codes[0] << " and gcc exited " << exit_codes[1]
+				  << (outputs[0] != outputs[1] ? ", outputs differ" : "") << '\n';
+			regressions++;
+		}
+
+		for (int v = 0; v < 2; v++)
+		{
+			char line[200];
+			char counters[3][24];
+			for (int m = CYCLES; m < METRIC_COUNT; m++)
+			{
+				if (medians[v][m] < 0)
+					snprintf(counters[m - CYCLES], sizeof(counters[0]), "n/a");
+				else
+					snprintf(counters[m - CYCLES], sizeof(counters[0]), "%.0f", medians[v][m]);
+			}
+
+			snprintf(line, sizeof(line), "%-10s %-8s %10.2f %9.2f %13s %13s %10s",
+				 v ? "" : kernel.c_str(), v ? "gcc -O2" : "forke",
+				 medians[v][WALL_MS], medians[v][TASK_MS], counters[0], counters[1], counters[2]);
+			std::cout << line;
+			if (v == 0)
+			{
+				snprintf(line, sizeof(line), " %7.1fx", medians[0][TASK_MS] / medians[1][TASK_MS]);
+				std::cout << line;
+			}
+			std::cout << '\n';
+		}
+
+		//only the forke binary is tracked, gcc is there for scale
+		for (int m = 0; m < METRIC_COUNT; m++)
+		{
+			if (medians[0][m] < 0)
+				continue;
+
+			saved << kernel << ' ' << METRIC_NAMES[m] << ' ' << medians[0][m] << '\n';
+
+			auto entry = baseline.find(kernel + ' ' + METRIC_NAMES[m]);
+			if (entry == baseline.end() || entry->second <= 0)
+				continue;
+
+			const double change = 100 * (medians[0][m] / entry->second - 1);
+			if (change > (threshold >= 0 ? threshold : METRIC_THRESHOLDS[m]))
+			{
+				char line[160];
+				snprintf(line, sizeof(line), "           REGRESSION %s %+.1f%% (baseline %.2f)\n", METRIC_NAMES[m], change, entry->second);
+				std::cout << line;
+				regressions++;
+			}
+		}
+	}
+
+	if (!any_hw)
+		std::cout << "\nhardware counters unavailable, only wall and task clock were measured\n";
+
+	if (save_baseline)
+	{
+		std::ofstream(baseline_path) << saved.str();
+		std::cout << "baseline written to " << baseline_path << '\n';
+	}
+	else if (baseline.empty())
+		std::cout << "no baseline at " << baseline_path << ", record one with --save-baseline\n";
+
+	fs::remove_all(tmp);
+
+	if (regressions)
+	{
+		std::cout << regressions << " regression(s)\n";
+		return 1;
+	}
+	return 0;
+}
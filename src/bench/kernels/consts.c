@@ -0,0 +1,12 @@
+/* reference for consts.forke */
+int main(void) {
+	volatile unsigned limit = 3000000;
+	unsigned width = 64, height = 48, scale = 1000 / 8, seconds = 60 * 60 * 24;
+	unsigned i, acc = 0;
+
+	for (i = 0; i < limit; i++) {
+		acc = acc + (i % (width * height)) * scale + seconds % 1000 - (width + height) / 2;
+		acc = acc % 1000003 + (255 - 15) * 2;
+	}
+	return acc % 256;
+}
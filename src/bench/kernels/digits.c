@@ -0,0 +1,21 @@
+/* reference for digits.forke */
+int main(void) {
+	volatile unsigned limit = 1000000;
+	char buf[12];
+	unsigned n, m, k, total = 0;
+
+	for (n = 0; n < limit; n++) {
+		m = n;
+		k = 0;
+		while (m != 0) {
+			buf[k] = (m % 10) + 48;
+			m = m / 10;
+			k++;
+		}
+		while (k != 0) {
+			k--;
+			total = total + buf[k] - 48;
+		}
+	}
+	return total % 256;
+}
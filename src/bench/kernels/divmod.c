@@ -0,0 +1,31 @@
+/* reference for divmod.forke */
+int main(void) {
+	volatile unsigned limit = 60000;
+	unsigned n, x, steps = 0;
+	unsigned i, j, p, q, r, g = 0;
+
+	for (n = 1; n < limit; n++) {
+		x = n;
+		while (x != 1) {
+			if (x % 2 == 0)
+				x = x / 2;
+			else
+				x = x * 3 + 1;
+			steps++;
+		}
+	}
+
+	for (i = 1; i < 500; i++) {
+		for (j = 1; j < 500; j++) {
+			p = i;
+			q = j;
+			while (q != 0) {
+				r = p % q;
+				p = q;
+				q = r;
+			}
+			g = g + p;
+		}
+	}
+	return (steps + g) % 256;
+}
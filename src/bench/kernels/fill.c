@@ -0,0 +1,19 @@
+/* reference for fill.forke */
+int main(void) {
+	volatile unsigned rounds = 1000;
+	unsigned char bytes[4096];
+	unsigned words[1024];
+	unsigned round, i, sum = 0;
+
+	for (round = 0; round < rounds; round++) {
+		for (i = 0; i < 4096; i++)
+			bytes[i] = i + round;
+		for (i = 0; i < 1024; i++)
+			words[i] = i * round;
+		for (i = 0; i < 4096; i++)
+			sum = sum + bytes[i];
+		for (i = 0; i < 1024; i++)
+			sum = sum + words[i];
+	}
+	return sum % 251;
+}
@@ -0,0 +1,30 @@
+/* reference for joins.forke */
+int main(void) {
+	volatile unsigned limit = 3000000;
+	volatile unsigned arr[2];
+	unsigned a, x, c, y, i, n, sum = 0;
+
+	for (n = 0; n < limit; n++) {
+		arr[0] = n % 7;
+		a = arr[0];
+
+		x = a + 1;
+		c = x * 2;
+		if (a > 1) {
+			x = a * c;
+			c = c + x;
+		}
+		y = a + 1;
+		sum = sum + y + c;
+
+		x = a + 1;
+		c = x * 2;
+		for (i = 0; i < a; i++) {
+			x = c + i;
+			c = c + x;
+		}
+		y = a + 1;
+		sum = sum + y + c;
+	}
+	return sum % 256;
+}
@@ -0,0 +1,20 @@
+/* reference for limits.forke */
+int main(void) {
+	volatile unsigned limit = 1000000;
+	volatile unsigned long long wide = 4294967312ULL;
+	volatile unsigned m = 268435457;
+	unsigned A[64];
+	unsigned r, s = 0;
+	int i;
+
+	for (r = 0; r < limit; r++) {
+		for (i = 0; i < (int)(unsigned)wide; i++)
+			A[i] = i * 3 + r;
+
+		for (i = 0; i < (int)(m * 16); i++)
+			A[i + 16] = A[i] + 1;
+
+		s = s + A[r % 32];
+	}
+	return s % 256;
+}
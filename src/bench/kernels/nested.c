@@ -0,0 +1,11 @@
+/* reference for nested.forke */
+int main(void) {
+	volatile unsigned limit = 400;
+	unsigned i, j, k, acc = 0;
+
+	for (i = 0; i < limit; i++)
+		for (j = 0; j < 200; j++)
+			for (k = 0; k < 250; k++)
+				acc = acc + i * j + k;
+	return acc % 256;
+}
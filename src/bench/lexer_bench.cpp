@@ -0,0 +1,305 @@
+//Tokenizer microbenchmark. Reports tokens/sec for Tokenizer::tokenize against the original
+//character at a time tokenizer kept below as the baseline and, on the identifier stream of the
+//same input, for its if/else keyword chain against the LEX_KEYWORD_TABLE probe.
+//
+//	bin/lexer_bench [file.forke] [reps]
+//
+//Without a file a synthetic program is generated in memory.
+
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../include/source.hpp"
+#include "../include/tokenizer.hpp"
+
+static std::string synthetic_source(size_t decls) {
+	std::string out = "/* synthetic lexer input */\nint acc;\nacc = 0;\n";
+	for (size_t i = 0; i < decls; i++)
+	{
+		const std::string v = "value" + std::to_string(i);
+		out += "int " + v + ";   // declaration\n";
+		out += v + " = (acc * 31) + " + std::to_string(i % 1000) + " - 7;\n";
+		out += "if |" + v + " > 500| { acc = acc + " + v + " % 7; } elif |" + v + " == 3| { acc = acc - 1; } else { ++acc; }\n";
+		out += "loop |acc != 0| { acc = acc / 2; }\n";
+		out += "write \"line\"<>;\n";
+	}
+	out += "exit(acc);\n";
+	return out;
+}
+
+static TokenType keyword_chain(std::string_view buf) {
+	if (buf == "exit")
+		return TokenType::exit;
+	else if (buf == "if")
+		return TokenType::_if;
+	else if (buf == "elif")
+		return TokenType::elif;
+	else if (buf == "else")
+		return TokenType::_else;
+	else if (buf == "loop")
+		return TokenType::loop;
+	else if (buf == "write")
+		return TokenType::write;
+	else if (buf == "char"   ||
+		 buf == "int"    ||
+		 buf == "intptr" ||
+		 buf == "charptr" )
+		return TokenType::data_type;
+	return TokenType::ident;
+}
+
+//The tokenizer before the run scanners, operator DFA and keyword table, as it was. Tokens own
+//their text and every character goes through peak() and consume().
+namespace baseline {
+
+struct Token
+{
+	TokenType type;
+	size_t line;
+	std::optional<std::string> value = std::nullopt;
+};
+
+class Tokenizer {
+public:
+	inline Tokenizer(std::string p_src) : m_src(std::move(p_src)), m_index(0), m_line(1) {}
+
+	inline std::vector<Token> tokenize() {
+		std::vector<Token> output;
+
+		std::string buf;
+		while (peak().has_value())
+		{
+			char current = peak().value();
+			if (isspace(current))
+			{
+				if (current == '\n')
+					m_line++;
+				consume();
+			}
+			else if (isalpha(current))
+			{
+				buf.push_back(consume());
+				while (peak().has_value() && isalnum(peak().value()))
+					buf.push_back(consume());
+
+				const TokenType type = keyword_chain(buf);
+				if (type == TokenType::ident || type == TokenType::data_type)
+					output.push_back({type, m_line, buf});
+				else
+					output.push_back({type, m_line});
+				buf.clear();
+			}
+			else if (isdigit(current))
+			{
+				while (peak().has_value() && isdigit(peak().value()))
+					buf.push_back(consume());
+				output.push_back({TokenType::int_lit, m_line, buf});
+				buf.clear();
+			}
+			else if (current == '\'' && peak(2).has_value() && peak(2).value() == '\'')
+			{
+				consume();
+				buf.push_back(consume());
+				output.push_back({TokenType::char_lit, m_line, buf});
+				consume();
+				buf.clear();
+			}
+			else if (current == '\"')
+			{
+				consume();
+				while (peak().has_value() && peak().value() != '\"')
+					buf.push_back(consume());
+				consume();
+				output.push_back({TokenType::str_lit, m_line, buf});
+				buf.clear();
+			}
+			else if (current == '=' && peak(1).has_value() && peak(1).value() == '=')
+			{
+				consume();
+				consume();
+				output.push_back({TokenType::eq_to, m_line});
+			}
+			else if (current == '!' && peak(1).has_value() && peak(1).value() == '=')
+			{
+				consume();
+				consume();
+				output.push_back({TokenType::not_eq_to, m_line});
+			}
+			else if (current == '-' && peak(1).has_value() && peak(1).value() == '>')
+			{
+				consume();
+				consume();
+				output.push_back({TokenType::dref, m_line});
+			}
+			else if (current == '/' && peak(1).has_value() && peak(1).value() == '/')
+			{
+				consume();
+				consume();
+				while (peak().has_value() && peak().value() != '\n')
+					consume();
+			}
+			else if (current == '/' && peak(1).has_value() && peak(1).value() == '*')
+			{
+				consume();
+				consume();
+				auto p1 = peak();
+				auto p2 = peak(1);
+				while (p1.has_value())
+				{
+					if (p1.value() == '*' && p2.has_value() && p2.value() == '/')
+					{
+						consume();
+						consume();
+						break;
+					}
+					consume();
+					p1 = p2;
+					p2 = peak(1);
+				}
+			}
+			else
+			{
+				consume();
+				output.push_back({single(current), m_line});
+			}
+		}
+
+		m_index = 0;
+		return output;
+	}
+
+private:
+	const std::string m_src;
+	size_t m_index;
+	size_t m_line;
+
+	static inline TokenType single(char c) {
+		switch (c)
+		{
+			case ';': return TokenType::semi;
+			case '|': return TokenType::v_bar;
+			case ',': return TokenType::comma;
+			case '(': return TokenType::open_paren;
+			case ')': return TokenType::close_paren;
+			case '{': return TokenType::open_curly;
+			case '}': return TokenType::close_curly;
+			case '=': return TokenType::eq;
+			case '+': return TokenType::plus;
+			case '*': return TokenType::star;
+			case '-': return TokenType::minus;
+			case '/': return TokenType::fslash;
+			case '%': return TokenType::modulo;
+			case '>': return TokenType::g_than;
+			case '<': return TokenType::l_than;
+			case '^': return TokenType::ptr;
+			case '~': return TokenType::tilde;
+			case '&': return TokenType::addr_of;
+			default:
+				std::cerr << "Invalid character '" << c << "'\n";
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	inline std::optional<char> peak(int jump = 0) const {
+		if (m_index + jump >= m_src.length())
+			return std::nullopt;
+		return m_src.at(m_index + jump);
+	}
+
+	inline char consume() {
+		return m_src.at(m_index++);
+	}
+};
+
+}
+
+template <typename Fn>
+static double best_of(int reps, Fn&& fn) {
+	double best = 1e30;
+	for (int r = 0; r < reps; r++)
+	{
+		const auto t0 = std::chrono::steady_clock::now();
+		fn();
+		const auto t1 = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+	}
+	return best;
+}
+
+int main(int argc, char** argv) {
+	std::optional<SourceFile> file;
+	std::string generated;
+	std::string_view src;
+
+	if (argc > 1)
+	{
+		file.emplace(argv[1]);
+		src = file->view();
+	} else {
+		generated = synthetic_source(100000);
+		src = generated;
+	  }
+
+	const int reps = argc > 2 ? std::atoi(argv[2]) : 10;
+
+	size_t token_count = 0;
+	const double lex_time = best_of(reps, [&] {
+		Interner interner;
+		Tokenizer tokenizer(src, interner);
+		token_count = tokenizer.tokenize().size();
+	});
+
+	size_t baseline_count = 0;
+	const double baseline_time = best_of(reps, [&] {
+		baseline::Tokenizer tokenizer{std::string(src)};
+		baseline_count = tokenizer.tokenize().size();
+	});
+	if (baseline_count != token_count)
+	{
+		std::cerr << "baseline tokenizer found " << baseline_count << " tokens, Tokenizer " << token_count << '\n';
+		return 1;
+	}
+
+	//word stream for the keyword comparison: the first alpha-led tokens of the input, kept
+	//small enough to stay in cache so the loop measures classification and not memory
+	std::vector<std::string_view> words;
+	{
+		Interner interner;
+		Tokenizer tokenizer(src, interner);
+		for (const Token& tok : tokenizer.tokenize())
+			if (tok.type == TokenType::ident || tok.type == TokenType::data_type ||
+			    (tok.type >= TokenType::_if && tok.type <= TokenType::write) || tok.type == TokenType::exit)
+				if (words.size() < 4096)
+					words.push_back(token_str(tok, src));
+	}
+
+	const int word_passes = 2000;
+	size_t sink = 0;
+	const double chain_time = best_of(reps, [&] {
+		for (int pass = 0; pass < word_passes; pass++)
+			for (std::string_view w : words)
+				sink += (size_t)keyword_chain(w);
+	}) / word_passes;
+	const double hash_time = best_of(reps, [&] {
+		for (int pass = 0; pass < word_passes; pass++)
+			for (std::string_view w : words)
+				sink += (size_t)lex_keyword(w);
+	}) / word_passes;
+
+	std::cout << "input            " << src.size() << " bytes, " << token_count << " tokens\n"
+		  << "tokenize         " << token_count / lex_time / 1e6 << " Mtok/s, "
+		  << src.size() / lex_time / (1 << 20) << " MB/s\n"
+		  << "baseline         " << token_count / baseline_time / 1e6 << " Mtok/s, "
+		  << src.size() / baseline_time / (1 << 20) << " MB/s, tokenize is "
+		  << baseline_time / lex_time << "x faster\n"
+		  << "keyword chain    " << words.size() / chain_time / 1e6 << " Mword/s\n"
+		  << "keyword hash     " << words.size() / hash_time / 1e6 << " Mword/s\n";
+
+	return sink == 0;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+//Synthetic .forke program generator shared by gen_forke and the benchmarks.
+//Every program it emits type checks and runs: names are unique, loops are counted,
+//and the exit code folds everything into acc.
+
+#include <cstdint>
+#include <random>
+#include <string>
+
+struct SynthParams
+{
+	size_t decls = 1000;            //int declarations, each assigned from acc
+	size_t exprs = 10;              //statements with one long expression each
+	size_t expr_terms = 100;        //binary operands per long expression
+	size_t nests = 10;              //nested scope towers
+	size_t depth = 50;              //scopes per tower
+	size_t chains = 10;             //if/elif/else chains
+	size_t chain_len = 50;          //elif arms per chain
+	size_t loops = 100;             //counted loops
+	uint32_t seed = 1;
+};
+
+class SynthProgram {
+public:
+	inline SynthProgram(const SynthParams& params) : m_params(params), m_rng(params.seed) {}
+
+	inline std::string generate() {
+		m_out = "/* synthetic forke program, seed " + std::to_string(m_params.seed) + " */\n";
+		m_out += "int acc;\nacc = 0;\n";
+
+		for (size_t i = 0; i < m_params.decls; i++)
+			gen_decl(i);
+		for (size_t i = 0; i < m_params.exprs; i++)
+			gen_long_expr();
+		for (size_t i = 0; i < m_params.nests; i++)
+			gen_nest(i);
+		for (size_t i = 0; i < m_params.chains; i++)
+			gen_chain();
+		for (size_t i = 0; i < m_params.loops; i++)
+			gen_loop(i);
+
+		m_out += "exit(acc % 256);\n";
+		return std::move(m_out);
+	}
+
+private:
+	SynthParams m_params;
+	std::mt19937 m_rng;
+	std::string m_out;
+
+	inline uint32_t rand(uint32_t bound) {
+		return m_rng() % bound;
+	}
+
+	//an operand: a literal, acc, or one of the declared values
+	inline std::string operand() {
+		const uint32_t pick = rand(4);
+		if (pick == 0 || m_params.decls == 0)
+			return std::to_string(1 + rand(999));
+		if (pick == 1)
+			return "acc";
+		return "v" + std::to_string(rand(m_params.decls));
+	}
+
+	inline void gen_decl(size_t i) {
+		const std::string v = "v" + std::to_string(i);
+		m_out += "int " + v + ";   // declaration " + std::to_string(i) + "\n";
+		m_out += v + " = (acc * 3) + " + std::to_string(rand(1000)) + " - " + std::to_string(rand(10)) + ";\n";
+	}
+
+	inline void gen_long_expr() {
+		static const char* ops[] = {" + ", " - ", " * ", " % "};
+
+		m_out += "acc = " + operand();
+		for (size_t t = 1; t < m_params.expr_terms; t++)
+		{
+			const char* op = ops[rand(4)];
+			m_out += op;
+			//keep % away from a zero divisor
+			m_out += op[1] == '%' ? std::to_string(2 + rand(97)) : operand();
+		}
+		m_out += ";\n";
+	}
+
+	inline void gen_nest(size_t n) {
+		for (size_t d = 0; d < m_params.depth; d++)
+		{
+			const std::string s = "s" + std::to_string(n) + "d" + std::to_string(d);
+			m_out.append(d, '\t');
+			m_out += "{ int " + s + "; " + s + " = acc + " + std::to_string(d) + ";\n";
+		}
+		for (size_t d = m_params.depth; d-- > 0;)
+		{
+			m_out.append(d, '\t');
+			m_out += "acc = acc + s" + std::to_string(n) + "d" + std::to_string(d) + " % 3; }\n";
+		}
+	}
+
+	inline void gen_chain() {
+		m_out += "if |acc == 0| { acc = acc + 1; }\n";
+		for (size_t i = 1; i <= m_params.chain_len; i++)
+			m_out += "elif |acc % " + std::to_string(i + 1) + " == " + std::to_string(rand(i + 1)) + "| { acc = acc + " + std::to_string(i) + "; }\n";
+		m_out += "else { acc = acc - 1; }\n";
+	}
+
+	inline void gen_loop(size_t i) {
+		const std::string c = "i" + std::to_string(i);
+		m_out += "int " + c + "; " + c + " = 0;\n";
+		m_out += "loop |" + c + " < " + std::to_string(1 + rand(10)) + "| { acc = acc + " + c + "; ++" + c + "; }\n";
+	}
+};
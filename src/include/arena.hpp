@@ -1,35 +1,208 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//Chunked bump allocator. Blocks grow geometrically so no cap has to be guessed up front.
+//alloc<T>() honours alignof(T) and constructs the object in place. Objects that are not
+//trivially destructible get a destructor record, which runs on reset() or destruction.
 class ArenaAllocater {
 public:
-	inline ArenaAllocater(size_t bytes) 
-	       : m_size(0), cap(bytes)
+	struct Stats
+	{
+		size_t used;            //bytes handed out, alignment padding included
+		size_t high_water;      //largest used seen since construction
+		size_t reserved;        //bytes malloc'd across all blocks
+		size_t blocks;
+		size_t wasted;          //alignment padding plus tails abandoned when a block filled up
+	};
+
+	inline ArenaAllocater(size_t first_block = 64 * 1024)
+	       : m_next_block(first_block)
 	{
-		m_arena = static_cast<std::byte*>(malloc(bytes));
 	}
 
 	inline ~ArenaAllocater() {
-		free(m_arena);
-	}	
+		reset();
+
+		Block* block = m_head;
+		while (block)
+		{
+			Block* next = block->next;
+			free(block);
+			block = next;
+		}
+	}
 
 	inline ArenaAllocater(const ArenaAllocater& other) = delete;
 	inline ArenaAllocater operator=(const ArenaAllocater& other) = delete;
 
-	template<typename T>
-	inline T* alloc() {
-		const size_t obj_size = sizeof(T);
+	template<typename T, typename... Args>
+	inline T* alloc(Args&&... args) {
+		void* mem = alloc_bytes(sizeof(T), alignof(T));
+		T* obj = new (mem) T(std::forward<Args>(args)...);
 
-		if (m_size + obj_size > cap) {
-			throw std::bad_alloc();
+		if constexpr (!std::is_trivially_destructible_v<T>)
+		{
+			Dtor* dtor = new (alloc_bytes(sizeof(Dtor), alignof(Dtor))) Dtor;
+			dtor->fn = [](void* p) { static_cast<T*>(p)->~T(); };
+			dtor->obj = obj;
+			dtor->next = m_dtors;
+			m_dtors = dtor;
 		}
 
-		void* obj = m_arena + m_size;
-		m_size += obj_size;
-		
-		return static_cast<T*>(obj); 
+		return obj;
 	}
+
+	inline void* alloc_bytes(size_t size, size_t align) {
+		if (m_current)
+		{
+			const uintptr_t base = reinterpret_cast<uintptr_t>(m_current->data());
+			const size_t start = align_up(base + m_current->used, align) - base;
+			if (start + size <= m_current->cap)
+			{
+				m_stats.wasted += start - m_current->used;
+				bump(start + size - m_current->used);
+				m_current->used = start + size;
+				return m_current->data() + start;
+			}
+		}
+
+		next_block(size + align);
+		return alloc_bytes(size, align);
+	}
+
+	//Runs pending destructors and rewinds to the first block. Blocks are kept for reuse.
+	inline void reset() {
+		while (m_dtors)
+		{
+			m_dtors->fn(m_dtors->obj);
+			m_dtors = m_dtors->next;
+		}
+
+		for (Block* block = m_head; block; block = block->next)
+			block->used = 0;
+
+		m_current = m_head;
+		m_stats.used = 0;
+		m_stats.wasted = 0;
+	}
+
+	inline const Stats& stats() const {
+		return m_stats;
+	}
+
 private:
-	size_t m_size;
-	const size_t cap;
-	std::byte* m_arena;
+	struct Block
+	{
+		Block* next;
+		size_t cap;
+		size_t used;
+
+		inline std::byte* data() {
+			return reinterpret_cast<std::byte*>(this + 1);
+		}
+	};
+
+	struct Dtor
+	{
+		void (*fn)(void*);
+		void* obj;
+		Dtor* next;
+	};
+
+	#define ARENA_MAX_BLOCK (64 * 1024 * 1024)
+
+	Block* m_head = nullptr;
+	Block* m_current = nullptr;
+	Dtor* m_dtors = nullptr;
+	size_t m_next_block;
+	Stats m_stats = {};
+
+	static inline uintptr_t align_up(uintptr_t n, size_t align) {
+		return (n + align - 1) & ~(align - 1);
+	}
+
+	inline void bump(size_t bytes) {
+		m_stats.used += bytes;
+		if (m_stats.used > m_stats.high_water)
+			m_stats.high_water = m_stats.used;
+	}
+
+	//Moves to the next block that fits min_size, reusing blocks kept by reset() first
+	inline void next_block(size_t min_size) {
+		if (m_current)
+			m_stats.wasted += m_current->cap - m_current->used;
+
+		Block* prev = m_current;
+		Block* block = m_current ? m_current->next : m_head;
+		while (block && block->cap < min_size)
+		{
+			m_stats.wasted += block->cap;
+			prev = block;
+			block = block->next;
+		}
+
+		if (!block)
+		{
+			size_t cap = m_next_block;
+			while (cap < min_size)
+				cap *= 2;
+			if (m_next_block < ARENA_MAX_BLOCK)
+				m_next_block *= 2;
+
+			block = static_cast<Block*>(malloc(sizeof(Block) + cap));
+			if (!block)
+				throw std::bad_alloc();
+
+			block->next = nullptr;
+			block->cap = cap;
+			m_stats.reserved += sizeof(Block) + cap;
+			m_stats.blocks++;
+
+			if (prev)
+				prev->next = block;
+			else
+				m_head = block;
+		}
+
+		block->used = 0;
+		m_current = block;
+	}
+};
+
+//std allocator over an ArenaAllocater. Freeing is a no-op, a container's old storage stays
+//in the arena until reset(), so containers must let go of it before the arena is reset.
+template<typename T>
+struct ArenaAdapter
+{
+	using value_type = T;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	ArenaAllocater* arena;
+
+	inline ArenaAdapter(ArenaAllocater* p_arena) : arena(p_arena) {}
+
+	template<typename U>
+	inline ArenaAdapter(const ArenaAdapter<U>& other) : arena(other.arena) {}
+
+	inline T* allocate(size_t n) {
+		return static_cast<T*>(arena->alloc_bytes(n * sizeof(T), alignof(T)));
+	}
+
+	inline void deallocate(T*, size_t) {}
+
+	template<typename U>
+	inline bool operator==(const ArenaAdapter<U>& other) const {
+		return arena == other.arena;
+	}
 };
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAdapter<T>>;
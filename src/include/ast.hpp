@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "./arena.hpp"
+#include "./tokenizer.hpp"
+#include "./types.hpp"
+
+#define NO_NODE UINT32_MAX
+
+enum class EXPRTYPE : uint8_t {
+	RVALUE,
+	LVALUE
+};
+
+//Node layouts, a/b/c are 32 bit child indices unless noted. Unused slots hold NO_NODE.
+enum class NodeKind : uint8_t
+{
+	//EXPRESSIONS
+	term_int,           //a: token
+	term_char,          //a: token
+	term_ident,         //a: token, b: Symbol, c: frame location. b and c are filled in by Resolver
+	term_paren,         //a: expr
+	term_const,         //a: low, b: high 32 bits of a value ConstFolder computed
+
+	bin_add,            //a: lhs, b: rhs
+	bin_sub,
+	bin_multi,
+	bin_div,
+	bin_mod,
+	bin_cmp,            //a: lhs, b: rhs, c: comparison TokenType
+
+	un_dref,            //a: pointer expr, b: offset expr
+	un_increment,       //a: lvalue expr, b: amount expr
+	un_addr,            //a: lvalue expr
+
+	//STATEMENTS
+	stmt_exit,          //a: expr
+	stmt_declare,       //a: token, b: element count, c: pointed DataType. type column holds the declared type
+	stmt_assign,        //a: lvalue expr, b: rvalue expr
+	stmt_scope,         //a: first entry in lists, b: statement count
+	stmt_if,            //a: condition, b: stmt, c: chain
+	stmt_loop,          //a: condition, b: scope stmt
+	stmt_write_expr,    //a: expr, b: byte count expr, c: newline flag
+	stmt_write_str,     //a: token, c: newline flag
+
+	chain_elif,         //a: condition, b: stmt, c: chain
+	chain_else          //b: stmt
+};
+
+//Flat AST. Nodes live in parallel columns and refer to each other by index, so a pass
+//walks a few dense arrays instead of chasing one heap object per node. The columns are
+//allocated from the Ast's own arena, which stays put when the Ast is moved or swapped.
+struct Ast
+{
+	std::unique_ptr<ArenaAllocater> arena = std::make_unique<ArenaAllocater>();
+
+	ArenaVector<NodeKind> kind{arena.get()};
+	ArenaVector<uint32_t> a{arena.get()};
+	ArenaVector<uint32_t> b{arena.get()};
+	ArenaVector<uint32_t> c{arena.get()};
+	ArenaVector<DataType> type{arena.get()};            //filled in by TypeChecker
+	ArenaVector<EXPRTYPE> expr_type{arena.get()};
+
+	ArenaVector<Token> tokens{arena.get()};             //side table for literal and identifier tokens
+	ArenaVector<uint32_t> lists{arena.get()};           //statement lists of scopes
+	ArenaVector<uint32_t> stmts{arena.get()};           //top level statements in order
+
+	inline uint32_t add(NodeKind p_kind, uint32_t p_a = NO_NODE, uint32_t p_b = NO_NODE, uint32_t p_c = NO_NODE) {
+		kind.push_back(p_kind);
+		a.push_back(p_a);
+		b.push_back(p_b);
+		c.push_back(p_c);
+		type.push_back(CHAR);
+		expr_type.push_back(EXPRTYPE::RVALUE);
+
+		return kind.size() - 1;
+	}
+
+	inline uint32_t add_token(const Token& tok) {
+		tokens.push_back(tok);
+		return tokens.size() - 1;
+	}
+
+	inline const Token& token(uint32_t node) const {
+		return tokens[a[node]];
+	}
+
+	inline size_t size() const {
+		return kind.size();
+	}
+
+	//Drops every node and rewinds the arena, streaming reuses one Ast per statement and its
+	//blocks with it
+	inline void clear() {
+		release(kind);
+		release(a);
+		release(b);
+		release(c);
+		release(type);
+		release(expr_type);
+		release(tokens);
+		release(lists);
+		release(stmts);
+		arena->reset();
+	}
+
+	//arena bytes the columns and side tables took at most
+	inline size_t bytes() const {
+		return arena->stats().high_water;
+	}
+
+	inline void reserve(size_t nodes) {
+		kind.reserve(nodes);
+		a.reserve(nodes);
+		b.reserve(nodes);
+		c.reserve(nodes);
+		type.reserve(nodes);
+		expr_type.reserve(nodes);
+	}
+
+private:
+	template<typename T>
+	inline void release(ArenaVector<T>& column) {
+		column = ArenaVector<T>(arena.get());
+	}
+};
@@ -0,0 +1,458 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "./ast.hpp"
+#include "./resolver.hpp"
+
+//Folds constant expressions and propagates constant scalars, runs between TypeChecker and Generator.
+//Values follow the generated code: expressions are computed in 64 bits and wrap there, a store
+//truncates to the variable's TypeTable size and a load zero extends. A foldable subtree becomes
+//term_const. Variables whose address is taken are never tracked, every other store is visible here.
+class ConstFolder {
+public:
+	inline ConstFolder(const std::vector<Symbol>& symbols, std::string_view src) : m_symbols(symbols), m_src(src) {}
+
+	inline void fold(Ast* ast) {
+		m_ast = ast;
+		for (const uint32_t stmt : ast->stmts)
+		{
+			fold_stmt(stmt);
+		}
+	}
+
+	//Streaming: folds one top level statement, known values carry over to the next call
+	inline void fold(Ast* ast, uint32_t stmt) {
+		m_ast = ast;
+		fold_stmt(stmt);
+	}
+
+	//subtrees replaced by a constant so far
+	inline size_t folded() const {
+		return m_folded;
+	}
+
+private:
+	using Known = std::optional<uint64_t>;
+
+	const std::vector<Symbol>& m_symbols;
+	std::string_view m_src;
+	Ast* m_ast = nullptr;
+	size_t m_folded = 0;
+
+	std::vector<Known> m_values;                            //indexed by symbol
+	std::vector<bool> m_escaped;                            //address taken, may change behind our back
+	std::vector<std::pair<uint32_t, Known>> m_trail;        //symbol and the value it had before each set()
+	TypeTable m_Table;
+
+	inline void grow() {
+		if (m_values.size() < m_symbols.size())
+		{
+			m_values.resize(m_symbols.size());
+			m_escaped.resize(m_symbols.size());
+		}
+	}
+
+	inline Known get(uint32_t symbol) {
+		grow();
+		return m_escaped[symbol] ? std::nullopt : m_values[symbol];
+	}
+
+	inline void set(uint32_t symbol, Known value) {
+		grow();
+		if (m_escaped[symbol])
+			value = std::nullopt;
+		if (value.has_value() && m_symbols[symbol].types.type == PTR)
+			value = std::nullopt;
+
+		if (value.has_value())
+		{
+			const uint32_t size = m_Table[m_symbols[symbol].types.type].type_size;
+			if (size < 8)
+				value = value.value() & ((UINT64_C(1) << size * 8) - 1);
+		}
+
+		m_trail.push_back({symbol, m_values[symbol]});
+		m_values[symbol] = value;
+	}
+
+	inline void escape(uint32_t symbol) {
+		grow();
+		set(symbol, std::nullopt);
+		m_escaped[symbol] = true;
+	}
+
+	inline size_t mark() const {
+		return m_trail.size();
+	}
+
+	//Rolls every set() since mark back
+	inline void undo(size_t mark) {
+		while (m_trail.size() > mark)
+		{
+			m_values[m_trail.back().first] = m_trail.back().second;
+			m_trail.pop_back();
+		}
+	}
+
+	//Values the symbols set since mark ended up with
+	inline std::vector<std::pair<uint32_t, Known>> changes(size_t mark) const {
+		std::vector<std::pair<uint32_t, Known>> out;
+		for (size_t i = mark; i < m_trail.size(); i++)
+			out.push_back({m_trail[i].first, m_values[m_trail[i].first]});
+		return out;
+	}
+
+	//The symbol a plain variable lvalue names, NO_NODE for stores through a pointer
+	inline uint32_t lvalue_symbol(uint32_t expr) const {
+		const Ast& ast = *m_ast;
+		while (ast.kind[expr] == NodeKind::term_paren)
+			expr = ast.a[expr];
+
+		return ast.kind[expr] == NodeKind::term_ident ? ast.b[expr] : NO_NODE;
+	}
+
+	//STMTS
+	inline void fold_stmt(uint32_t stmt) {
+		Ast& ast = *m_ast;
+		const uint32_t a = ast.a[stmt];
+		const uint32_t b = ast.b[stmt];
+
+		switch (ast.kind[stmt])
+		{
+			case NodeKind::stmt_exit:
+				fold_expr(a);
+				break;
+
+			case NodeKind::stmt_declare:
+				//a fresh symbol, nothing could have set it yet so it starts out unknown
+				break;
+
+			case NodeKind::stmt_assign:
+				//the generator evaluates the lvalue first, then the rvalue
+				fold_expr(a);
+				if (b != NO_NODE)
+				{
+					const Known value = fold_expr(b);
+					const uint32_t symbol = lvalue_symbol(a);
+					if (symbol != NO_NODE)
+						set(symbol, value);
+				}
+				break;
+
+			case NodeKind::stmt_scope:
+				for (uint32_t i = a; i < a + b; i++)
+				{
+					fold_stmt(ast.lists[i]);
+				}
+				break;
+
+			case NodeKind::stmt_if:
+				fold_if(stmt);
+				break;
+
+			case NodeKind::stmt_loop:
+				fold_loop(stmt);
+				break;
+
+			case NodeKind::stmt_write_expr:
+				fold_expr(a);
+				if (b != NO_NODE)
+					fold_expr(b);
+				break;
+
+			case NodeKind::stmt_write_str:
+				break;
+
+			default:
+				std::cerr << "Expected a statement node\n";
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	//Every arm starts from the state after its condition, afterwards a variable keeps a
+	//value only if all arms, and the fall through when there is no else, agree on it
+	inline void fold_if(uint32_t stmt) {
+		Ast& ast = *m_ast;
+		std::vector<std::vector<std::pair<uint32_t, Known>>> arms;
+		bool has_else = false;
+
+		fold_expr(ast.a[stmt]);
+		for (uint32_t arm = stmt; arm != NO_NODE; arm = ast.c[arm])
+		{
+			if (ast.kind[arm] == NodeKind::chain_else)
+				has_else = true;
+			else if (arm != stmt)
+			{
+				//later conditions only run on some paths, what they change is lost
+				const size_t before = mark();
+				fold_expr(ast.a[arm]);
+				for (const auto& [symbol, value] : changes(before))
+					set(symbol, std::nullopt);
+			}
+
+			const size_t before = mark();
+			fold_stmt(ast.b[arm]);
+			arms.push_back(changes(before));
+			undo(before);
+
+			if (has_else)
+				break;
+		}
+
+		if (!has_else)
+			arms.emplace_back();
+
+		struct Merge
+		{
+			Known value;
+			size_t arms;            //arms that set the symbol
+			size_t last_arm;
+		};
+
+		std::unordered_map<uint32_t, Merge> merged;
+		for (size_t i = 0; i < arms.size(); i++)
+		{
+			for (const auto& [symbol, value] : arms[i])
+			{
+				auto [entry, inserted] = merged.try_emplace(symbol, Merge{value, 0, SIZE_MAX});
+				//a symbol set twice in one arm shows up twice with the same final value
+				if (entry->second.last_arm == i)
+					continue;
+
+				if (!inserted && entry->second.value != value)
+					entry->second.value = std::nullopt;
+				entry->second.arms++;
+				entry->second.last_arm = i;
+			}
+		}
+
+		for (const auto& [symbol, entry] : merged)
+		{
+			Known value = entry.value;
+			//arms that left the symbol alone carry its current value
+			if (entry.arms < arms.size() && get(symbol) != value)
+				value = std::nullopt;
+			set(symbol, value);
+		}
+	}
+
+	//Anything the loop stores to is unknown on entry, the body then sees only values that hold
+	//on every iteration. Since nothing the loop changes stays known, the state after it is the entry state.
+	inline void fold_loop(uint32_t stmt) {
+		Ast& ast = *m_ast;
+		kill_stores(ast.a[stmt]);
+		kill_stores(ast.b[stmt]);
+
+		const size_t before = mark();
+		fold_expr(ast.a[stmt]);
+		fold_stmt(ast.b[stmt]);
+		undo(before);
+	}
+
+	//Forgets every variable a subtree assigns, increments or takes the address of
+	inline void kill_stores(uint32_t node) {
+		Ast& ast = *m_ast;
+		std::vector<uint32_t> work = {node};
+
+		while (!work.empty())
+		{
+			const uint32_t n = work.back();
+			work.pop_back();
+
+			uint32_t children[3] = {ast.a[n], ast.b[n], ast.c[n]};
+			switch (ast.kind[n])
+			{
+				case NodeKind::term_int:
+				case NodeKind::term_char:
+				case NodeKind::term_ident:
+				case NodeKind::term_const:
+				case NodeKind::stmt_declare:
+				case NodeKind::stmt_write_str:
+					continue;
+
+				case NodeKind::stmt_assign:
+				case NodeKind::un_increment:
+					if (lvalue_symbol(ast.a[n]) != NO_NODE)
+						set(lvalue_symbol(ast.a[n]), std::nullopt);
+					break;
+
+				case NodeKind::un_addr:
+					if (lvalue_symbol(ast.a[n]) != NO_NODE)
+						escape(lvalue_symbol(ast.a[n]));
+					break;
+
+				case NodeKind::bin_cmp:
+				case NodeKind::stmt_write_expr:
+					children[2] = NO_NODE;
+					break;
+
+				case NodeKind::stmt_scope:
+					for (uint32_t i = ast.a[n]; i < ast.a[n] + ast.b[n]; i++)
+						work.push_back(ast.lists[i]);
+					continue;
+
+				default:
+					break;
+			}
+
+			for (const uint32_t child : children)
+				if (child != NO_NODE)
+					work.push_back(child);
+		}
+	}
+
+	//Exprs
+	inline Known literal(uint32_t expr) const {
+		const std::string_view text = token_str(m_ast->token(expr), m_src);
+		uint64_t value;
+		const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+		if (error != std::errc() || end != text.data() + text.size())
+			return std::nullopt;
+
+		return value;
+	}
+
+	//Folds the subtree and returns its value when it is known. Children are visited in the
+	//order the generator evaluates them, so increments are seen where they happen.
+	inline Known fold_expr(uint32_t expr) {
+		Ast& ast = *m_ast;
+		const uint32_t a = ast.a[expr];
+		const uint32_t b = ast.b[expr];
+		const bool rvalue = ast.expr_type[expr] == EXPRTYPE::RVALUE;
+		Known value;
+
+		switch (ast.kind[expr])
+		{
+			case NodeKind::term_int:
+				return literal(expr);
+
+			case NodeKind::term_char:
+				return (uint64_t)(int)token_str(ast.token(expr), m_src)[0];
+
+			case NodeKind::term_const:
+				return (uint64_t)b << 32 | a;
+
+			case NodeKind::term_ident:
+				if (!rvalue)
+					return std::nullopt;
+				value = get(b);
+				break;
+
+			case NodeKind::term_paren:
+				value = fold_expr(a);
+				break;
+
+			case NodeKind::bin_add:
+			case NodeKind::bin_sub:
+			case NodeKind::bin_multi:
+			case NodeKind::bin_div:
+			case NodeKind::bin_mod:
+			case NodeKind::bin_cmp:
+			{
+				const Known rhs = fold_expr(b);
+				const Known lhs = fold_expr(a);
+				if (lhs.has_value() && rhs.has_value())
+					value = binary(expr, lhs.value(), rhs.value());
+				break;
+			}
+
+			case NodeKind::un_dref:
+				fold_expr(a);
+				if (b != NO_NODE)
+					fold_expr(b);
+				return std::nullopt;
+
+			case NodeKind::un_increment:
+			{
+				fold_expr(a);
+				Known amount = 1;
+				if (b != NO_NODE)
+					amount = fold_expr(b);
+
+				const uint32_t symbol = lvalue_symbol(a);
+				if (symbol != NO_NODE)
+				{
+					const Known old = get(symbol);
+					set(symbol, old.has_value() && amount.has_value() ? Known(old.value() + amount.value()) : std::nullopt);
+				}
+				return std::nullopt;
+			}
+
+			case NodeKind::un_addr:
+				fold_expr(a);
+				if (lvalue_symbol(a) != NO_NODE)
+					escape(lvalue_symbol(a));
+				return std::nullopt;
+
+			default:
+				std::cerr << "Expected an expression node\n";
+				exit(EXIT_FAILURE);
+		}
+
+		if (value.has_value())
+		{
+			ast.kind[expr] = NodeKind::term_const;
+			ast.a[expr] = (uint32_t)value.value();
+			ast.b[expr] = (uint32_t)(value.value() >> 32);
+			ast.c[expr] = NO_NODE;
+			m_folded++;
+		}
+		return value;
+	}
+
+	//Same results as the instructions the backends emit for the node
+	inline Known binary(uint32_t expr, uint64_t lhs, uint64_t rhs) const {
+		switch (m_ast->kind[expr])
+		{
+			case NodeKind::bin_add:
+				return lhs + rhs;
+			case NodeKind::bin_sub:
+				return lhs - rhs;
+			case NodeKind::bin_multi:
+				return lhs * rhs;
+			case NodeKind::bin_div:
+				//leave the fault to run time
+				if (rhs == 0)
+					return std::nullopt;
+				return lhs / rhs;
+			case NodeKind::bin_mod:
+				if (rhs == 0)
+					return std::nullopt;
+				return lhs % rhs;
+			case NodeKind::bin_cmp:
+			{
+				//at the width of the wider side, ints signed
+				const DataType type = std::max(m_ast->type[m_ast->a[expr]], m_ast->type[m_ast->b[expr]]);
+				if (type != PTR)
+				{
+					const uint64_t mask = (UINT64_C(1) << m_Table[type].type_size * 8) - 1;
+					lhs &= mask;
+					rhs &= mask;
+				}
+				const bool is_signed = type == INT;
+
+				switch ((TokenType)m_ast->c[expr])
+				{
+					case TokenType::g_than:
+						return is_signed ? (int32_t)lhs > (int32_t)rhs : lhs > rhs;
+					case TokenType::l_than:
+						return is_signed ? (int32_t)lhs < (int32_t)rhs : lhs < rhs;
+					case TokenType::eq_to:
+						return lhs == rhs;
+					case TokenType::not_eq_to:
+						return lhs != rhs;
+					default:
+						return std::nullopt;
+				}
+			}
+			default:
+				return std::nullopt;
+		}
+	}
+};
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "./ir.hpp"
+#include "./types.hpp"
+
+//Removes what cannot run or cannot matter. Runs after SlotPromoter, so stores to promoted
+//variables are plain definitions of virtual registers:
+//
+//	- a br on two constants becomes a jmp
+//	- blocks the entry does not reach are dropped and the rest renumbered in order
+//	- stores to slots that are never loaded and whose address is never taken
+//	- instructions without side effects whose result is not live where they set it, found
+//	  with the same per register walk over predecessors RegAlloc uses, repeated while a
+//	  round removes something since that can leave the operands dead too
+//
+//div and mod may fault and load goes through a pointer that may be bad, those always stay.
+class DeadCodeEliminator {
+public:
+	inline DeadCodeEliminator(IrProgram& prog) : m_prog(prog) {}
+
+	//No side effects and cannot fault, dropped when nothing reads the result
+	static inline bool pure(IrOp op) {
+		switch (op)
+		{
+			case IrOp::imm:
+			case IrOp::copy:
+			case IrOp::zext:
+			case IrOp::slot_addr:
+			case IrOp::load_slot:
+			case IrOp::add:
+			case IrOp::sub:
+			case IrOp::mul:
+			case IrOp::and_:
+			case IrOp::mulhi:
+			case IrOp::shl:
+			case IrOp::shr:
+			case IrOp::set:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	//Returns the number of instructions removed
+	inline uint32_t eliminate() {
+		fold_branches();
+		remove_unreachable();
+		remove_dead_stores();
+
+		number_preds();
+		while (remove_dead())
+			;
+
+		return m_removed;
+	}
+
+private:
+	IrProgram& m_prog;
+	uint32_t m_removed = 0;
+	TypeTable m_Table;
+
+	std::vector<uint32_t> m_pred_start;     //predecessors of b are m_preds[m_pred_start[b], m_pred_start[b + 1])
+	std::vector<uint32_t> m_preds;
+
+	//Same rules as the cmp the Emitter picks for the condition
+	inline bool holds(IrCond cond, DataType type, uint64_t a, uint64_t b) const {
+		if (type != PTR)
+		{
+			const uint64_t mask = (UINT64_C(1) << m_Table[type].type_size * 8) - 1;
+			a &= mask;
+			b &= mask;
+		}
+
+		switch (cond)
+		{
+			case IrCond::eq:  return a == b;
+			case IrCond::ne:  return a != b;
+			case IrCond::ult: return a < b;
+			case IrCond::ugt: return a > b;
+			case IrCond::slt: return (int32_t)a < (int32_t)b;
+			case IrCond::sgt: return (int32_t)a > (int32_t)b;
+		}
+		return false;
+	}
+
+	inline void fold_branches() {
+		const uint32_t count = m_prog.vregs.size();
+		std::vector<uint32_t> defs(count, 0);
+		std::vector<int64_t> value(count, 0);
+		for (const IrBlock& block : m_prog.blocks)
+			for (const IrInst& inst : block.insts)
+				if (inst.dst != NO_VREG && defs[inst.dst]++ == 0)
+					value[inst.dst] = inst.op == IrOp::imm ? inst.imm : 0;
+
+		std::vector<bool> known(count, false);
+		for (const IrBlock& block : m_prog.blocks)
+			for (const IrInst& inst : block.insts)
+				if (inst.op == IrOp::imm && defs[inst.dst] == 1)
+					known[inst.dst] = true;
+
+		for (IrBlock& block : m_prog.blocks)
+		{
+			IrTerm& term = block.term;
+			if (term.kind != IrTermKind::br || !known[term.a] || !known[term.b])
+				continue;
+
+			const uint32_t target = holds(term.cond, term.type, value[term.a], value[term.b]) ? term.target : term.other;
+			term = {.kind = IrTermKind::jmp, .target = target};
+		}
+	}
+
+	inline void remove_unreachable() {
+		const uint32_t blocks = m_prog.blocks.size();
+		std::vector<uint32_t> renumber(blocks, NO_BLOCK);
+		std::vector<uint32_t> work = {0};
+		renumber[0] = 0;
+		while (!work.empty())
+		{
+			const uint32_t b = work.back();
+			work.pop_back();
+
+			const auto [first, second] = m_prog.successors(b);
+			for (const uint32_t succ : {first, second})
+				if (succ != NO_BLOCK && renumber[succ] == NO_BLOCK)
+				{
+					renumber[succ] = 0;
+					work.push_back(succ);
+				}
+		}
+
+		uint32_t kept = 0;
+		for (uint32_t b = 0; b < blocks; b++)
+		{
+			if (renumber[b] == NO_BLOCK)
+			{
+				m_removed += m_prog.blocks[b].insts.size();
+				continue;
+			}
+			renumber[b] = kept;
+			if (kept != b)
+				m_prog.blocks[kept] = std::move(m_prog.blocks[b]);
+			kept++;
+		}
+		m_prog.blocks.resize(kept);
+
+		for (IrBlock& block : m_prog.blocks)
+		{
+			if (block.term.target != NO_BLOCK)
+				block.term.target = renumber[block.term.target];
+			if (block.term.other != NO_BLOCK)
+				block.term.other = renumber[block.term.other];
+		}
+	}
+
+	inline void remove_dead_stores() {
+		std::vector<bool> read(m_prog.slots.size(), false);
+		for (const IrBlock& block : m_prog.blocks)
+			for (const IrInst& inst : block.insts)
+				if (inst.op == IrOp::load_slot || inst.op == IrOp::slot_addr)
+					read[inst.imm] = true;
+
+		for (IrBlock& block : m_prog.blocks)
+		{
+			const size_t before = block.insts.size();
+			std::erase_if(block.insts, [&](const IrInst& inst) {
+				return inst.op == IrOp::store_slot && !read[inst.imm];
+			});
+			m_removed += before - block.insts.size();
+		}
+	}
+
+	inline void number_preds() {
+		const uint32_t blocks = m_prog.blocks.size();
+		m_pred_start.assign(blocks + 1, 0);
+		for (uint32_t b = 0; b < blocks; b++)
+		{
+			const auto [first, second] = m_prog.successors(b);
+			if (first != NO_BLOCK)
+				m_pred_start[first + 1]++;
+			if (second != NO_BLOCK && second != first)
+				m_pred_start[second + 1]++;
+		}
+		for (uint32_t b = 0; b < blocks; b++)
+			m_pred_start[b + 1] += m_pred_start[b];
+
+		m_preds.resize(m_pred_start[blocks]);
+		std::vector<uint32_t> fill(m_pred_start.begin(), m_pred_start.end() - 1);
+		for (uint32_t b = 0; b < blocks; b++)
+		{
+			const auto [first, second] = m_prog.successors(b);
+			if (first != NO_BLOCK)
+				m_preds[fill[first]++] = b;
+			if (second != NO_BLOCK && second != first)
+				m_preds[fill[second]++] = b;
+		}
+	}
+
+	//{block, vreg} for every register live into a block, sorted
+	inline std::vector<std::pair<uint32_t, uint32_t>> live_ins() const {
+		const uint32_t count = m_prog.vregs.size();
+		const uint32_t blocks = m_prog.blocks.size();
+		std::vector<std::pair<uint32_t, uint32_t>> exposed;
+		std::vector<std::pair<uint32_t, uint32_t>> def_in;
+		std::vector<uint32_t> def_block(count, NO_BLOCK);
+		std::vector<uint32_t> seen_in(count, NO_BLOCK);
+
+		for (uint32_t b = 0; b < blocks; b++)
+		{
+			auto use = [&](uint32_t v) {
+				if (v != NO_VREG && def_block[v] != b && seen_in[v] != b)
+				{
+					seen_in[v] = b;
+					exposed.push_back({v, b});
+				}
+			};
+
+			for (const IrInst& inst : m_prog.blocks[b].insts)
+			{
+				use(inst.a);
+				use(inst.b);
+				use(inst.index);
+				if (inst.dst != NO_VREG && def_block[inst.dst] != b)
+				{
+					def_block[inst.dst] = b;
+					def_in.push_back({inst.dst, b});
+				}
+			}
+			use(m_prog.blocks[b].term.a);
+			use(m_prog.blocks[b].term.b);
+		}
+
+		std::sort(exposed.begin(), exposed.end());
+		std::sort(def_in.begin(), def_in.end());
+
+		std::vector<std::pair<uint32_t, uint32_t>> live;
+		std::vector<uint32_t> defines(blocks, NO_VREG);
+		std::vector<uint32_t> live_in(blocks, NO_VREG);
+		std::vector<uint32_t> work;
+
+		size_t d = 0;
+		for (size_t e = 0; e < exposed.size();)
+		{
+			const uint32_t v = exposed[e].first;
+			for (; d < def_in.size() && def_in[d].first <= v; d++)
+				if (def_in[d].first == v)
+					defines[def_in[d].second] = v;
+
+			for (; e < exposed.size() && exposed[e].first == v; e++)
+			{
+				live_in[exposed[e].second] = v;
+				work.push_back(exposed[e].second);
+			}
+
+			while (!work.empty())
+			{
+				const uint32_t b = work.back();
+				work.pop_back();
+				live.push_back({b, v});
+
+				for (uint32_t p = m_pred_start[b]; p < m_pred_start[b + 1]; p++)
+				{
+					const uint32_t pred = m_preds[p];
+					if (defines[pred] != v && live_in[pred] != v)
+					{
+						live_in[pred] = v;
+						work.push_back(pred);
+					}
+				}
+			}
+		}
+
+		std::sort(live.begin(), live.end());
+		return live;
+	}
+
+	inline bool remove_dead() {
+		const std::vector<std::pair<uint32_t, uint32_t>> live_in = live_ins();
+		const uint32_t blocks = m_prog.blocks.size();
+		std::vector<size_t> first(blocks + 1, live_in.size());
+		for (size_t i = live_in.size(); i-- > 0;)
+			first[live_in[i].first] = i;
+		for (uint32_t b = blocks; b-- > 0;)
+			first[b] = std::min(first[b], first[b + 1]);
+
+		std::vector<uint32_t> live(m_prog.vregs.size(), NO_BLOCK);        //block it is live at the current point of
+		std::vector<bool> dead;
+		bool removed = false;
+
+		for (uint32_t b = 0; b < blocks; b++)
+		{
+			IrBlock& block = m_prog.blocks[b];
+			auto mark = [&](uint32_t v) {
+				if (v != NO_VREG)
+					live[v] = b;
+			};
+
+			const auto [s1, s2] = m_prog.successors(b);
+			for (const uint32_t succ : {s1, s2})
+				if (succ != NO_BLOCK)
+					for (size_t i = first[succ]; i < first[succ + 1]; i++)
+						mark(live_in[i].second);
+			mark(block.term.a);
+			mark(block.term.b);
+
+			dead.assign(block.insts.size(), false);
+			uint32_t dead_here = 0;
+			for (size_t i = block.insts.size(); i-- > 0;)
+			{
+				const IrInst& inst = block.insts[i];
+				if (inst.dst != NO_VREG)
+				{
+					if (pure(inst.op) && live[inst.dst] != b)
+					{
+						dead[i] = true;
+						dead_here++;
+						continue;
+					}
+					live[inst.dst] = NO_BLOCK;
+				}
+				mark(inst.a);
+				mark(inst.b);
+				mark(inst.index);
+			}
+
+			if (dead_here)
+			{
+				size_t kept = 0;
+				for (size_t i = 0; i < block.insts.size(); i++)
+					if (!dead[i])
+						block.insts[kept++] = block.insts[i];
+				block.insts.resize(kept);
+				m_removed += dead_here;
+				removed = true;
+			}
+		}
+
+		return removed;
+	}
+};
@@ -0,0 +1,704 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "./ir.hpp"
+#include "./regalloc.hpp"
+#include "./types.hpp"
+#include "./x86.hpp"
+
+//Lowers an allocated IrProgram to x86-64 instructions. rsp is set once at _start and is the
+//base of the frame:
+//
+//	[rsp, rsp + spills)             spilled virtual registers, one qword each
+//	[rsp + spills, + saves)         rcx, rsi and rdi around a write, when the program writes
+//	[rsp + slots, + frame_size)     the slots as FrameLayout put them, slots rounded up to 16
+//
+//Operands are used where RegAlloc put them, a spilled one goes through rax when the
+//instruction needs a register. rax and rdx are also div's and mul's, r11 holds a constant
+//operand of either.
+//
+//The v ops are SSE2 on xmm registers, or AVX2 on ymm ones when the program's vectors are 32
+//bytes. xmm13 to xmm15 are scratch, SSE2 has no dword multiply so vmul goes through pmuludq.
+class Emitter {
+public:
+	inline Emitter(const IrProgram& prog, const RegAlloc& alloc) : m_prog(prog), m_alloc(alloc) {}
+
+	inline std::vector<X86Inst> select() {
+		m_saves = m_alloc.spill_slots() * 8;
+		m_slots = (m_saves + (writes() ? 3 * 8 : 0) + 15) / 16 * 16;
+
+		if (frame_bytes())
+			inst(X86Op::sub, x86_reg(RSP), x86_imm(frame_bytes()));
+		for (const uint32_t v : m_alloc.zero_init())
+			if (in_reg(v))
+				inst(X86Op::xor_, x86_reg(m_alloc.reg(v), 4), x86_reg(m_alloc.reg(v), 4));
+			else
+				inst(X86Op::mov, operand(v), x86_imm(0));
+
+		for (uint32_t b = 0; b < m_prog.blocks.size(); b++)
+		{
+			inst(X86Op::label, x86_block(b));
+			for (const IrInst& ir : m_prog.blocks[b].insts)
+			{
+				emit_inst(ir);
+				m_pos += 2;
+			}
+			emit_term(m_prog.blocks[b].term);
+			m_pos += 2;
+		}
+
+		return std::move(m_code);
+	}
+
+	inline std::string print(const std::vector<X86Inst>& code) const {
+		std::stringstream output;
+		output << "section .text\n\tglobal _start\n_start:\n";
+		for (const X86Inst& inst : code)
+			inst.print(output, avx2());
+
+		output << "\n\nsection .data\n";
+		for (size_t i = 0; i < m_prog.messages.size(); i++)
+		{
+			output << "\tmsg" << i << " db '" << m_prog.messages[i].text << "'";
+			if (m_prog.messages[i].nl)
+				output << " , 0xA";
+			output << '\n';
+		}
+
+		return output.str();
+	}
+
+private:
+	const IrProgram& m_prog;
+	const RegAlloc& m_alloc;
+	std::vector<X86Inst> m_code;
+
+	uint32_t m_saves = 0;                   //offset of the save area
+	uint32_t m_slots = 0;                   //offset of the slots
+	uint32_t m_pos = 0;                     //read position of the instruction being emitted, as RegAlloc numbers them
+	size_t m_next_range[NO_OF_REGS] = {};   //first range of a register that may still be live
+	TypeTable m_Table;
+
+	inline void inst(X86Op op, X86Operand dst = {}, X86Operand src = {}, X86Cond cond = X86Cond::e) {
+		m_code.push_back({op, dst, src, cond});
+	}
+
+	//pshufd and the AVX2 halves, imm is the third operand
+	inline void shuffle(X86Op op, X86Operand dst, X86Operand src, uint8_t imm) {
+		m_code.push_back({.op = op, .dst = dst, .src = src, .imm = imm});
+	}
+
+	inline uint32_t frame_bytes() const {
+		return m_slots + m_prog.frame_size;
+	}
+
+	inline bool writes() const {
+		for (const IrBlock& block : m_prog.blocks)
+			for (const IrInst& inst : block.insts)
+				if (inst.op == IrOp::write || inst.op == IrOp::write_str)
+					return true;
+		return false;
+	}
+
+	inline uint8_t size_of(DataType type) const {
+		return m_Table[type].type_size;
+	}
+
+	inline X86Operand slot(int64_t s, uint8_t size) const {
+		return x86_mem(RSP, m_slots + m_prog.slots[s].offset, size);
+	}
+
+	inline bool in_reg(uint32_t v) const {
+		return m_alloc.reg(v) != NO_REG;
+	}
+
+	inline bool in_mem(uint32_t v) const {
+		return !in_reg(v) && !m_alloc.is_const(v);
+	}
+
+	//The value as a 64 bit source operand: register, immediate or frame qword
+	inline X86Operand operand(uint32_t v) const {
+		if (in_reg(v))
+			return x86_reg(m_alloc.reg(v));
+		if (m_alloc.is_const(v))
+			return x86_imm(m_alloc.const_value(v));
+		return x86_mem(RSP, m_alloc.spill(v) * 8, 8);
+	}
+
+	//Register the result of v is computed in, rax when v lives in memory
+	inline uint8_t target(uint32_t v) const {
+		return in_reg(v) ? m_alloc.reg(v) : (uint8_t)RAX;
+	}
+
+	//Stores a result computed in rax to a spilled v
+	inline void writeback(uint32_t v, uint8_t reg) {
+		if (!in_reg(v))
+			inst(X86Op::mov, operand(v), x86_reg(reg));
+	}
+
+	inline void move_to(uint8_t reg, uint32_t v) {
+		if (in_reg(v) && m_alloc.reg(v) == reg)
+			return;
+		inst(X86Op::mov, x86_reg(reg), operand(v));
+	}
+
+	//Loads of the size of the access zero extend
+	inline void load_mem(uint8_t reg, const X86Operand& address) {
+		switch (address.size)
+		{
+			case 1:
+				inst(X86Op::movzx, x86_reg(reg, 4), address);
+				break;
+			case 4:
+				inst(X86Op::mov, x86_reg(reg, 4), address);
+				break;
+			default:
+				inst(X86Op::mov, x86_reg(reg), address);
+		}
+	}
+
+	//Truncating store of v, through scratch when v is in memory
+	inline void store_mem(const X86Operand& address, uint32_t v, uint8_t scratch) {
+		if (m_alloc.is_const(v))
+		{
+			inst(X86Op::mov, address, x86_imm(truncate(m_alloc.const_value(v), address.size)));
+			return;
+		}
+
+		uint8_t reg = m_alloc.reg(v);
+		if (reg == NO_REG)
+		{
+			inst(X86Op::mov, x86_reg(scratch), operand(v));
+			reg = scratch;
+		}
+		inst(X86Op::mov, address, x86_reg(reg, address.size));
+	}
+
+	//[a + index * size + imm] of a load or store, a base that is not in a register goes through
+	//rax and such an index through r11
+	inline X86Operand address(const IrInst& ir) {
+		const uint8_t size = size_of(ir.type);
+		int64_t disp = ir.imm;
+		uint8_t index = NO_REG;
+
+		if (ir.index != NO_VREG)
+		{
+			//a constant index joins the displacement when the sum still fits
+			const int64_t offset = m_alloc.is_const(ir.index) ? disp + m_alloc.const_value(ir.index) * size : INT64_MAX;
+			if (offset >= INT32_MIN && offset <= INT32_MAX)
+				disp = offset;
+			else if (in_reg(ir.index))
+				index = m_alloc.reg(ir.index);
+			else {
+				move_to(R11, ir.index);
+				index = R11;
+			  }
+		}
+
+		uint8_t base = m_alloc.reg(ir.a);
+		if (!in_reg(ir.a))
+		{
+			move_to(RAX, ir.a);
+			base = RAX;
+		}
+		return x86_mem(base, index, index == NO_REG ? 1 : size, disp, size);
+	}
+
+	static inline int64_t truncate(int64_t value, size_t size) {
+		if (size == 8)
+			return value;
+		return (int64_t)((uint64_t)value & ((UINT64_C(1) << size * 8) - 1));
+	}
+
+	static inline X86Cond x86_cond(IrCond cond) {
+		switch (cond)
+		{
+			case IrCond::eq:  return X86Cond::e;
+			case IrCond::ne:  return X86Cond::ne;
+			case IrCond::ult: return X86Cond::b;
+			case IrCond::ugt: return X86Cond::a;
+			case IrCond::slt: return X86Cond::l;
+			case IrCond::sgt: return X86Cond::g;
+		}
+		return X86Cond::e;
+	}
+
+	//v as an operand covering its low size bytes
+	inline X86Operand narrow(uint32_t v, uint8_t size) const {
+		X86Operand operand = this->operand(v);
+		if (operand.kind == X86Operand::Kind::imm)
+			operand.value = size == 1 ? (uint8_t)operand.value : operand.value;
+		else
+			operand.size = size;
+		return operand;
+	}
+
+	//cmp a, b at the width of type, a in a register or memory and not both in memory
+	inline void compare(uint32_t a, uint32_t b, DataType type) {
+		const uint8_t size = size_of(type);
+		if (m_alloc.is_const(a) || (in_mem(a) && in_mem(b)))
+		{
+			move_to(RAX, a);
+			inst(X86Op::cmp, x86_reg(RAX, size), narrow(b, size));
+			return;
+		}
+		inst(X86Op::cmp, narrow(a, size), narrow(b, size));
+	}
+
+	//dst = a op b in two address form
+	inline void arith(const IrInst& ir) {
+		const bool commutes = ir.op != IrOp::sub;
+		X86Op op;
+		switch (ir.op)
+		{
+			case IrOp::add:  op = X86Op::add;  break;
+			case IrOp::sub:  op = X86Op::sub;  break;
+			case IrOp::and_: op = X86Op::and_; break;
+			default:         op = X86Op::imul; break;
+		}
+
+		uint32_t a = ir.a;
+		uint32_t b = ir.b;
+		uint8_t reg = target(ir.dst);
+
+		if (commutes && m_alloc.is_const(a) && !m_alloc.is_const(b))
+			std::swap(a, b);
+		if (in_reg(b) && m_alloc.reg(b) == reg && !(in_reg(a) && m_alloc.reg(a) == reg))
+		{
+			if (commutes)
+				std::swap(a, b);
+			else
+				reg = RAX;
+		}
+
+		move_to(reg, a);
+		inst(op, x86_reg(reg), operand(b));
+
+		if (in_reg(ir.dst) && m_alloc.reg(ir.dst) != reg)
+			inst(X86Op::mov, x86_reg(m_alloc.reg(ir.dst)), x86_reg(reg));
+		writeback(ir.dst, reg);
+	}
+
+	//dst = a * 3, 5 or 9 as a single lea, false for any other product
+	inline bool scaled_mul(const IrInst& ir) {
+		uint32_t a = ir.a;
+		uint32_t b = ir.b;
+		if (m_alloc.is_const(a))
+			std::swap(a, b);
+		if (m_alloc.is_const(a) || !m_alloc.is_const(b))
+			return false;
+
+		const int64_t factor = m_alloc.const_value(b);
+		if (factor != 3 && factor != 5 && factor != 9)
+			return false;
+
+		const uint8_t reg = target(ir.dst);
+		const uint8_t base = in_reg(a) ? m_alloc.reg(a) : reg;
+		move_to(base, a);
+		inst(X86Op::lea, x86_reg(reg), x86_mem(base, base, factor - 1, 0, 8));
+		writeback(ir.dst, reg);
+		return true;
+	}
+
+	//The operand of a one operand mul or div, a constant goes through r11
+	inline X86Operand wide_operand(uint32_t v) {
+		if (!m_alloc.is_const(v))
+			return operand(v);
+		move_to(R11, v);
+		return x86_reg(R11);
+	}
+
+	inline void result_from(uint32_t v, uint8_t reg) {
+		if (in_reg(v))
+			inst(X86Op::mov, x86_reg(m_alloc.reg(v)), x86_reg(reg));
+		writeback(v, reg);
+	}
+
+	//rcx, rsi and rdi hold something that is still needed after the syscall at m_pos
+	inline std::vector<uint8_t> live_across() {
+		std::vector<uint8_t> live;
+		for (const uint8_t reg : {RSI, RDI, RCX})
+		{
+			const auto& ranges = m_alloc.ranges(reg);
+			size_t& next = m_next_range[reg];
+			while (next < ranges.size() && ranges[next].second <= m_pos)
+				next++;
+			if (next < ranges.size() && ranges[next].first < m_pos)
+				live.push_back(reg);
+		}
+		return live;
+	}
+
+	inline void save(const std::vector<uint8_t>& regs) {
+		for (size_t i = 0; i < regs.size(); i++)
+			inst(X86Op::mov, x86_mem(RSP, m_saves + 8 * i, 8), x86_reg(regs[i]));
+	}
+
+	inline void restore(const std::vector<uint8_t>& regs) {
+		for (size_t i = 0; i < regs.size(); i++)
+			inst(X86Op::mov, x86_reg(regs[i]), x86_mem(RSP, m_saves + 8 * i, 8));
+	}
+
+	//VECTORS
+
+	inline bool avx2() const {
+		return m_prog.vector_bytes == 32;
+	}
+
+	//A vector register, as wide as the program's vectors unless size says otherwise
+	inline X86Operand xmm(uint8_t reg, uint8_t size = 0) const {
+		return x86_reg(reg, size ? size : m_prog.vector_bytes);
+	}
+
+	inline X86Operand vector(uint32_t v) const {
+		return xmm(m_alloc.reg(v));
+	}
+
+	//dst = a op src in two operand form, src must not be dst unless it is a
+	inline void vector_op(X86Op op, uint8_t dst, uint8_t a, X86Operand src) {
+		if (dst != a)
+			inst(X86Op::movdqa, xmm(dst), xmm(a));
+		inst(op, xmm(dst), src);
+	}
+
+	//dst = a op b for vector registers
+	inline void vector_arith(X86Op op, const IrInst& ir, bool commutes) {
+		const uint8_t dst = m_alloc.reg(ir.dst);
+		uint8_t a = m_alloc.reg(ir.a);
+		uint8_t b = m_alloc.reg(ir.b);
+		if (b == dst && a != dst)
+		{
+			if (commutes)
+				std::swap(a, b);
+			else {
+				inst(X86Op::movdqa, xmm(XMM15), xmm(b));
+				b = XMM15;
+			  }
+		}
+		vector_op(op, dst, a, xmm(b));
+	}
+
+	//SSE2 has no pmulld: the even and the odd dwords are multiplied to qwords apart, then
+	//their low halves are put back together
+	inline void multiply_dwords(const IrInst& ir) {
+		const uint8_t a = m_alloc.reg(ir.a);
+		const uint8_t b = m_alloc.reg(ir.b);
+		inst(X86Op::movdqa, xmm(XMM15), xmm(a));
+		inst(X86Op::pmuludq, xmm(XMM15), xmm(b));
+		shuffle(X86Op::pshufd, xmm(XMM14), xmm(a), 0xF5);
+		shuffle(X86Op::pshufd, xmm(XMM13), xmm(b), 0xF5);
+		inst(X86Op::pmuludq, xmm(XMM14), xmm(XMM13));
+		shuffle(X86Op::pshufd, xmm(XMM15), xmm(XMM15), 0x08);
+		shuffle(X86Op::pshufd, xmm(XMM14), xmm(XMM14), 0x08);
+		inst(X86Op::punpckldq, xmm(XMM15), xmm(XMM14));
+		inst(X86Op::movdqa, vector(ir.dst), xmm(XMM15));
+	}
+
+	//Every lane of reg = the low lane of v
+	inline void splat(uint8_t reg, uint32_t v, DataType type) {
+		X86Operand low = narrow(v, 4);
+		if (m_alloc.is_const(v))
+		{
+			inst(X86Op::mov, x86_reg(R11, 4), x86_imm(truncate(m_alloc.const_value(v), 4)));
+			low = x86_reg(R11, 4);
+		}
+		inst(X86Op::movd, xmm(reg, 16), low);
+
+		if (avx2())
+			inst(type == CHAR ? X86Op::vpbroadcastb : X86Op::vpbroadcastd, xmm(reg), xmm(reg, 16));
+		else {
+			if (type == CHAR)
+			{
+				inst(X86Op::punpcklbw, xmm(reg), xmm(reg));
+				inst(X86Op::punpcklwd, xmm(reg), xmm(reg));
+			}
+			shuffle(X86Op::pshufd, xmm(reg), xmm(reg), 0);
+		  }
+	}
+
+	//xmm15 = 0, 1, 2 and so on in lanes of type, built a qword at a time through r11
+	inline void lane_numbers(DataType type) {
+		const uint32_t bits = size_of(type) * 8;
+		auto qword = [&](uint8_t reg, uint32_t q) {
+			uint64_t value = 0;
+			for (uint32_t lane = 0; lane < 64 / bits; lane++)
+				value |= (uint64_t)(q * 64 / bits + lane) << lane * bits;
+			inst(X86Op::mov, x86_reg(R11), x86_imm(value));
+			inst(X86Op::movq, xmm(reg, 16), x86_reg(R11));
+		};
+		auto half = [&](uint8_t reg, uint8_t scratch, uint32_t q) {
+			qword(reg, q);
+			qword(scratch, q + 1);
+			inst(X86Op::punpcklqdq, xmm(reg, 16), xmm(scratch, 16));
+		};
+
+		half(XMM15, XMM14, 0);
+		if (avx2())
+		{
+			half(XMM14, XMM13, 2);
+			shuffle(X86Op::vinserti128, xmm(XMM15), xmm(XMM14, 16), 1);
+		}
+	}
+
+	//The dword lanes of reg added up into the low dword of xmm15
+	inline void add_lanes(uint8_t reg) {
+		if (avx2())
+		{
+			shuffle(X86Op::vextracti128, xmm(XMM15, 16), xmm(reg), 1);
+			inst(X86Op::paddd, xmm(XMM15, 16), xmm(reg, 16));
+		}
+		else
+			inst(X86Op::movdqa, xmm(XMM15), xmm(reg));
+		shuffle(X86Op::pshufd, xmm(XMM14, 16), xmm(XMM15, 16), 0x4E);
+		inst(X86Op::paddd, xmm(XMM15, 16), xmm(XMM14, 16));
+		shuffle(X86Op::pshufd, xmm(XMM14, 16), xmm(XMM15, 16), 0xB1);
+		inst(X86Op::paddd, xmm(XMM15, 16), xmm(XMM14, 16));
+	}
+
+	inline void emit_vector(const IrInst& ir) {
+		const bool bytes = ir.type == CHAR;
+		switch (ir.op)
+		{
+			case IrOp::vload:
+			{
+				X86Operand from = address(ir);
+				from.size = m_prog.vector_bytes;
+				inst(X86Op::movdqu, vector(ir.dst), from);
+				break;
+			}
+
+			case IrOp::vstore:
+			{
+				X86Operand to = address(ir);
+				to.size = m_prog.vector_bytes;
+				inst(X86Op::movdqu, to, vector(ir.b));
+				break;
+			}
+
+			case IrOp::vsplat:
+				splat(m_alloc.reg(ir.dst), ir.a, ir.type);
+				break;
+
+			case IrOp::vlanes:
+				splat(m_alloc.reg(ir.dst), ir.a, ir.type);
+				lane_numbers(ir.type);
+				inst(bytes ? X86Op::paddb : X86Op::paddd, vector(ir.dst), xmm(XMM15));
+				break;
+
+			case IrOp::vadd:
+				vector_arith(bytes ? X86Op::paddb : X86Op::paddd, ir, true);
+				break;
+
+			case IrOp::vsub:
+				vector_arith(bytes ? X86Op::psubb : X86Op::psubd, ir, false);
+				break;
+
+			case IrOp::vand:
+				vector_arith(X86Op::pand, ir, true);
+				break;
+
+			case IrOp::vmul:
+				if (avx2())
+					vector_arith(X86Op::pmulld, ir, true);
+				else
+					multiply_dwords(ir);
+				break;
+
+			case IrOp::vshl:
+				vector_op(X86Op::pslld, m_alloc.reg(ir.dst), m_alloc.reg(ir.a), x86_imm(ir.imm));
+				break;
+
+			case IrOp::vsad:
+				inst(X86Op::pxor, xmm(XMM15), xmm(XMM15));
+				vector_op(X86Op::psadbw, m_alloc.reg(ir.dst), m_alloc.reg(ir.a), xmm(XMM15));
+				break;
+
+			case IrOp::vsum:
+			{
+				const uint8_t reg = target(ir.dst);
+				add_lanes(m_alloc.reg(ir.a));
+				inst(X86Op::movd, x86_reg(reg, 4), xmm(XMM15, 16));
+				writeback(ir.dst, reg);
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+
+	inline void emit_inst(const IrInst& ir) {
+		switch (ir.op)
+		{
+			case IrOp::imm:
+				if (m_alloc.is_const(ir.dst))
+					break;
+				if (in_reg(ir.dst) || (ir.imm >= INT32_MIN && ir.imm <= INT32_MAX))
+					inst(X86Op::mov, operand(ir.dst), x86_imm(ir.imm));
+				else {
+					inst(X86Op::mov, x86_reg(RAX), x86_imm(ir.imm));
+					writeback(ir.dst, RAX);
+				  }
+				break;
+
+			case IrOp::copy:
+				if (in_reg(ir.dst))
+					move_to(m_alloc.reg(ir.dst), ir.a);
+				else if (!in_mem(ir.a))
+					inst(X86Op::mov, operand(ir.dst), operand(ir.a));
+				else if (m_alloc.spill(ir.a) != m_alloc.spill(ir.dst))
+				{
+					move_to(RAX, ir.a);
+					writeback(ir.dst, RAX);
+				}
+				break;
+
+			case IrOp::zext:
+			{
+				const uint8_t reg = target(ir.dst);
+				const uint8_t size = size_of(ir.type);
+				if (m_alloc.is_const(ir.a))
+					inst(X86Op::mov, x86_reg(reg, 4), x86_imm(truncate(m_alloc.const_value(ir.a), size)));
+				else if (in_reg(ir.a))
+					inst(size == 1 ? X86Op::movzx : X86Op::mov, x86_reg(reg, 4), x86_reg(m_alloc.reg(ir.a), size));
+				else
+					load_mem(reg, x86_mem(RSP, m_alloc.spill(ir.a) * 8, size));
+				writeback(ir.dst, reg);
+				break;
+			}
+
+			case IrOp::slot_addr:
+			{
+				const uint8_t reg = target(ir.dst);
+				inst(X86Op::lea, x86_reg(reg), slot(ir.imm, 8));
+				writeback(ir.dst, reg);
+				break;
+			}
+
+			case IrOp::load_slot:
+			{
+				const uint8_t reg = target(ir.dst);
+				load_mem(reg, slot(ir.imm, size_of(ir.type)));
+				writeback(ir.dst, reg);
+				break;
+			}
+
+			case IrOp::store_slot:
+				store_mem(slot(ir.imm, size_of(ir.type)), ir.a, RAX);
+				break;
+
+			case IrOp::load:
+			{
+				const uint8_t reg = target(ir.dst);
+				load_mem(reg, address(ir));
+				writeback(ir.dst, reg);
+				break;
+			}
+
+			case IrOp::store:
+				store_mem(address(ir), ir.b, RDX);
+				break;
+
+			case IrOp::mul:
+				if (!scaled_mul(ir))
+					arith(ir);
+				break;
+
+			case IrOp::add:
+			case IrOp::sub:
+			case IrOp::and_:
+				arith(ir);
+				break;
+
+			case IrOp::div:
+			case IrOp::mod:
+				move_to(RAX, ir.a);
+				inst(X86Op::xor_, x86_reg(RDX, 4), x86_reg(RDX, 4));
+				inst(X86Op::div, wide_operand(ir.b));
+				result_from(ir.dst, ir.op == IrOp::div ? RAX : RDX);
+				break;
+
+			case IrOp::mulhi:
+				move_to(RAX, ir.a);
+				inst(X86Op::mul, wide_operand(ir.b));
+				result_from(ir.dst, RDX);
+				break;
+
+			case IrOp::shl:
+			case IrOp::shr:
+			{
+				const uint8_t reg = target(ir.dst);
+				move_to(reg, ir.a);
+				inst(ir.op == IrOp::shl ? X86Op::shl : X86Op::shr, x86_reg(reg), x86_imm(ir.imm));
+				writeback(ir.dst, reg);
+				break;
+			}
+
+			case IrOp::set:
+			{
+				const uint8_t reg = target(ir.dst);
+				compare(ir.a, ir.b, ir.type);
+				inst(X86Op::set, x86_reg(RAX, 1), {}, x86_cond(ir.cond));
+				inst(X86Op::movzx, x86_reg(reg, 4), x86_reg(RAX, 1));
+				writeback(ir.dst, reg);
+				break;
+			}
+
+			case IrOp::write:
+			{
+				const std::vector<uint8_t> live = live_across();
+				save(live);
+				//rdx first, the buffer may sit in rsi
+				move_to(RDX, ir.b);
+				move_to(RSI, ir.a);
+				inst(X86Op::mov, x86_reg(RAX), x86_imm(1));
+				inst(X86Op::mov, x86_reg(RDI), x86_imm(1));
+				inst(X86Op::syscall);
+				restore(live);
+				break;
+			}
+
+			case IrOp::write_str:
+			{
+				const IrMessage& msg = m_prog.messages[ir.imm];
+				const std::vector<uint8_t> live = live_across();
+				save(live);
+				inst(X86Op::mov, x86_reg(RSI), x86_msg(ir.imm));
+				inst(X86Op::mov, x86_reg(RDX), x86_imm(msg.text.length() + (msg.nl ? 1 : 0)));
+				inst(X86Op::mov, x86_reg(RAX), x86_imm(1));
+				inst(X86Op::mov, x86_reg(RDI), x86_imm(1));
+				inst(X86Op::syscall);
+				restore(live);
+				break;
+			}
+
+			default:
+				emit_vector(ir);
+				break;
+		}
+	}
+
+	inline void emit_term(const IrTerm& term) {
+		switch (term.kind)
+		{
+			case IrTermKind::jmp:
+				inst(X86Op::jmp, x86_block(term.target));
+				break;
+
+			case IrTermKind::br:
+				compare(term.a, term.b, term.type);
+				inst(X86Op::jcc, x86_block(term.target), {}, x86_cond(term.cond));
+				inst(X86Op::jmp, x86_block(term.other));
+				break;
+
+			case IrTermKind::exit:
+				move_to(RDI, term.a);
+				inst(X86Op::mov, x86_reg(RAX), x86_imm(60));
+				inst(X86Op::syscall);
+				break;
+		}
+	}
+};
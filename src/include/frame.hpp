@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "./ir.hpp"
+
+//Gives the slots still in memory after promotion their offsets, sibling scopes share bytes.
+//Widest alignment first, 16 for arrays of 16 bytes and up, the frame rounds up to 16.
+class FrameLayout {
+public:
+	inline FrameLayout(IrProgram& prog) : m_prog(prog) {}
+
+	//Returns the bytes the slots need
+	inline uint32_t layout() {
+		std::vector<bool> used(m_prog.slots.size(), false);
+		for (const IrBlock& block : m_prog.blocks)
+			for (const IrInst& inst : block.insts)
+				if (inst.op == IrOp::slot_addr || inst.op == IrOp::load_slot || inst.op == IrOp::store_slot)
+					used[inst.imm] = true;
+
+		for (uint32_t s = 0; s < m_prog.slots.size(); s++)
+		{
+			IrSlot& slot = m_prog.slots[s];
+			const uint32_t start = slot.loc - slot.size;
+			if (!m_group.empty() && m_prog.slots[m_group.back()].loc > start)
+			{
+				const auto closed = std::find_if(m_group.begin(), m_group.end(), [&](uint32_t g) {
+					return m_prog.slots[g].loc > start;
+				});
+				place(m_group.begin(), closed);
+				place(closed, m_group.end());
+				m_group.clear();
+			}
+			while (!m_open.empty() && m_prog.slots[m_open.back().slot].loc > start)
+				m_open.pop_back();
+
+			slot.offset = NO_OFFSET;
+			if (used[s])
+				m_group.push_back(s);
+		}
+		place(m_group.begin(), m_group.end());
+
+		m_prog.frame_size = align_up(m_end, 16);
+		return m_prog.frame_size;
+	}
+
+private:
+	using Group = std::vector<uint32_t>::const_iterator;
+
+	struct Open
+	{
+		uint32_t slot;
+		uint32_t top;                   //highest end of this slot and the ones under it
+	};
+
+	IrProgram& m_prog;
+
+	std::vector<Open> m_open;               //placed slots still in scope, in declaration order
+	std::vector<uint32_t> m_group;          //declared but not placed yet
+	uint32_t m_end = 0;
+
+	static inline uint32_t align_up(uint32_t n, uint32_t align) {
+		return (n + align - 1) / align * align;
+	}
+
+	//An array is PTR, the lowest set bit of its size is at least the element size
+	static inline uint32_t alignment(const IrSlot& slot) {
+		if (slot.size >= 16)
+			return 16;
+		return std::clamp<uint32_t>(slot.size & -slot.size, 1, 8);
+	}
+
+	inline void place(Group first, Group last) {
+		std::vector<uint32_t> order(first, last);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t l, uint32_t r) {
+			return alignment(m_prog.slots[l]) > alignment(m_prog.slots[r]);
+		});
+
+		uint32_t offset = m_open.empty() ? 0 : m_open.back().top;
+		for (const uint32_t s : order)
+		{
+			IrSlot& slot = m_prog.slots[s];
+			offset = align_up(offset, alignment(slot));
+			slot.offset = offset;
+			offset += slot.size;
+		}
+
+		for (Group g = first; g != last; g++)
+		{
+			const uint32_t end = m_prog.slots[*g].offset + m_prog.slots[*g].size;
+			const uint32_t below = m_open.empty() ? 0 : m_open.back().top;
+			m_open.push_back({*g, std::max(below, end)});
+			m_end = std::max(m_end, end);
+		}
+	}
+};
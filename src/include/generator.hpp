@@ -1,8 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <iomanip>
 
-#include "./mod_map.hpp"
 #include "./typecheck.hpp"
 #include "./parser.hpp"
 
@@ -14,86 +14,97 @@ const std::string DBG_out(const std::stringstream& out) {
 
 class Generator {
 public:
-	inline Generator(NodeProg* prog,  const std::unordered_map<std::string, TypeChecker::VarType>& p_table)
-		: m_prog(std::move(prog)), m_sym_table(p_table)
+	inline Generator(const Ast* ast, const std::vector<Symbol>& symbols, std::string_view src)
+		: m_ast(*ast), m_symbols(symbols), m_src(src)
 	{
 	}	
 
 	inline std::string gen_prog() {
-		//Gen Text
-		m_output << "section .text\n\tglobal _start\n_start:\n";
-		for (const NodeStmt* stmt : m_prog->stmts)
+		gen_begin();
+		for (const uint32_t stmt : m_ast.stmts)
 		{
-			gen_stmt(stmt);
+			gen_top(stmt);
 		}
-		m_output << '\n';
-		m_output << "    mov rax, 60" << '\n';
-		m_output << "    mov rdi, 0"  << '\n';
-		m_output << "    syscall"     << '\n';
+		if (!m_exited)
+			gen_exit();
+		gen_frame();
 		
 		//Gen Data
 		m_output << "\n\nsection .data\n";
-		for (const MsgData& data : m_Messages)
+		gen_data();
+
+		return m_output.str();
+	}
+
+	//Streaming: gen_begin(), then gen_top() and flush() per top level statement, then gen_end()
+	//
+	//Locals are addressed from rbp, the frame size is defined by gen_frame() at the end
+	inline void gen_begin() {
+		m_output << "section .text\n\tglobal _start\n_start:\n";
+		m_output << "    mov rbp, rsp" << '\n'
+			 << "    sub rsp, FRAME_SIZE" << '\n';
+	}
+
+	//Nothing after a top level exit can run
+	inline void gen_top(uint32_t stmt) {
+		if (m_exited)
+			return;
+		gen_stmt(stmt);
+		m_exited = m_ast.kind[stmt] == NodeKind::stmt_exit;
+	}
+
+	//Writes out the text generated so far. Pending messages go out right away in a
+	//.data block of their own, so neither text nor messages pile up.
+	inline void flush(std::ostream& out) {
+		if (!m_Messages.empty())
 		{
-			m_output << '\t' << data.msg_label
-				 << " db"
-				 << " '"
-				 << data.msg
-				 << "'";
-			if (data.nl)
-			{
-				m_output << " , 0xA";
-			}
-			
-			m_output << '\n';
+			m_output << "section .data\n";
+			gen_data();
+			m_output << "section .text\n";
 		}
 
-		return m_output.str();
+		out << m_output.view();
+		m_output.str("");
+		m_output.clear();
 	}
 
-private:
+	inline void gen_end(std::ostream& out) {
+		if (!m_exited)
+			gen_exit();
+		gen_frame();
+		flush(out);
+	}
 
-	struct Var
-	{
-		size_t stack_loc;
-		TypeChecker::VarType types;	
-	};
+private:
 
 	struct MsgData 
 	{
 		std::string msg_label;
-		std::string msg;
+		std::string_view msg;
 		bool nl;
 	};
 
 	//MEMBERS
-	NodeProg* m_prog;
-	const std::unordered_map<std::string, TypeChecker::VarType>& m_sym_table;
+	const Ast& m_ast;
+	const std::vector<Symbol>& m_symbols;
+	std::string_view m_src;
 	
 	std::stringstream m_output;
 	
-	size_t m_stack_size = 0;
 	size_t m_labels = 1;
+	bool m_exited = false;
 	
-	std::vector<size_t>  m_scopes;
 	std::vector<MsgData> m_Messages;
 
-	Modded_map<Var> m_vars;
 	TypeTable m_Table;
 
-	inline void begin_scope() {	
-		m_scopes.push_back(m_stack_size);
-	}
+	//Largest Symbol loc, rounded up to 16 so rsp stays aligned
+	inline void gen_frame() {
+		size_t frame = 0;
+		for (const Symbol& symbol : m_symbols)
+			frame = std::max<size_t>(frame, symbol.loc);
 
-	inline void end_scope() {
-		size_t pop_count = m_stack_size - m_scopes.back();
-		for (int i = 0; i < pop_count; ) 
-			i += m_Table[m_vars.pop_back().types.type].type_size;	
-		
-		m_scopes.pop_back();
-		
-		m_output << "    add rsp, " << pop_count << '\n';
-		m_stack_size -= pop_count;
+		m_output << "\nFRAME_SIZE equ " << (frame + 15) / 16 * 16 << '\n';
 	}
 
 	inline std::string create_label() {
@@ -104,18 +115,36 @@ private:
 		return out.str();
 	}
 
-	inline size_t var_offset(size_t loc) {
-		return m_stack_size - loc;
+	inline void gen_exit() {
+		m_output << '\n';
+		m_output << "    mov rax, 60" << '\n';
+		m_output << "    mov rdi, 0"  << '\n';
+		m_output << "    syscall"     << '\n';
 	}
 
+	inline void gen_data() {
+		for (const MsgData& data : m_Messages)
+		{
+			m_output << '\t' << data.msg_label
+				 << " db"
+				 << " '"
+				 << data.msg
+				 << "'";
+			if (data.nl)
+			{
+				m_output << " , 0xA";
+			}
+			
+			m_output << '\n';
+		}
+		m_Messages.clear();
+	}
 
-	inline void gen_lhs_rhs(NodeExpr* lhs, NodeExpr* rhs) {
+	inline void gen_lhs_rhs(uint32_t lhs, uint32_t rhs) {
 		gen_expr(rhs);
 		m_output << "    push rax" << '\n';
-		m_stack_size += 8;
 		gen_expr(lhs);
 		m_output << "    pop rbx" << '\n';
-		m_stack_size -= 8;
 	}
 
 	inline void clear_reg(const std::string reg, DataType type) {
@@ -125,178 +154,155 @@ private:
 	}
 
 	//generating assembly for EXPRESSIONS	
-	inline void gen_term(const NodeTerm* term, const EXPRTYPE expr_type) {
-		struct TermVisitor
-		{	
-			Generator* gen;
-			EXPRTYPE expr_type;
-
-			void operator()(const NodeTermInt* int_term) const {
-				gen->m_output << "    mov rax, " << int_term->int_lit.value.value() << '\n';
-			}
-
-			void operator()(const NodeTermChar* char_term) const {
-				int ascii_value = (int)char_term->char_lit.value.value()[0];
-
-				gen->m_output << "    mov rax, " << ascii_value << '\n';
-			}
+	inline void gen_term_ident(uint32_t term, const EXPRTYPE expr_type) {
+		//b and c were filled in by the Resolver
+		const uint32_t loc = m_ast.c[term];
+		DataType type = m_symbols[m_ast.b[term]].types.type;
 
-			void operator()(const NodeTermIdent* ident_term) const {
-				std::string identifier = ident_term->ident.value.value();
-				if (!gen->m_vars.contains(identifier))
-				{
-					std::cerr << "'" << identifier << "' was not declared\n";
-					exit(EXIT_FAILURE);
-				}
-				size_t offset = gen->var_offset(gen->m_vars.at(identifier).stack_loc);
-				DataType type = gen->m_vars.at(identifier).types.type;
-
-				if (expr_type == EXPRTYPE::RVALUE)
-				{
-					gen->m_output << "    mov " << gen->m_Table[type].getReg('a') 
-						      <<      ", "  << gen->m_Table[type].size_asm 
-					      	      <<    " [rsp";
-					if (offset) {gen->m_output  << "+" << offset;}
-					gen->m_output <<      "]"   << '\n';
-
-					gen->clear_reg("rax", type);
-
-				} else {
-					gen->m_output << "    mov rax, rsp" << '\n';
-					if (offset)
-					{
-						gen->m_output << "    add rax, " << offset << '\n';
-					}
-				  }
-			}
+		if (expr_type == EXPRTYPE::RVALUE)
+		{
+			m_output << "    mov " << m_Table[type].getReg('a') 
+				 <<      ", "  << m_Table[type].size_asm 
+				 <<    " [rbp-" << loc << "]" << '\n';
 
-			void operator()(const NodeTermParen* paren_term) {
-				gen->gen_expr(paren_term->expr);
-			}
-		};
+			clear_reg("rax", type);
 
-		TermVisitor visitor{.gen = this, .expr_type = expr_type};
-		std::visit(visitor, term->var);
+		} else {
+			m_output << "    lea rax, [rbp-" << loc << "]" << '\n';
+		  }
 	}
 
-	inline void gen_cmp_expr(const NodeBinExprCmp* cmp) {
-		const std::string false_label = create_label();
-		const std::string end_label = create_label();
+	//Compares at the width of the wider side and returns the condition the comparison holds on,
+	//or fails on when holds is false. Ints compare signed, chars and pointers unsigned.
+	inline std::string_view gen_cmp(uint32_t cmp, bool holds) {
+		const DataType type = std::max(m_ast.type[m_ast.a[cmp]], m_ast.type[m_ast.b[cmp]]);
+		const bool is_signed = type == INT;
 
-		gen_lhs_rhs(cmp->lhs, cmp->rhs);
-		
-		m_output << "    cmp rax, rbx" << '\n';
+		gen_lhs_rhs(m_ast.a[cmp], m_ast.b[cmp]);
 
-		switch (cmp->cmp_op) 
+		switch (type)
 		{
-			case TokenType::g_than :
-				m_output << "    jc " << false_label << '\n';
-				m_output << "    je " << false_label << '\n';
+			case CHAR:
+				m_output << "    cmp al, bl" << '\n';
 				break;
-			case TokenType::l_than :
-				m_output << "    jnc " << false_label << '\n';
-				break;
-			case TokenType::eq_to :
-				m_output << "    jne " << false_label << '\n';
+			case INT:
+				m_output << "    cmp eax, ebx" << '\n';
 				break;
-			case TokenType::not_eq_to :
-				m_output << "    je " << false_label << '\n';
+			default:
+				m_output << "    cmp rax, rbx" << '\n';
 				break;
 		}
-		
-		m_output << "    mov rax, 1" << '\n';
-		m_output << "    jmp " << end_label << '\n';
-		m_output << false_label << ":\n";
-		m_output << "    mov rax, 0" << '\n';
-		m_output << end_label << ":\n";
-	}
 
-	inline void gen_expr(const NodeExpr* expr) {
-		struct ExprVisitor 
+		switch ((TokenType)m_ast.c[cmp]) 
 		{
-			Generator* gen;
-			DataType type;
-			EXPRTYPE expr_type;
+			case TokenType::g_than :
+				return holds ? (is_signed ? "g" : "a") : (is_signed ? "le" : "be");
+			case TokenType::l_than :
+				return holds ? (is_signed ? "l" : "b") : (is_signed ? "ge" : "ae");
+			case TokenType::eq_to :
+				return holds ? "e" : "ne";
+			default:
+				return holds ? "ne" : "e";
+		}
+	}
 
-			void operator()(const NodeTerm* term) const {
-				gen->gen_term(term, expr_type);
-			}
+	inline void gen_cmp_expr(uint32_t cmp) {
+		const std::string_view cond = gen_cmp(cmp, true);
 
-			void operator()(const NodeBinExpr* bin_expr) const {
-				gen->gen_bin_expr(bin_expr);
-			}
+		m_output << "    set" << cond << " al" << '\n';
+		m_output << "    movzx eax, al" << '\n';
+	}
 
-			void operator()(const NodeUnExpr* un_expr) const {
-				gen->gen_un_expr(un_expr, expr_type, type);
-			}
-		};
-		
-		ExprVisitor visitor{.gen = this, .type = expr->type, .expr_type = expr->expr_type};
-		std::visit(visitor, expr->var);	
+	//Jumps to label when cond is true or, by default, when it is false. A comparison branches
+	//on its own flags
+	inline void gen_cond(uint32_t cond, const std::string& label, bool when = false) {
+		while (m_ast.kind[cond] == NodeKind::term_paren)
+			cond = m_ast.a[cond];
+
+		if (m_ast.kind[cond] == NodeKind::bin_cmp)
+		{
+			const std::string_view jump = gen_cmp(cond, when);
+			m_output << "    j" << jump << ' ' << label << '\n';
+			return;
+		}
+
+		gen_expr(cond);
+		m_output << "    test rax, rax" << '\n';
+		m_output << (when ? "    jnz " : "    jz ") << label << '\n';
 	}
 
-	inline void gen_bin_expr(const NodeBinExpr* bin_expr) {
-		struct BinExprVisitor
+	inline void gen_expr(uint32_t expr) {
+		const uint32_t a = m_ast.a[expr];
+		const uint32_t b = m_ast.b[expr];
+		const DataType type = m_ast.type[expr];
+		const EXPRTYPE expr_type = m_ast.expr_type[expr];
+
+		switch (m_ast.kind[expr])
 		{
-			Generator* gen;
+			case NodeKind::term_int:
+				m_output << "    mov rax, " << token_str(m_ast.token(expr), m_src) << '\n';
+				break;
 
-			void operator()(const NodeBinExprAdd* add) const {
-				gen->gen_lhs_rhs(add->lhs, add->rhs);
-				gen->m_output << "    add rax, rbx" << '\n';
-			}
+			case NodeKind::term_char:
+			{
+				int ascii_value = (int)token_str(m_ast.token(expr), m_src)[0];
 
-			void operator()(const NodeBinExprMulti* multi) const {
-				gen->gen_lhs_rhs(multi->lhs, multi->rhs);
-				gen->m_output << "    mul rbx" << '\n';
+				m_output << "    mov rax, " << ascii_value << '\n';
+				break;
 			}
 
-			void operator()(const NodeBinExprSub* sub) const {
-				gen->gen_lhs_rhs(sub->lhs, sub->rhs);
-				gen->m_output << "    sub rax, rbx" << '\n';
-			}
+			case NodeKind::term_const:
+				m_output << "    mov rax, " << (int64_t)((uint64_t)b << 32 | a) << '\n';
+				break;
 
-			void operator()(const NodeBinExprDiv* fslash) const {
-				gen->gen_lhs_rhs(fslash->lhs, fslash->rhs);
-				gen->m_output << "    mov rdx, 0" << '\n'
-					      << "    div rbx"    << '\n';
-			}
+			case NodeKind::term_ident:
+				gen_term_ident(expr, expr_type);
+				break;
 
-			void operator()(const NodeBinExprMod* modulo) const {
-				gen->gen_lhs_rhs(modulo->lhs, modulo->rhs);
-				gen->m_output << "    mov rdx, 0"   << '\n'
-					      << "    div rbx"      << '\n'
-					      << "    mov rax, rdx" << '\n';
-			}
+			case NodeKind::term_paren:
+				gen_expr(a);
+				break;
 
-			void operator()(const NodeBinExprCmp* cmp) const {
-				gen->gen_cmp_expr(cmp);
-			}
-		};
+			case NodeKind::bin_add:
+				gen_lhs_rhs(a, b);
+				m_output << "    add rax, rbx" << '\n';
+				break;
 
-		BinExprVisitor visitor{.gen = this};
-		std::visit(visitor, bin_expr->var);
-	}
+			case NodeKind::bin_multi:
+				gen_lhs_rhs(a, b);
+				m_output << "    mul rbx" << '\n';
+				break;
 
-	inline void gen_un_expr(const NodeUnExpr* un_expr, const EXPRTYPE expr_type, const DataType type)
-	{
-		struct un_visitor
-		{
-			Generator* gen;
-			DataType type;
-			EXPRTYPE expr_type;
+			case NodeKind::bin_sub:
+				gen_lhs_rhs(a, b);
+				m_output << "    sub rax, rbx" << '\n';
+				break;
 
-			void operator()(const NodeUnExprDref* dref) const {
-				
-				if (dref->rvalue_expr.has_value())
+			case NodeKind::bin_div:
+				gen_lhs_rhs(a, b);
+				m_output << "    mov rdx, 0" << '\n'
+					 << "    div rbx"    << '\n';
+				break;
+
+			case NodeKind::bin_mod:
+				gen_lhs_rhs(a, b);
+				m_output << "    mov rdx, 0"   << '\n'
+					 << "    div rbx"      << '\n'
+					 << "    mov rax, rdx" << '\n';
+				break;
+
+			case NodeKind::bin_cmp:
+				gen_cmp_expr(expr);
+				break;
+
+			case NodeKind::un_dref:
+				if (b != NO_NODE)
 				{
-					gen->gen_lhs_rhs(dref->rvalue_expr.value(), dref->lvalue_expr);
+					gen_lhs_rhs(b, a);
 
-					gen->m_output << "    mov rcx, "    << gen->m_Table[type].type_size << '\n'  
-						      << "    mul rcx"      << '\n'
-						      << "    add rbx, rax" << '\n'
-						      << "    mov rax, rbx" << '\n';
+					m_output << "    lea rax, [rbx+rax*" << m_Table[type].type_size << "]" << '\n';
 				} else {
-					gen->gen_expr(dref->lvalue_expr);
+					gen_expr(a);
 				  }
 				
 				switch (expr_type)
@@ -304,227 +310,200 @@ private:
 					case EXPRTYPE::LVALUE:
 						break;
 					case EXPRTYPE::RVALUE:
-						gen->m_output << "    mov "
-						              << gen->m_Table[type].getReg('a')	
-							      << ", "
-							      << gen->m_Table[type].size_asm
-							      << " [rax]"
-							      << '\n';
-					        gen->clear_reg("rax", type);
+						m_output << "    mov "
+							 << m_Table[type].getReg('a')	
+							 << ", "
+							 << m_Table[type].size_asm
+							 << " [rax]"
+							 << '\n';
+					        clear_reg("rax", type);
 						break;
 				}
+				break;
 
-			}
-
-			void operator()(const NodeUnExprIncrement* increment) const {
-				if (increment->rvalue_expr.has_value())
+			case NodeKind::un_increment:
+				if (b != NO_NODE)
 				{
-					gen->gen_lhs_rhs(increment->rvalue_expr.value(),increment->lvalue_expr);
-					gen->m_output << "    mov rcx, rax" << '\n';
+					gen_lhs_rhs(b, a);
+					m_output << "    mov rcx, rax" << '\n';
 				} else {
-					gen->gen_expr(increment->lvalue_expr);
-					gen->m_output << "    mov rbx, rax" << '\n'
-					       	      << "    mov rcx, 1"   << '\n';	
+					gen_expr(a);
+					m_output << "    mov rbx, rax" << '\n'
+					       	 << "    mov rcx, 1"   << '\n';	
 				  }
 				
 				if(expr_type == EXPRTYPE::RVALUE)
 				{
-				  		gen->m_output << "    mov "
-					  		      << gen->m_Table[type].getReg('a')
-					      		      << ", "
-							      << gen->m_Table[type].size_asm
-							      << " [rbx]"
-							      << '\n';
-						gen->clear_reg("rax", type);	
+				  		m_output << "    mov "
+					  		 << m_Table[type].getReg('a')
+					      		 << ", "
+							 << m_Table[type].size_asm
+							 << " [rbx]"
+							 << '\n';
+						clear_reg("rax", type);	
 				}
 				
-				gen->m_output << "    add "
-			 		      << gen->m_Table[type].size_asm
-					      << " [rbx], " 
-					      << gen->m_Table[type].getReg('c')
-					      << '\n';	
-			}
+				m_output << "    add "
+			 		 << m_Table[type].size_asm
+					 << " [rbx], " 
+					 << m_Table[type].getReg('c')
+					 << '\n';	
+				break;
 
-			void operator()(const NodeUnExprAddr* addr) const {
+			case NodeKind::un_addr:
 				if (expr_type == EXPRTYPE::LVALUE)
 					{std::cerr << "& cannot be an expression of type LVALUE\n"; exit(EXIT_FAILURE);}
 				
-				gen->gen_expr(addr->lvalue_expr);
-			}
-		};
+				gen_expr(a);
+				break;
 
-		un_visitor visitor{.gen = this, .type = type, .expr_type = expr_type};
-		std::visit(visitor, un_expr->var);
+			default:
+				std::cerr << "Expected an expression node\n";
+				exit(EXIT_FAILURE);
+		}
 	}
 
 	//genrating assembly for STATEMENTS
 
-	inline void gen_stmt(const NodeStmt* stmt) {
-		struct StmtVisitor 
-		{
-			Generator* gen;
+	inline void gen_stmt(uint32_t stmt) {
+		const uint32_t a = m_ast.a[stmt];
+		const uint32_t b = m_ast.b[stmt];
+		const uint32_t c = m_ast.c[stmt];
 
-			void operator()(const NodeStmtExit* exit_stmt) const{
-				
-				gen->gen_expr(exit_stmt->expr);
-				gen->m_output << "    mov rdi, rax" << '\n'
-					      << "    mov rax, 60"  << '\n'
-					      << "    syscall"      << '\n';
-			}
-
-			void operator()(const NodeStmtDeclare* declare) const {
-				std::string identifier = declare->ident.value.value();	
-
-				gen->m_output << "    sub rsp, " << gen->m_Table[declare->type].type_size * declare->count << '\n';
-				gen->m_stack_size += gen->m_Table[declare->type].type_size * declare->count;
-				
-				Var tmp_var {.stack_loc = gen->m_stack_size,
-					     .types     = gen->m_sym_table.at(identifier)};
-				
-				gen->m_vars.insert(identifier, tmp_var);
-			}
+		switch (m_ast.kind[stmt])
+		{
+			case NodeKind::stmt_exit:
+				gen_expr(a);
+				m_output << "    mov rdi, rax" << '\n'
+					 << "    mov rax, 60"  << '\n'
+					 << "    syscall"      << '\n';
+				break;
 
+			case NodeKind::stmt_declare:
+				//gen_frame() has room for it
+				break;
 
-			void operator()(const NodeStmtAssign* assign) const {
-				DataType type = assign->lvalue_expr->type;
+			case NodeKind::stmt_assign:
+			{
+				DataType type = m_ast.type[a];
 				
-				if (assign->rvalue_expr.has_value())
+				if (b != NO_NODE)
 				{
-					gen->gen_lhs_rhs(assign->rvalue_expr.value(), assign->lvalue_expr);
-					gen->m_output << "    mov " 
-					 	      << gen->m_Table[type].size_asm
-					      	      << " [rbx], "
-					      	      << gen->m_Table[type].getReg('a')
-					      	      << '\n';
+					gen_lhs_rhs(b, a);
+					m_output << "    mov " 
+						 << m_Table[type].size_asm
+						 << " [rbx], "
+						 << m_Table[type].getReg('a')
+						 << '\n';
 				} else {
-					gen->gen_expr(assign->lvalue_expr);	
+					gen_expr(a);	
 				  }
+				break;
 			}
 
-			void operator()(const NodeStmtScope* scope) const{
-				gen->begin_scope();
-
-				for (const NodeStmt* stmt : scope->stmts)
-					gen->gen_stmt(stmt);
-				
-				gen->end_scope();
-			}
+			case NodeKind::stmt_scope:
+				for (uint32_t i = a; i < a + b; i++)
+				{
+					gen_stmt(m_ast.lists[i]);
+					if (m_ast.kind[m_ast.lists[i]] == NodeKind::stmt_exit)
+						break;
+				}
+				break;
 
-			void operator()(const NodeStmtIf* if_stmt) const {
-				std::string end_label = gen->create_label();
-				std::string label = gen->create_label();
+			case NodeKind::stmt_if:
+			{
+				std::string end_label = create_label();
+				std::string label = create_label();
 
-				gen->gen_expr(if_stmt->expr);
-				
-				gen->m_output << "    test rax, rax" << '\n';
-				gen->m_output << "    jz " << label << '\n';
+				gen_cond(a, label);
 
-				gen->gen_stmt(if_stmt->stmt);
-				gen->m_output << "    jmp " << end_label << '\n';
-				gen->m_output << label << ":\n";
+				gen_stmt(b);
+				m_output << "    jmp " << end_label << '\n';
+				m_output << label << ":\n";
 
-				if (if_stmt->chain.has_value())
+				if (c != NO_NODE)
 				{
-					gen->gen_if_chain(if_stmt->chain.value(), end_label);
+					gen_if_chain(c, end_label);
 				}	
 
-				gen->m_output << end_label << ":\n";
+				m_output << end_label << ":\n";
+				break;
 			}
 
-			void operator()(const NodeStmtLoop* loop) const {
-				std::string start_label = gen->create_label();
-				std::string end_label = gen->create_label();
-				
-				gen->m_output << start_label << ":\n";
+			case NodeKind::stmt_loop:
+			{
+				std::string start_label = create_label();
+				std::string end_label = create_label();
 
-				gen->gen_expr(loop->expr);
-				gen->m_output << "    test rax, rax" << '\n';
-				gen->m_output << "    jz " << end_label << '\n';
+				//rotated, the condition is tested once before and then at the bottom
+				gen_cond(a, end_label);
+				m_output << start_label << ":\n";
 
-				gen->gen_stmt(loop->scope);
-				gen->m_output << "    jmp " << start_label << '\n';
+				gen_stmt(b);
+				gen_cond(a, start_label, true);
 				
-				gen->m_output << end_label << ":\n";
+				m_output << end_label << ":\n";
+				break;
 			}
 
-			void operator()(const NodeStmtWrite* write) const {
-				gen->gen_stmt_write(write);
-			}
-		};
+			case NodeKind::stmt_write_expr:
+			case NodeKind::stmt_write_str:
+				gen_stmt_write(stmt);
+				break;
 
-		StmtVisitor visitor{.gen = this};
-		std::visit(visitor, stmt->var);	
+			default:
+				std::cerr << "Expected a statement node\n";
+				exit(EXIT_FAILURE);
+		}
 	}
 
-	inline void gen_stmt_write(const NodeStmtWrite* write) {
-		struct WriteVisitor
-		{
-			Generator* gen;
-			bool nl;
-			std::optional<NodeExpr*> bytes;
-
-			void operator()(const std::string& str) const {
-				std::string msg_label = gen->create_label();
-				gen->m_Messages.push_back({msg_label, str, nl});
-				
-				gen->m_output << "    mov rsi, " << msg_label 		       << '\n'
-					      << "    mov rdx, " << str.length() + (nl ? 1 : 0) << '\n';
-			}
-			void operator()(const NodeExpr* expr) const {
-				gen->gen_expr(expr);
-				gen->m_output << "    mov rsi, rax" << '\n';
+	inline void gen_stmt_write(uint32_t write) {
+		const uint32_t bytes = m_ast.b[write];
+		const bool nl = m_ast.c[write];
 
-				if (bytes.has_value())
-				{
-					gen->gen_expr(bytes.value());
-					gen->m_output << "    mov rdx, rax" << '\n';
-				} else {
-					gen->m_output << "    mov rdx, 1" << '\n';
-				  }
-			}
-		};
+		if (m_ast.kind[write] == NodeKind::stmt_write_str)
+		{
+			const std::string_view str = token_str(m_ast.token(write), m_src);
+			std::string msg_label = create_label();
+			m_Messages.push_back({msg_label, str, nl});
+			
+			m_output << "    mov rsi, " << msg_label 		       << '\n'
+				 << "    mov rdx, " << str.length() + (nl ? 1 : 0) << '\n';
+		} else {
+			gen_expr(m_ast.a[write]);
+			m_output << "    mov rsi, rax" << '\n';
 
-		WriteVisitor visitor{.gen = this, .nl = write->nl, .bytes = write->no_of_bytes};
-		std::visit(visitor, write->var);
+			if (bytes != NO_NODE)
+			{
+				gen_expr(bytes);
+				m_output << "    mov rdx, rax" << '\n';
+			} else {
+				m_output << "    mov rdx, 1" << '\n';
+			  }
+		  }
 
 		m_output << "    mov rax, 1" << '\n'
 			 << "    mov rdi, 1" << '\n';
 		m_output << "    syscall" << '\n';
 	}
 	
-	inline void gen_if_chain(NodeIfChain* chain, const std::string& label) {
-		struct ChainVisitor 
+	inline void gen_if_chain(uint32_t chain, const std::string& end_label) {
+		if (m_ast.kind[chain] == NodeKind::chain_elif)
 		{
-			const std::string& end_label;
-			Generator* gen;
-			
-			ChainVisitor(Generator* p_gen, std::string p_label) : gen(p_gen), end_label(p_label) {}
-
-			void operator()(const NodeChainElif* elif) const {
-				
-				std::string label = gen->create_label();
+			std::string label = create_label();
 
-				gen->gen_expr(elif->expr);
-				
-				gen->m_output << "    test rax, rax" << '\n';
-				gen->m_output << "    jz " << label << '\n';
+			gen_cond(m_ast.a[chain], label);
 
-				gen->gen_stmt(elif->stmt);
-				gen->m_output << "    jmp " << end_label << '\n';
-				gen->m_output << label << ":\n";
+			gen_stmt(m_ast.b[chain]);
+			m_output << "    jmp " << end_label << '\n';
+			m_output << label << ":\n";
 
-				if (elif->chain.has_value())
-				{
-					gen->gen_if_chain(elif->chain.value(), end_label);
-				}	
-			}
-
-			void operator()(const NodeChainElse* _else) {
-				gen->gen_stmt(_else->stmt);
-			}
-		};
-
-		ChainVisitor visitor(this, label);
-		std::visit(visitor, chain->var);
+			if (m_ast.c[chain] != NO_NODE)
+			{
+				gen_if_chain(m_ast.c[chain], end_label);
+			}	
+		} else {
+			gen_stmt(m_ast.b[chain]);
+		  }
 	}
 };
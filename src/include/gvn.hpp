@@ -0,0 +1,454 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "./dce.hpp"
+#include "./ir.hpp"
+#include "./ssa.hpp"
+#include "./types.hpp"
+
+//Dominator tree value numbering over SsaBuilder's form. Loads are keyed by a memory version
+//every store starts anew. Only single definition registers replace a value found again.
+class ValueNumbering {
+public:
+	inline ValueNumbering(IrProgram& prog, const SsaBuilder& ssa) : m_prog(prog), m_ssa(ssa) {}
+
+	//Returns the number of instructions removed or turned into copies
+	inline uint32_t number() {
+		const uint32_t count = m_prog.vregs.size();
+		m_vn.resize(count);
+		for (uint32_t v = 0; v < count; v++)
+			m_vn[v] = v;
+		m_width.assign(count, 8);
+		m_replace.assign(count, NO_VREG);
+		m_single.assign(count, NO_VREG);
+		m_mem_out.assign(m_prog.blocks.size(), 0);
+		m_slots.assign(1024, 0);
+
+		walk();
+		replace_uses();
+		remove_unused();
+		return m_numbered;
+	}
+
+private:
+	static constexpr DataType STORED = (DataType)NO_OF_TYPES;
+
+	struct Key
+	{
+		IrOp op;
+		IrCond cond;
+		DataType type;                  //access or compare width where the op has one
+		DataType holds;                 //type of the result, STORED for what a store left
+		uint32_t a;
+		uint32_t b;
+		uint32_t index;
+		int64_t imm;
+		uint32_t mem;
+
+		inline bool operator==(const Key& other) const = default;
+	};
+
+	struct Entry
+	{
+		Key key;
+		size_t hash;
+		uint32_t n;
+	};
+
+	//Scoped state is restored from these when the walk leaves a block
+	struct Undo
+	{
+		std::vector<uint32_t>* array;
+		uint32_t at;
+		uint32_t old;
+	};
+
+	IrProgram& m_prog;
+	const SsaBuilder& m_ssa;
+	uint32_t m_numbered = 0;
+	TypeTable m_Table;
+
+	std::vector<uint32_t> m_vn;             //register -> value number, the register that first computed it
+	std::vector<uint8_t> m_width;           //value number -> bytes it is zero extended from
+	std::vector<uint32_t> m_replace;        //removed register -> register with the same value
+	std::vector<uint32_t> m_single;         //value number -> single definition register holding it, scoped
+
+	//Expression -> value number, scoped. Open addressing like Interner
+	std::vector<Entry> m_entries;
+	std::vector<uint32_t> m_slots;          //entry + 1, 0 is empty
+	std::vector<Undo> m_undo;
+	std::vector<uint32_t> m_mem_out;        //block -> memory version at its end
+	uint32_t m_mem = 0;
+	uint32_t m_mems = 0;
+
+	inline uint32_t vn(uint32_t v) const {
+		return v == NO_VREG ? NO_VREG : m_vn[v];
+	}
+
+	inline void scoped(std::vector<uint32_t>& array, uint32_t at, uint32_t value) {
+		m_undo.push_back({&array, at, array[at]});
+		array[at] = value;
+	}
+
+	//The closest constant holds it, setting it again beats a long live range
+	inline void define(uint32_t v, bool constant = false) {
+		if (!m_ssa.is_var(v) && (m_single[m_vn[v]] == NO_VREG || constant))
+			scoped(m_single, m_vn[v], v);
+	}
+
+	//A register holding value number n here, NO_VREG if there is none
+	inline uint32_t holder(uint32_t n) const {
+		return m_single[n];
+	}
+
+	inline uint8_t size_of(DataType type) const {
+		return m_Table[type].type_size;
+	}
+
+	static inline uint8_t width_of(int64_t value) {
+		const uint64_t bits = value;
+		return bits <= UINT8_MAX ? 1 : bits <= UINT32_MAX ? 4 : 8;
+	}
+
+	static inline bool commutes(const IrInst& inst) {
+		switch (inst.op)
+		{
+			case IrOp::add:
+			case IrOp::mul:
+			case IrOp::and_:
+			case IrOp::mulhi:
+				return true;
+			case IrOp::set:
+				return inst.cond == IrCond::eq || inst.cond == IrCond::ne;
+			default:
+				return false;
+		}
+	}
+
+	static inline bool typed(IrOp op) {
+		return op == IrOp::zext || op == IrOp::set || op == IrOp::load || op == IrOp::load_slot;
+	}
+
+	inline Key key(const IrInst& inst) const {
+		const bool load = inst.op == IrOp::load || inst.op == IrOp::load_slot;
+		Key k = {inst.op, inst.op == IrOp::set ? inst.cond : IrCond::eq, typed(inst.op) ? inst.type : PTR, m_prog.vregs[inst.dst],
+		         vn(inst.a), vn(inst.b), vn(inst.index), inst.imm, load ? m_mem : 0};
+		if (commutes(inst) && k.a > k.b)
+			std::swap(k.a, k.b);
+		return k;
+	}
+
+	//Where a store leaves its value for the loads keyed like k
+	static inline Key stored(Key k) {
+		k.holds = STORED;
+		return k;
+	}
+
+	inline Key stored(const IrInst& inst) const {
+		if (inst.op == IrOp::store)
+			return {IrOp::load, IrCond::eq, inst.type, STORED, vn(inst.a), NO_VREG, vn(inst.index), inst.imm, m_mem};
+		return {IrOp::load_slot, IrCond::eq, inst.type, STORED, NO_VREG, NO_VREG, NO_VREG, inst.imm, m_mem};
+	}
+
+	static inline size_t hash(const Key& key) {
+		size_t hash = std::hash<int64_t>{}(key.imm);
+		for (const size_t part : {(size_t)key.op, (size_t)key.cond, (size_t)key.type, (size_t)key.holds, (size_t)key.a, (size_t)key.b, (size_t)key.index, (size_t)key.mem})
+			hash = (hash ^ part) * 0x100000001b3;
+		return hash ^ hash >> 29;
+	}
+
+	//Value number of an expression computed on the way here, NO_VREG if there is none
+	inline uint32_t lookup(const Key& k) const {
+		const size_t mask = m_slots.size() - 1;
+		const size_t h = hash(k);
+		for (size_t i = h & mask; m_slots[i] != 0; i = (i + 1) & mask)
+		{
+			const Entry& entry = m_entries[m_slots[i] - 1];
+			if (entry.hash == h && entry.key == k)
+				return entry.n;
+		}
+		return NO_VREG;
+	}
+
+	inline void remember(const Key& k, uint32_t n) {
+		if ((m_entries.size() + 1) * 2 > m_slots.size())
+		{
+			m_slots.assign(m_slots.size() * 2, 0);
+			for (uint32_t e = 0; e < m_entries.size(); e++)
+				place(e);
+		}
+		m_entries.push_back({k, hash(k), n});
+		place(m_entries.size() - 1);
+	}
+
+	inline void place(uint32_t e) {
+		const size_t mask = m_slots.size() - 1;
+		size_t i = m_entries[e].hash & mask;
+		while (m_slots[i] != 0)
+			i = (i + 1) & mask;
+		m_slots[i] = e + 1;
+	}
+
+	//Drops the entries from the last one back to entry to
+	inline void forget(size_t to) {
+		const size_t mask = m_slots.size() - 1;
+		for (size_t e = m_entries.size(); e-- > to;)
+		{
+			size_t i = m_entries[e].hash & mask;
+			while (m_slots[i] != e + 1)
+				i = (i + 1) & mask;
+			m_slots[i] = 0;
+		}
+		m_entries.resize(to);
+	}
+
+	inline void walk() {
+		std::vector<std::pair<size_t, size_t>> mark(m_prog.blocks.size());
+
+		//b to enter a block, ~b to leave it
+		std::vector<uint32_t> walk = {0};
+		while (!walk.empty())
+		{
+			const uint32_t step = walk.back();
+			walk.pop_back();
+			if (step >= m_prog.blocks.size())
+			{
+				const auto [undo, added] = mark[~step];
+				for (size_t i = m_undo.size(); i-- > undo;)
+					(*m_undo[i].array)[m_undo[i].at] = m_undo[i].old;
+				m_undo.resize(undo);
+				forget(added);
+				continue;
+			}
+
+			const uint32_t b = step;
+			mark[b] = {m_undo.size(), m_entries.size()};
+			const std::span<const uint32_t> preds = m_ssa.preds(b);
+			m_mem = preds.size() == 1 && preds[0] == m_ssa.idom(b) ? m_mem_out[preds[0]] : ++m_mems;
+			number_block(m_prog.blocks[b]);
+			m_mem_out[b] = m_mem;
+
+			walk.push_back(~b);
+			const std::span<const uint32_t> children = m_ssa.children(b);
+			for (size_t i = children.size(); i-- > 0;)
+				walk.push_back(children[i]);
+		}
+	}
+
+	inline void number_block(IrBlock& block) {
+		//a phi whose arguments all have one value is that value
+		for (const IrPhi& phi : block.phis)
+		{
+			uint32_t same = NO_VREG;
+			for (const auto& [pred, value] : phi.args)
+			{
+				if (value == phi.dst)
+					continue;
+				same = same == NO_VREG || same == vn(value) ? vn(value) : phi.dst;
+			}
+			if (same != NO_VREG && same != phi.dst)
+			{
+				m_vn[phi.dst] = same;
+				m_numbered++;
+			}
+			define(phi.dst);
+		}
+
+		size_t kept = 0;
+		for (size_t i = 0; i < block.insts.size(); i++)
+		{
+			IrInst& inst = block.insts[i];
+			if (!number_inst(inst))
+				continue;
+			block.insts[kept++] = inst;
+		}
+		block.insts.resize(kept);
+	}
+
+	//false when the instruction goes
+	inline bool number_inst(IrInst& inst) {
+		switch (inst.op)
+		{
+			case IrOp::store:
+			case IrOp::store_slot:
+				m_mem = ++m_mems;
+				remember(stored(inst), inst.op == IrOp::store ? inst.b : inst.a);
+				return true;
+
+			case IrOp::write:
+			case IrOp::write_str:
+				return true;
+
+			default:
+				break;
+		}
+
+		const uint32_t dst = inst.dst;
+		uint32_t found = NO_VREG;
+		if (inst.op == IrOp::copy)
+			found = vn(inst.a);
+		else if (inst.op == IrOp::zext && m_width[vn(inst.a)] <= size_of(inst.type))
+			found = vn(inst.a);
+		else if (inst.op == IrOp::load || inst.op == IrOp::load_slot)
+		{
+			const Key k = key(inst);
+			found = lookup(k);
+			if (found == NO_VREG)
+			{
+				const uint32_t put = lookup(stored(k));
+				if (put != NO_VREG)
+					found = forward(inst, put);
+			}
+			if (found == NO_VREG)
+				remember(k, dst);
+		}
+
+		if (found == NO_VREG && inst.op != IrOp::copy && inst.op != IrOp::load && inst.op != IrOp::load_slot)
+		{
+			const Key k = key(inst);
+			found = lookup(k);
+			if (found == NO_VREG)
+				remember(k, dst);
+		}
+
+		const bool constant = inst.op == IrOp::imm || inst.op == IrOp::slot_addr;
+		if (found == NO_VREG)
+		{
+			m_width[dst] = width(inst);
+			define(dst, constant);
+			return true;
+		}
+
+		m_vn[dst] = found;
+		const uint32_t from = constant ? NO_VREG : holder(found);
+		if (from != NO_VREG && !m_ssa.is_var(dst))
+		{
+			m_replace[dst] = from;
+			m_numbered++;
+			return false;
+		}
+		if (from != NO_VREG && (inst.op != IrOp::copy || inst.a != from))
+		{
+			inst = {.op = IrOp::copy, .type = inst.type, .dst = dst, .a = from};
+			m_numbered++;
+		}
+		define(dst, constant);
+		return true;
+	}
+
+	//A load of what a store wrote, its value number or NO_VREG when nothing holds it
+	inline uint32_t forward(IrInst& inst, uint32_t value) {
+		const uint32_t n = vn(value);
+		if (inst.type == PTR || m_width[n] <= size_of(inst.type))
+			return n;
+
+		const uint32_t from = holder(n);
+		if (from == NO_VREG)
+			return NO_VREG;
+		inst = {.op = IrOp::zext, .type = inst.type, .dst = inst.dst, .a = from};
+		return NO_VREG;
+	}
+
+	inline uint8_t width(const IrInst& inst) const {
+		switch (inst.op)
+		{
+			case IrOp::imm:
+				return width_of(inst.imm);
+			case IrOp::zext:
+			case IrOp::load:
+			case IrOp::load_slot:
+				return size_of(inst.type);
+			case IrOp::set:
+				return 1;
+			default:
+				return 8;
+		}
+	}
+
+	inline void replace_uses() {
+		auto resolve = [&](uint32_t& v) {
+			if (v == NO_VREG)
+				return;
+			while (m_replace[v] != NO_VREG)
+				v = m_replace[v];
+		};
+
+		for (IrBlock& block : m_prog.blocks)
+		{
+			for (IrPhi& phi : block.phis)
+				for (auto& [pred, value] : phi.args)
+					resolve(value);
+			for (IrInst& inst : block.insts)
+			{
+				resolve(inst.a);
+				resolve(inst.b);
+				resolve(inst.index);
+			}
+			resolve(block.term.a);
+			resolve(block.term.b);
+		}
+	}
+
+	//Drops what the numbering left without a use, one count suffices in SSA form
+	inline void remove_unused() {
+		const uint32_t count = m_prog.vregs.size();
+		std::vector<uint32_t> uses(count, 0);
+		std::vector<std::pair<uint32_t, uint32_t>> def(count, {NO_BLOCK, 0});      //{block, instruction}
+		auto use = [&](uint32_t v) {
+			if (v != NO_VREG)
+				uses[v]++;
+		};
+
+		for (uint32_t b = 0; b < m_prog.blocks.size(); b++)
+		{
+			const IrBlock& block = m_prog.blocks[b];
+			for (const IrPhi& phi : block.phis)
+				for (const auto& [pred, value] : phi.args)
+					use(value);
+			for (uint32_t i = 0; i < block.insts.size(); i++)
+			{
+				const IrInst& inst = block.insts[i];
+				use(inst.a);
+				use(inst.b);
+				use(inst.index);
+				if (inst.dst != NO_VREG)
+					def[inst.dst] = {b, i};
+			}
+			use(block.term.a);
+			use(block.term.b);
+		}
+
+		auto unused = [&](uint32_t v) {
+			return v != NO_VREG && uses[v] == 0 && def[v].first != NO_BLOCK
+			    && DeadCodeEliminator::pure(m_prog.blocks[def[v].first].insts[def[v].second].op);
+		};
+
+		std::vector<uint32_t> work;
+		for (uint32_t v = 0; v < count; v++)
+			if (unused(v))
+				work.push_back(v);
+		if (work.empty())
+			return;
+
+		while (!work.empty())
+		{
+			IrInst& inst = m_prog.blocks[def[work.back()].first].insts[def[work.back()].second];
+			work.pop_back();
+			inst.dst = NO_VREG;
+			m_numbered++;
+			for (const uint32_t v : {inst.a, inst.b, inst.index})
+				if (v != NO_VREG && --uses[v] == 0 && unused(v))
+					work.push_back(v);
+		}
+
+		for (IrBlock& block : m_prog.blocks)
+			std::erase_if(block.insts, [](const IrInst& inst) {
+				return inst.dst == NO_VREG && DeadCodeEliminator::pure(inst.op);
+			});
+	}
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+//Identifier interner. Every distinct name gets a dense 32 bit id in first-seen order, so later
+//phases can key symbols by id with flat vectors instead of hashing strings again.
+//Names are views into the source buffer, nothing is copied.
+class Interner {
+public:
+	inline Interner() : m_slots(64, 0) {}
+
+	inline Interner(const Interner& other) = delete;
+	inline Interner operator=(const Interner& other) = delete;
+
+	inline uint32_t intern(std::string_view name) {
+		const size_t hash = std::hash<std::string_view>{}(name);
+		size_t mask = m_slots.size() - 1;
+
+		for (size_t i = hash & mask; ; i = (i + 1) & mask)
+		{
+			const uint32_t slot = m_slots[i];
+			if (slot == 0)
+				break;
+			if (m_hashes[slot - 1] == hash && m_names[slot - 1] == name)
+				return slot - 1;
+		}
+
+		const uint32_t id = m_names.size();
+		m_names.push_back(name);
+		m_hashes.push_back(hash);
+
+		if (m_names.size() * 2 > m_slots.size())
+		{
+			grow();
+			mask = m_slots.size() - 1;
+		}
+
+		size_t i = hash & mask;
+		while (m_slots[i] != 0)
+			i = (i + 1) & mask;
+		m_slots[i] = id + 1;
+
+		return id;
+	}
+
+	inline std::string_view str(uint32_t id) const {
+		return m_names[id];
+	}
+
+	inline size_t size() const {
+		return m_names.size();
+	}
+
+private:
+	std::vector<std::string_view> m_names;
+	std::vector<size_t> m_hashes;
+	std::vector<uint32_t> m_slots;      //id + 1, 0 is empty
+
+	inline void grow() {
+		std::vector<uint32_t> slots(m_slots.size() * 2, 0);
+		const size_t mask = slots.size() - 1;
+
+		for (uint32_t id = 0; id + 1 < m_names.size(); id++)
+		{
+			size_t i = m_hashes[id] & mask;
+			while (slots[i] != 0)
+				i = (i + 1) & mask;
+			slots[i] = id + 1;
+		}
+
+		m_slots = std::move(slots);
+	}
+};
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "./types.hpp"
+
+#define NO_VREG   UINT32_MAX
+#define NO_BLOCK  UINT32_MAX
+#define NO_OFFSET UINT32_MAX
+
+//Three address IR. Virtual registers hold 64 bit values and are typed with the DataType of
+//the expression that defined them. Variables live in frame slots and are only reached through
+//explicit loads and stores, a load zero extends and a store truncates to the access type.
+//SlotPromoter later moves the scalar ones into virtual registers that are set more than once.
+//SsaBuilder gives each assignment its own register for a while, with phis at joins.
+//
+//LoopVectorizer adds the v ops. Their vector registers are IrProgram::vector_bytes wide and
+//split into lanes of type, one per element, the virtual register is typed with the lane type.
+enum class IrOp : uint8_t
+{
+	imm,                //dst = imm
+	copy,               //dst = a
+	zext,               //dst = a truncated to type and zero extended, what a store and reload does
+	slot_addr,          //dst = address of slot imm
+	load_slot,          //dst = slot imm
+	store_slot,         //slot imm = a
+	load,               //dst = [a + index * size of type + imm]
+	store,              //[a + index * size of type + imm] = b
+
+	add,                //dst = a op b, wrapping and unsigned like the generated code
+	sub,
+	mul,
+	div,
+	mod,
+	and_,
+	mulhi,              //dst = high 64 bits of the 128 bit product a * b
+	shl,                //dst = a shifted by imm, shr is logical
+	shr,
+	set,                //dst = a cond b ? 1 : 0, compared at the width of type
+
+	write,              //write(stdout, a, b bytes)
+	write_str,          //write(stdout, message imm)
+
+	vload,              //vector dst = the elements from [a + index * size of type + imm] up
+	vstore,             //the elements from [a + index * size of type + imm] up = vector b
+	vsplat,             //vector dst = a in every lane
+	vlanes,             //vector dst = a + n in lane n
+	vadd,               //vector dst = a op b lane by lane, wrapping at the lane width
+	vsub,
+	vmul,
+	vand,
+	vshl,               //vector dst = a shifted by imm lane by lane
+	vsad,               //vector dst = the sum of the bytes of a in each qword, dword lanes
+	vsum                //dst = the sum of the dword lanes of vector a, truncated to 32 bits
+};
+
+//The op writes a vector register
+inline bool vector_result(IrOp op) {
+	return op >= IrOp::vload && op != IrOp::vstore && op != IrOp::vsum;
+}
+
+//Comparisons look at the low bytes of both sides that the compared type covers: chars and
+//pointers compare unsigned, ints signed
+enum class IrCond : uint8_t
+{
+	eq,
+	ne,
+	ult,
+	ugt,
+	slt,
+	sgt
+};
+
+struct IrInst
+{
+	IrOp op;
+	DataType type = INT;            //access width of loads and stores, compare width of set
+	IrCond cond = IrCond::eq;
+	uint32_t dst = NO_VREG;
+	uint32_t a = NO_VREG;
+	uint32_t b = NO_VREG;
+	uint32_t index = NO_VREG;       //element index of a load or store
+	int64_t imm = 0;
+};
+
+enum class IrTermKind : uint8_t
+{
+	jmp,                //to target
+	br,                 //to target if a cond b at the width of type, else to other
+	exit                //exit(a)
+};
+
+struct IrTerm
+{
+	IrTermKind kind = IrTermKind::jmp;
+	IrCond cond = IrCond::ne;
+	DataType type = PTR;
+	uint32_t a = NO_VREG;
+	uint32_t b = NO_VREG;
+	uint32_t target = NO_BLOCK;
+	uint32_t other = NO_BLOCK;
+};
+
+//dst = args[i].second when control came from args[i].first, only while in SSA form
+struct IrPhi
+{
+	uint32_t dst;
+	std::vector<std::pair<uint32_t, uint32_t>> args;
+};
+
+struct IrBlock
+{
+	std::vector<IrPhi> phis;
+	std::vector<IrInst> insts;
+	IrTerm term;
+};
+
+//One per Symbol. offset is FrameLayout's, from rsp, NO_OFFSET when the slot needs no bytes
+struct IrSlot
+{
+	std::string_view name;
+	DataType type;
+	uint32_t size;
+	uint32_t loc;
+	uint32_t offset = 0;
+};
+
+struct IrMessage
+{
+	std::string_view text;
+	bool nl;
+};
+
+struct IrProgram
+{
+	std::vector<IrBlock> blocks;            //blocks[0] is the entry, blocks are laid out in index order
+	std::vector<IrSlot> slots;              //indexed by Symbol
+	std::vector<IrMessage> messages;
+	std::vector<DataType> vregs;            //type of every virtual register
+	uint32_t frame_size = 0;                //bytes the slots need
+	uint32_t vector_bytes = 16;             //width of the vector registers of the v ops
+
+	inline uint32_t new_vreg(DataType type) {
+		vregs.push_back(type);
+		return vregs.size() - 1;
+	}
+
+	//Successors of a block, NO_BLOCK where there is none
+	inline std::pair<uint32_t, uint32_t> successors(uint32_t block) const {
+		const IrTerm& term = blocks[block].term;
+		switch (term.kind)
+		{
+			case IrTermKind::jmp:
+				return {term.target, NO_BLOCK};
+			case IrTermKind::br:
+				return {term.target, term.other};
+			default:
+				return {NO_BLOCK, NO_BLOCK};
+		}
+	}
+
+	inline void dump(std::ostream& out) const {
+		static const char* type_names[NO_OF_TYPES] = {"char", "int", "ptr"};
+
+		out << "slots:\n";
+		for (size_t i = 0; i < slots.size(); i++)
+			out << "\ts" << i << ' ' << slots[i].name << ": " << type_names[slots[i].type]
+			    << ", " << slots[i].size << " bytes"
+			    << (slots[i].offset == NO_OFFSET ? "" : " @" + std::to_string(slots[i].offset)) << '\n';
+
+		if (!messages.empty())
+			out << "messages:\n";
+		for (size_t i = 0; i < messages.size(); i++)
+			out << "\tm" << i << " \"" << messages[i].text << '"' << (messages[i].nl ? " nl" : "") << '\n';
+
+		for (size_t b = 0; b < blocks.size(); b++)
+		{
+			out << "b" << b << ":\n";
+			for (const IrPhi& phi : blocks[b].phis)
+			{
+				out << "\tv" << phi.dst << ':' << type_names[vregs[phi.dst]] << " = phi";
+				for (size_t i = 0; i < phi.args.size(); i++)
+					out << (i ? ", b" : " b") << phi.args[i].first << " v" << phi.args[i].second;
+				out << '\n';
+			}
+			for (const IrInst& inst : blocks[b].insts)
+			{
+				out << '\t';
+				dump_inst(out, inst, type_names);
+				out << '\n';
+			}
+
+			const IrTerm& term = blocks[b].term;
+			switch (term.kind)
+			{
+				case IrTermKind::jmp:
+					out << "\tjmp b" << term.target << '\n';
+					break;
+				case IrTermKind::br:
+					out << "\tbr " << cond_name(term.cond) << '.' << type_names[term.type] << " v" << term.a << ", v" << term.b
+					    << " ? b" << term.target << " : b" << term.other << '\n';
+					break;
+				case IrTermKind::exit:
+					out << "\texit v" << term.a << '\n';
+					break;
+			}
+		}
+	}
+
+	static inline const char* cond_name(IrCond cond) {
+		switch (cond)
+		{
+			case IrCond::eq:  return "eq";
+			case IrCond::ne:  return "ne";
+			case IrCond::ult: return "ult";
+			case IrCond::ugt: return "ugt";
+			case IrCond::slt: return "slt";
+			case IrCond::sgt: return "sgt";
+		}
+		return "?";
+	}
+
+private:
+	inline void dump_inst(std::ostream& out, const IrInst& inst, const char* const* type_names) const {
+		if (inst.dst != NO_VREG)
+			out << 'v' << inst.dst << ':' << type_names[vregs[inst.dst]] << " = ";
+
+		switch (inst.op)
+		{
+			case IrOp::imm:
+				out << "imm " << inst.imm;
+				break;
+			case IrOp::copy:
+				out << "copy v" << inst.a;
+				break;
+			case IrOp::zext:
+				out << "zext." << type_names[inst.type] << " v" << inst.a;
+				break;
+			case IrOp::slot_addr:
+				out << "addr " << slot_name(inst.imm);
+				break;
+			case IrOp::load_slot:
+				out << "load." << type_names[inst.type] << ' ' << slot_name(inst.imm);
+				break;
+			case IrOp::store_slot:
+				out << "store." << type_names[inst.type] << ' ' << slot_name(inst.imm) << ", v" << inst.a;
+				break;
+			case IrOp::load:
+				out << "load." << type_names[inst.type] << ' ';
+				dump_address(out, inst);
+				break;
+			case IrOp::store:
+				out << "store." << type_names[inst.type] << ' ';
+				dump_address(out, inst);
+				out << ", v" << inst.b;
+				break;
+			case IrOp::add:
+				out << "add v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::sub:
+				out << "sub v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::mul:
+				out << "mul v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::div:
+				out << "div v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::mod:
+				out << "mod v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::and_:
+				out << "and v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::mulhi:
+				out << "mulhi v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::shl:
+				out << "shl v" << inst.a << ", " << inst.imm;
+				break;
+			case IrOp::shr:
+				out << "shr v" << inst.a << ", " << inst.imm;
+				break;
+			case IrOp::set:
+				out << "set " << cond_name(inst.cond) << '.' << type_names[inst.type] << " v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::write:
+				out << "write v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::write_str:
+				out << "write m" << inst.imm;
+				break;
+			case IrOp::vload:
+				out << "vload." << type_names[inst.type] << ' ';
+				dump_address(out, inst);
+				break;
+			case IrOp::vstore:
+				out << "vstore." << type_names[inst.type] << ' ';
+				dump_address(out, inst);
+				out << ", v" << inst.b;
+				break;
+			case IrOp::vsplat:
+				out << "vsplat." << type_names[inst.type] << " v" << inst.a;
+				break;
+			case IrOp::vlanes:
+				out << "vlanes." << type_names[inst.type] << " v" << inst.a;
+				break;
+			case IrOp::vadd:
+				out << "vadd." << type_names[inst.type] << " v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::vsub:
+				out << "vsub." << type_names[inst.type] << " v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::vmul:
+				out << "vmul." << type_names[inst.type] << " v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::vand:
+				out << "vand v" << inst.a << ", v" << inst.b;
+				break;
+			case IrOp::vshl:
+				out << "vshl." << type_names[inst.type] << " v" << inst.a << ", " << inst.imm;
+				break;
+			case IrOp::vsad:
+				out << "vsad v" << inst.a;
+				break;
+			case IrOp::vsum:
+				out << "vsum v" << inst.a;
+				break;
+		}
+	}
+
+	inline void dump_address(std::ostream& out, const IrInst& inst) const {
+		static const TypeTable types;
+		out << "[v" << inst.a;
+		if (inst.index != NO_VREG)
+			out << " + v" << inst.index << '*' << types[inst.type].type_size;
+		if (inst.imm)
+			out << " + " << inst.imm;
+		out << ']';
+	}
+
+	inline std::string slot_name(int64_t slot) const {
+		return "s" + std::to_string(slot) + "(" + std::string(slots[slot].name) + ")";
+	}
+};
@@ -0,0 +1,443 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "./ast.hpp"
+#include "./ir.hpp"
+#include "./resolver.hpp"
+
+//Lowers a checked and folded Ast to an IrProgram. Operands are evaluated in the order
+//Generator evaluates them so side effects of ++ land in the same place.
+class IrBuilder {
+public:
+	inline IrBuilder(const Ast* ast, const std::vector<Symbol>& symbols, std::string_view src)
+		: m_ast(*ast), m_symbols(symbols), m_src(src)
+	{
+	}
+
+	inline IrProgram build() {
+		for (const Symbol& symbol : m_symbols)
+		{
+			m_prog.slots.push_back({symbol.name, symbol.types.type, symbol.size, symbol.loc});
+			if (symbol.loc > m_prog.frame_size)
+				m_prog.frame_size = symbol.loc;
+		}
+		for (IrSlot& slot : m_prog.slots)
+			slot.offset = m_prog.frame_size - slot.loc;
+
+		m_block = new_block();
+		for (const uint32_t stmt : m_ast.stmts)
+		{
+			build_stmt(stmt);
+		}
+		terminate({.kind = IrTermKind::exit, .a = imm(0, INT)});
+
+		return std::move(m_prog);
+	}
+
+private:
+	const Ast& m_ast;
+	const std::vector<Symbol>& m_symbols;
+	std::string_view m_src;
+
+	IrProgram m_prog;
+	uint32_t m_block = NO_BLOCK;            //block new instructions go to
+	TypeTable m_Table;
+
+	inline uint32_t new_block() {
+		m_prog.blocks.emplace_back();
+		return m_prog.blocks.size() - 1;
+	}
+
+	inline void emit(const IrInst& inst) {
+		m_prog.blocks[m_block].insts.push_back(inst);
+	}
+
+	inline uint32_t emit_value(IrInst inst, DataType type) {
+		inst.dst = m_prog.new_vreg(type);
+		emit(inst);
+		return inst.dst;
+	}
+
+	inline void terminate(const IrTerm& term) {
+		m_prog.blocks[m_block].term = term;
+	}
+
+	inline uint32_t imm(int64_t value, DataType type) {
+		return emit_value({.op = IrOp::imm, .imm = value}, type);
+	}
+
+	//Ends the current block with a branch on a condition, the false edge is patched later. A
+	//comparison branches on itself, anything else on != 0
+	inline uint32_t branch_if(uint32_t cond, uint32_t target) {
+		while (m_ast.kind[cond] == NodeKind::term_paren)
+			cond = m_ast.a[cond];
+
+		if (m_ast.kind[cond] == NodeKind::bin_cmp)
+		{
+			const Comparison cmp = build_compare(cond);
+			terminate({.kind = IrTermKind::br, .cond = cmp.cond, .type = cmp.type, .a = cmp.lhs, .b = cmp.rhs, .target = target});
+			return m_block;
+		}
+
+		const uint32_t value = build_expr(cond);
+		terminate({.kind = IrTermKind::br, .cond = IrCond::ne, .a = value, .b = imm(0, INT), .target = target});
+		return m_block;
+	}
+
+	//STMTS
+	inline void build_stmt(uint32_t stmt) {
+		const uint32_t a = m_ast.a[stmt];
+		const uint32_t b = m_ast.b[stmt];
+		const uint32_t c = m_ast.c[stmt];
+
+		switch (m_ast.kind[stmt])
+		{
+			case NodeKind::stmt_exit:
+				terminate({.kind = IrTermKind::exit, .a = build_expr(a)});
+				//anything after exit goes to a block nothing jumps to
+				m_block = new_block();
+				break;
+
+			case NodeKind::stmt_declare:
+				break;
+
+			case NodeKind::stmt_assign:
+				build_assign(stmt);
+				break;
+
+			case NodeKind::stmt_scope:
+				for (uint32_t i = a; i < a + b; i++)
+					build_stmt(m_ast.lists[i]);
+				break;
+
+			case NodeKind::stmt_if:
+			{
+				std::vector<uint32_t> to_end;
+				uint32_t arm = stmt;
+
+				while (arm != NO_NODE && m_ast.kind[arm] != NodeKind::chain_else)
+				{
+					const uint32_t cond = branch_if(m_ast.a[arm], NO_BLOCK);
+
+					m_prog.blocks[cond].term.target = m_block = new_block();
+					build_stmt(m_ast.b[arm]);
+					terminate({.kind = IrTermKind::jmp});
+					to_end.push_back(m_block);
+
+					m_prog.blocks[cond].term.other = m_block = new_block();
+					arm = m_ast.c[arm];
+				}
+
+				if (arm != NO_NODE)
+					build_stmt(m_ast.b[arm]);
+				terminate({.kind = IrTermKind::jmp});
+				to_end.push_back(m_block);
+
+				m_block = new_block();
+				for (const uint32_t block : to_end)
+					m_prog.blocks[block].term.target = m_block;
+				break;
+			}
+
+			//Rotated: the condition guards the loop and is tested again at the bottom, with an
+			//empty preheader between the guard and the body for LoopHoister
+			case NodeKind::stmt_loop:
+			{
+				const uint32_t guard = branch_if(a, NO_BLOCK);
+
+				m_prog.blocks[guard].term.target = m_block = new_block();
+				const uint32_t body = new_block();
+				terminate({.kind = IrTermKind::jmp, .target = body});
+
+				m_block = body;
+				build_stmt(b);
+				const uint32_t latch = branch_if(a, body);
+
+				m_prog.blocks[guard].term.other = m_prog.blocks[latch].term.other = m_block = new_block();
+				break;
+			}
+
+			case NodeKind::stmt_write_expr:
+			{
+				const uint32_t buffer = build_expr(a);
+				const uint32_t bytes = b != NO_NODE ? build_expr(b) : imm(1, INT);
+				emit({.op = IrOp::write, .a = buffer, .b = bytes});
+				break;
+			}
+
+			case NodeKind::stmt_write_str:
+				m_prog.messages.push_back({token_str(m_ast.token(stmt), m_src), (bool)c});
+				emit({.op = IrOp::write_str, .imm = (int64_t)m_prog.messages.size() - 1});
+				break;
+
+			default:
+				std::cerr << "Expected a statement node\n";
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	inline void build_assign(uint32_t stmt) {
+		const uint32_t lvalue = m_ast.a[stmt];
+		const uint32_t rvalue = m_ast.b[stmt];
+
+		if (rvalue == NO_NODE)
+		{
+			if (m_ast.kind[lvalue] == NodeKind::un_increment && m_ast.kind[m_ast.a[lvalue]] == NodeKind::term_ident)
+				build_slot_increment(lvalue);
+			else
+				build_expr(lvalue);
+			return;
+		}
+
+		const DataType type = m_ast.type[lvalue];
+		if (m_ast.kind[lvalue] == NodeKind::term_ident)
+		{
+			emit({.op = IrOp::store_slot, .type = type, .a = build_expr(rvalue), .imm = m_ast.b[lvalue]});
+			return;
+		}
+
+		if (m_ast.kind[lvalue] == NodeKind::un_dref)
+		{
+			const Address address = build_address(lvalue);
+			emit({.op = IrOp::store, .type = type, .a = address.base, .b = build_expr(rvalue), .index = address.index, .imm = address.disp});
+			return;
+		}
+
+		const uint32_t address = build_expr(lvalue);
+		emit({.op = IrOp::store, .type = type, .a = address, .b = build_expr(rvalue)});
+	}
+
+	//Exprs
+	inline uint32_t build_literal(uint32_t expr) {
+		const std::string_view text = token_str(m_ast.token(expr), m_src);
+		uint64_t value;
+		const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+		if (error != std::errc() || end != text.data() + text.size())
+		{
+			std::cerr << "Integer literal out of range: '" << text << "'\n";
+			exit(EXIT_FAILURE);
+		}
+
+		return imm((int64_t)value, INT);
+	}
+
+	//Value of a literal or folded constant
+	inline std::optional<int64_t> constant(uint32_t expr) const {
+		while (m_ast.kind[expr] == NodeKind::term_paren)
+			expr = m_ast.a[expr];
+
+		switch (m_ast.kind[expr])
+		{
+			case NodeKind::term_int:
+			{
+				const std::string_view text = token_str(m_ast.token(expr), m_src);
+				uint64_t value;
+				const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+				if (error != std::errc() || end != text.data() + text.size())
+					return std::nullopt;
+				return (int64_t)value;
+			}
+			case NodeKind::term_const:
+				return (int64_t)((uint64_t)m_ast.b[expr] << 32 | m_ast.a[expr]);
+			default:
+				return std::nullopt;
+		}
+	}
+
+	struct Address
+	{
+		uint32_t base;
+		uint32_t index;                 //NO_VREG when the element is at a constant offset
+		int64_t disp;
+	};
+
+	//->a~b~ as base + index * size + disp, a constant index or a constant added to the index
+	//goes to the displacement
+	inline Address build_address(uint32_t dref) {
+		const uint32_t base = build_expr(m_ast.a[dref]);
+		uint32_t index = m_ast.b[dref];
+		if (index == NO_NODE)
+			return {base, NO_VREG, 0};
+
+		const int64_t size = m_Table[m_ast.type[dref]].type_size;
+		auto fits = [](int64_t offset) {
+			return offset >= -(INT64_C(1) << 28) && offset < (INT64_C(1) << 28);
+		};
+
+		while (m_ast.kind[index] == NodeKind::term_paren)
+			index = m_ast.a[index];
+
+		if (const std::optional<int64_t> offset = constant(index); offset && fits(*offset))
+			return {base, NO_VREG, *offset * size};
+
+		const NodeKind kind = m_ast.kind[index];
+		if (kind == NodeKind::bin_add || kind == NodeKind::bin_sub)
+		{
+			const std::optional<int64_t> rhs = constant(m_ast.b[index]);
+			if (rhs && fits(*rhs))
+				return {base, build_expr(m_ast.a[index]), (kind == NodeKind::bin_add ? *rhs : -*rhs) * size};
+
+			const std::optional<int64_t> lhs = constant(m_ast.a[index]);
+			if (kind == NodeKind::bin_add && lhs && fits(*lhs))
+				return {base, build_expr(m_ast.b[index]), *lhs * size};
+		}
+
+		return {base, build_expr(index), 0};
+	}
+
+	inline uint32_t build_binary(uint32_t expr, IrOp op) {
+		const uint32_t rhs = build_expr(m_ast.b[expr]);
+		const uint32_t lhs = build_expr(m_ast.a[expr]);
+		return emit_value({.op = op, .a = lhs, .b = rhs}, m_ast.type[expr]);
+	}
+
+	struct Comparison
+	{
+		IrCond cond;
+		DataType type;
+		uint32_t lhs;
+		uint32_t rhs;
+	};
+
+	inline Comparison build_compare(uint32_t expr) {
+		//the wider side decides, the node's own type column may hold an assignment's type
+		const DataType type = std::max(m_ast.type[m_ast.a[expr]], m_ast.type[m_ast.b[expr]]);
+		const bool is_signed = type == INT;
+
+		IrCond cond;
+		switch ((TokenType)m_ast.c[expr])
+		{
+			case TokenType::g_than:     cond = is_signed ? IrCond::sgt : IrCond::ugt; break;
+			case TokenType::l_than:     cond = is_signed ? IrCond::slt : IrCond::ult; break;
+			case TokenType::eq_to:      cond = IrCond::eq;  break;
+			case TokenType::not_eq_to:  cond = IrCond::ne;  break;
+			default:
+				std::cerr << "Expected a comparison operator\n";
+				exit(EXIT_FAILURE);
+		}
+
+		const uint32_t rhs = build_expr(m_ast.b[expr]);
+		const uint32_t lhs = build_expr(m_ast.a[expr]);
+		return {cond, type, lhs, rhs};
+	}
+
+	inline uint32_t build_cmp(uint32_t expr) {
+		const Comparison cmp = build_compare(expr);
+		return emit_value({.op = IrOp::set, .type = cmp.type, .cond = cmp.cond, .a = cmp.lhs, .b = cmp.rhs}, INT);
+	}
+
+	//++ of a variable whose address nobody gets, stays a slot access so the variable can be promoted
+	inline uint32_t build_slot_increment(uint32_t expr) {
+		const DataType type = m_ast.type[expr];
+		const int64_t slot = m_ast.b[m_ast.a[expr]];
+		const uint32_t amount = m_ast.b[expr] != NO_NODE ? build_expr(m_ast.b[expr]) : imm(1, INT);
+
+		const uint32_t old = emit_value({.op = IrOp::load_slot, .type = type, .imm = slot}, type);
+		const uint32_t sum = emit_value({.op = IrOp::add, .a = old, .b = amount}, type);
+		emit({.op = IrOp::store_slot, .type = type, .a = sum, .imm = slot});
+		return old;
+	}
+
+	inline uint32_t build_expr(uint32_t expr) {
+		const uint32_t a = m_ast.a[expr];
+		const uint32_t b = m_ast.b[expr];
+		const DataType type = m_ast.type[expr];
+		const bool rvalue = m_ast.expr_type[expr] == EXPRTYPE::RVALUE;
+
+		switch (m_ast.kind[expr])
+		{
+			case NodeKind::term_int:
+				return build_literal(expr);
+
+			case NodeKind::term_char:
+				return imm((int)token_str(m_ast.token(expr), m_src)[0], CHAR);
+
+			case NodeKind::term_const:
+				return imm((int64_t)((uint64_t)b << 32 | a), type);
+
+			case NodeKind::term_ident:
+			{
+				//the declared type, the checker may have overwritten this node's type column
+				const DataType var_type = m_symbols[b].types.type;
+				if (rvalue)
+					return emit_value({.op = IrOp::load_slot, .type = var_type, .imm = b}, var_type);
+				return emit_value({.op = IrOp::slot_addr, .imm = b}, PTR);
+			}
+
+			case NodeKind::term_paren:
+				return build_expr(a);
+
+			case NodeKind::bin_add:
+				return build_binary(expr, IrOp::add);
+			case NodeKind::bin_sub:
+				return build_binary(expr, IrOp::sub);
+			case NodeKind::bin_multi:
+				return build_binary(expr, IrOp::mul);
+			case NodeKind::bin_div:
+				return build_binary(expr, IrOp::div);
+			case NodeKind::bin_mod:
+				return build_binary(expr, IrOp::mod);
+			case NodeKind::bin_cmp:
+				return build_cmp(expr);
+
+			case NodeKind::un_dref:
+			{
+				if (rvalue)
+				{
+					const Address address = build_address(expr);
+					return emit_value({.op = IrOp::load, .type = type, .a = address.base, .index = address.index, .imm = address.disp}, type);
+				}
+
+				uint32_t address = build_expr(a);
+				if (b != NO_NODE)
+				{
+					const uint32_t index = build_expr(b);
+					const uint32_t offset = emit_value({.op = IrOp::mul, .a = index, .b = imm(m_Table[type].type_size, INT)}, INT);
+					address = emit_value({.op = IrOp::add, .a = address, .b = offset}, PTR);
+				}
+
+				return address;
+			}
+
+			case NodeKind::un_increment:
+			{
+				if (rvalue && m_ast.kind[a] == NodeKind::term_ident)
+					return build_slot_increment(expr);
+
+				if (rvalue && m_ast.kind[a] == NodeKind::un_dref)
+				{
+					const Address address = build_address(a);
+					const uint32_t amount = b != NO_NODE ? build_expr(b) : imm(1, INT);
+
+					const uint32_t old = emit_value({.op = IrOp::load, .type = type, .a = address.base, .index = address.index, .imm = address.disp}, type);
+					const uint32_t sum = emit_value({.op = IrOp::add, .a = old, .b = amount}, type);
+					emit({.op = IrOp::store, .type = type, .a = address.base, .b = sum, .index = address.index, .imm = address.disp});
+					return old;
+				}
+
+				const uint32_t address = build_expr(a);
+				const uint32_t amount = b != NO_NODE ? build_expr(b) : imm(1, INT);
+
+				const uint32_t old = emit_value({.op = IrOp::load, .type = type, .a = address}, type);
+				const uint32_t sum = emit_value({.op = IrOp::add, .a = old, .b = amount}, type);
+				emit({.op = IrOp::store, .type = type, .a = address, .b = sum});
+				return rvalue ? old : address;
+			}
+
+			case NodeKind::un_addr:
+				if (!rvalue)
+					{std::cerr << "& cannot be an expression of type LVALUE\n"; exit(EXIT_FAILURE);}
+
+				return build_expr(a);
+
+			default:
+				std::cerr << "Expected an expression node\n";
+				exit(EXIT_FAILURE);
+		}
+	}
+};
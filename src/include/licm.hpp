@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "./ir.hpp"
+
+//Moves loop invariant computations into the preheader of their loop. Runs after SlotPromoter
+//on loops as IrBuilder lays them out: a preheader that only jumps to the first body block,
+//the body blocks in order, and a latch branching back to the first one.
+//
+//An instruction moves when it has no side effects and cannot fault, its result is set
+//nowhere else and never read before that in its block, and nothing that stays in the loop
+//sets its operands. Hoisted code runs even when the body would have skipped it, so loads,
+//div and mod stay where they are. Inner loops go first, what they hoist can move on out of
+//the enclosing loop.
+class LoopHoister {
+public:
+	inline LoopHoister(IrProgram& prog) : m_prog(prog) {}
+
+	//Returns the number of instructions hoisted
+	inline uint32_t hoist() {
+		scan_defs();
+		find_loops();
+
+		m_inside.assign(m_prog.vregs.size(), NO_LOOP);
+		for (uint32_t l = 0; l < m_loops.size(); l++)
+			hoist_loop(l);
+
+		return m_hoisted;
+	}
+
+private:
+	static constexpr uint32_t NO_LOOP = UINT32_MAX;
+
+	struct Loop
+	{
+		uint32_t header;
+		uint32_t latch;
+	};
+
+	IrProgram& m_prog;
+	uint32_t m_hoisted = 0;
+
+	std::vector<uint32_t> m_defs;           //virtual register -> number of definitions
+	std::vector<bool> m_exposed;            //read somewhere its definition does not come first in the block
+	std::vector<uint32_t> m_inside;         //virtual register -> loop it is still set in
+	std::vector<Loop> m_loops;              //innermost first
+
+	inline void scan_defs() {
+		m_defs.assign(m_prog.vregs.size(), 0);
+		m_exposed.assign(m_prog.vregs.size(), false);
+		std::vector<uint32_t> def_block(m_prog.vregs.size(), NO_BLOCK);
+
+		for (uint32_t b = 0; b < m_prog.blocks.size(); b++)
+		{
+			auto use = [&](uint32_t v) {
+				if (v != NO_VREG && def_block[v] != b)
+					m_exposed[v] = true;
+			};
+
+			for (const IrInst& inst : m_prog.blocks[b].insts)
+			{
+				use(inst.a);
+				use(inst.b);
+				use(inst.index);
+				if (inst.dst != NO_VREG)
+				{
+					def_block[inst.dst] = b;
+					m_defs[inst.dst]++;
+				}
+			}
+			use(m_prog.blocks[b].term.a);
+			use(m_prog.blocks[b].term.b);
+		}
+	}
+
+	//A back edge goes to a block at or before its source. Loops whose header is entered
+	//from anywhere but the preheader right before it are left alone.
+	inline void find_loops() {
+		const uint32_t blocks = m_prog.blocks.size();
+		std::vector<uint32_t> latch(blocks, NO_BLOCK);
+		std::vector<uint32_t> entries(blocks, 0);
+
+		for (uint32_t b = 0; b < blocks; b++)
+		{
+			const auto [first, second] = m_prog.successors(b);
+			for (const uint32_t succ : {first, second})
+			{
+				if (succ == NO_BLOCK)
+					continue;
+				if (succ <= b)
+					latch[succ] = b;
+				else
+					entries[succ]++;
+			}
+		}
+
+		for (uint32_t h = 1; h < blocks; h++)
+		{
+			const IrBlock& preheader = m_prog.blocks[h - 1];
+			if (latch[h] != NO_BLOCK && entries[h] == 1 && preheader.term.kind == IrTermKind::jmp && preheader.term.target == h)
+				m_loops.push_back({h, latch[h]});
+		}
+
+		std::stable_sort(m_loops.begin(), m_loops.end(), [](const Loop& l, const Loop& r) {
+			return l.latch - l.header < r.latch - r.header;
+		});
+	}
+
+	static inline bool movable(IrOp op) {
+		switch (op)
+		{
+			case IrOp::imm:
+			case IrOp::copy:
+			case IrOp::zext:
+			case IrOp::slot_addr:
+			case IrOp::add:
+			case IrOp::sub:
+			case IrOp::mul:
+			case IrOp::and_:
+			case IrOp::mulhi:
+			case IrOp::shl:
+			case IrOp::shr:
+			case IrOp::set:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	inline bool set_inside(uint32_t v, uint32_t loop) const {
+		return v != NO_VREG && m_inside[v] == loop;
+	}
+
+	inline void hoist_loop(uint32_t loop) {
+		const auto [header, latch] = m_loops[loop];
+
+		for (uint32_t b = header; b <= latch; b++)
+			for (const IrInst& inst : m_prog.blocks[b].insts)
+				if (inst.dst != NO_VREG)
+					m_inside[inst.dst] = loop;
+
+		std::vector<IrInst>& preheader = m_prog.blocks[header - 1].insts;
+		for (uint32_t b = header; b <= latch; b++)
+		{
+			std::vector<IrInst>& insts = m_prog.blocks[b].insts;
+			size_t kept = 0;
+			for (size_t i = 0; i < insts.size(); i++)
+			{
+				const IrInst& inst = insts[i];
+				if (movable(inst.op) && m_defs[inst.dst] == 1 && !m_exposed[inst.dst]
+				    && !set_inside(inst.a, loop) && !set_inside(inst.b, loop) && !set_inside(inst.index, loop))
+				{
+					m_inside[inst.dst] = NO_LOOP;
+					preheader.push_back(inst);
+					m_hoisted++;
+					continue;
+				}
+				insts[kept++] = inst;
+			}
+			insts.resize(kept);
+		}
+	}
+};
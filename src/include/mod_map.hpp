@@ -1,40 +1,48 @@
 #pragma once
 
-#include <unordered_map>
+#include <optional>
+#include <utility>
+#include <vector>
 
 
+//Flat map keyed by Interner id that remembers insertion order, so a scope can pop
+//the symbols it declared. Inserting over a live key shadows it, popping brings it back.
 template <typename Val_t>
 class Modded_map {
 public:
-	
+
 	inline size_t size() {
-		return map.size();
+		return elements.size();
 	}
 
-	inline Val_t& at(const std::string& key) {
-		return map.at(key);
+	inline Val_t& at(uint32_t key) {
+		return map[key].value();
 	}
 
-	inline bool contains(const std::string& key)
+	inline bool contains(uint32_t key)
 	{
-		return map.contains(key);
+		return key < map.size() && map[key].has_value();
 	}
 
-	inline void insert(std::string& key, const Val_t& val)
+	inline void insert(uint32_t key, const Val_t& val)
 	{
-		map.insert({key, val});
-		elements.push_back(key);
+		if (key >= map.size())
+			map.resize(key + 1);
+
+		elements.push_back({key, std::move(map[key])});
+		map[key] = val;
 	}
 
 	inline Val_t pop_back() {
-		const Val_t data = map.at(elements.back());
-		map.erase(elements.back());
+		auto& [key, shadowed] = elements.back();
+		const Val_t data = map[key].value();
+		map[key] = std::move(shadowed);
 		elements.pop_back();
 
 		return data;
 	}
 
 private:
-	std::unordered_map<std::string, Val_t> map;
-	std::vector<std::string> elements;
+	std::vector<std::optional<Val_t>> map;
+	std::vector<std::pair<uint32_t, std::optional<Val_t>>> elements;   //key and the value it shadowed
 };
@@ -1,483 +1,345 @@
 #pragma once
 
-#include <variant>
+#include <charconv>
 
 #include "./tokenizer.hpp"
 #include "./types.hpp"
-#include "./arena.hpp"
+#include "./ast.hpp"
 
-
-
-enum class EXPRTYPE {
-	RVALUE,
-	LVALUE
-};
-
-
-//EXPRESSIONS		//TODO fix redundent structs
-struct NodeExpr;
-
-struct NodeTermInt {
-	Token int_lit;
-};
-
-struct NodeTermChar {
-	Token char_lit;
-};
-
-
-struct NodeTermIdent {
-	Token ident;
-};
-
-struct NodeTermParen {
-	NodeExpr* expr;
-};
-
-
-struct NodeTerm {
-	std::variant<NodeTermInt*,NodeTermChar*, NodeTermIdent*, NodeTermParen*> var;
-};
-
-struct NodeBinExprAdd {
-	NodeExpr* lhs;
-	NodeExpr* rhs;	
-};
-
-struct NodeBinExprSub {
-	NodeExpr* lhs;
-	NodeExpr* rhs;
-};
-
-struct NodeBinExprMulti {
-	NodeExpr* lhs;
-	NodeExpr* rhs;
-};
-
-struct NodeBinExprDiv {
-	NodeExpr* lhs;
-	NodeExpr* rhs;
-};
-
-struct NodeBinExprMod {
-	NodeExpr* lhs;
-	NodeExpr* rhs;
-};
-
-struct NodeBinExprCmp {
-	TokenType cmp_op;
-	NodeExpr* lhs;
-	NodeExpr* rhs;
-};
-
-struct NodeBinExpr {
-	std::variant<NodeBinExprAdd*, NodeBinExprSub*, NodeBinExprMulti*, NodeBinExprDiv*,NodeBinExprMod*, NodeBinExprCmp*> var;	
-};
-
-struct NodeUnExprDref {
-	NodeExpr* lvalue_expr;
-	std::optional<NodeExpr*> rvalue_expr;
-};
-
-struct NodeUnExprIncrement {
-	NodeExpr* lvalue_expr;
-	std::optional<NodeExpr*> rvalue_expr;
-};
-
-struct NodeUnExprAddr {
-	NodeExpr* lvalue_expr;
-};
-
-struct NodeUnExpr {
-	std::variant<NodeUnExprDref*, NodeUnExprIncrement*, NodeUnExprAddr*> var;
-};
-
-struct NodeExpr {
-	std::variant<NodeTerm*, NodeBinExpr*, NodeUnExpr*> var;
-	DataType type;
-	EXPRTYPE expr_type;
-};
-
-//STATEMENTS
-struct NodeStmt;
-
-struct NodeStmtScope {
-	std::vector<NodeStmt*> stmts;
-};
-
-struct NodeStmtExit {
-	NodeExpr* expr;
-};
-
-struct NodeStmtDeclare {
-	Token ident;
-	DataType type;
-	size_t count;
-	std::optional<DataType> pointed_type;
-};
-
-struct NodeStmtAssign {
-	NodeExpr* lvalue_expr;
-	std::optional<NodeExpr*> rvalue_expr;
-};
-
-struct NodeStmtWrite {
-	std::variant<NodeExpr*, std::string> var;
-	std::optional<NodeExpr*> no_of_bytes;
-	bool nl;
-};
-
-struct NodeIfChain;
-
-struct NodeChainElif {
-	NodeExpr* expr;
-	NodeStmt* stmt;
-	std::optional<NodeIfChain*> chain;
-};
-
-struct NodeChainElse {
-	NodeStmt* stmt;
-};
-
-struct NodeIfChain {
-	std::variant<NodeChainElif*, NodeChainElse*> var;
-};
-
-struct NodeStmtIf {
-	NodeExpr* expr;
-	NodeStmt* stmt;
-	std::optional<NodeIfChain*> chain;
-};
-
-struct NodeStmtLoop {
-	NodeExpr* expr;
-	NodeStmt* scope;
-};
-
-struct NodeStmt {
-	std::variant<NodeStmtExit*, NodeStmtDeclare*, NodeStmtAssign*, NodeStmtScope*, NodeStmtIf*, NodeStmtLoop*, NodeStmtWrite*> var;
-};
-
-
-struct NodeProg {
-	std::vector<NodeStmt*> stmts;
-};
+#define PARSER_PULL_TOKENS 256
 
 class Parser {
 public:
-	inline Parser(std::vector<Token> tokens) 
-		: m_tokens(std::move(tokens)), m_index(0), m_allocater(1024 * 1024)
+	inline Parser(std::vector<Token> tokens, std::string_view src) 
+		: m_tokens(std::move(tokens)), m_src(src), m_index(0)
+	{
+		//every node consumes at least one token
+		m_ast.reserve(m_tokens.size());
+	}
+
+	//Streaming: tokens are pulled from a TokenSource only as the parser reaches them
+	inline Parser(TokenSource& tokens, std::string_view src)
+		: m_src(src), m_index(0), m_lexer(&tokens)
 	{
 	}
 
-	inline std::optional<NodeProg *> parse_prog() {
-		NodeProg* output = m_allocater.alloc<NodeProg>();
-		while (peak().has_value())
+	inline std::optional<Ast*> parse_prog() {
+		while (peak())
 		{
 			if (auto stmt = parse_stmt())
 			{
-				output->stmts.push_back(stmt.value());			 
+				m_ast.stmts.push_back(stmt.value());			 
 			} else {
 				std::cerr << "Invalid statement. fix that shit\n";
 				exit(EXIT_FAILURE);
 			  }
 		}
 
-		return output;
+		return &m_ast;
+	}
+
+	//Streaming: parses the next top level statement into a cleared Ast, nullopt at end of input.
+	//Nodes and tokens of the previous statement are dropped, so memory tracks one statement.
+	inline std::optional<uint32_t> parse_next() {
+		m_ast.clear();
+
+		//keep the last consumed token, errors report its line
+		if (m_index > 1)
+		{
+			m_tokens.erase(m_tokens.begin(), m_tokens.begin() + (m_index - 1));
+			m_index = 1;
+		}
+
+		if (!peak())
+			return std::nullopt;
+
+		if (auto stmt = parse_stmt())
+			return stmt;
+
+		std::cerr << "Invalid statement. fix that shit\n";
+		exit(EXIT_FAILURE);
+	}
+
+	inline Ast* ast() {
+		return &m_ast;
+	}
+
+	//source offset before which no buffered token starts
+	inline size_t consumed_offset() const {
+		return m_tokens.empty() ? 0 : m_tokens.front().offset;
 	}
 
 private:
 	std::vector<Token> m_tokens;
+	std::string_view m_src;
 	size_t m_index;
+	TokenSource* m_lexer = nullptr;       //set in streaming mode, m_tokens is then a sliding window
 	
-	ArenaAllocater m_allocater;
+	Ast m_ast;
+	std::vector<uint32_t> m_list_stack;     //statements of the scopes still being parsed
 	
 	//UTILITY METHODS
-	inline std::optional<Token> peak(int jump = 0) const {
+	//Tokens are handed out by reference into m_tokens, nullptr means end of input.
+	//In streaming mode a peak can pull more tokens, so references only live until the next peak.
+	inline const Token* peak(int jump = 0) {
+		if (m_lexer && jump >= 0)
+		{
+			while (m_index + jump >= m_tokens.size() && m_lexer->pull(m_tokens, PARSER_PULL_TOKENS)) {}
+		}
+
 		if (m_index + jump >= m_tokens.size() )
-			return std::nullopt;
-		return m_tokens.at(m_index + jump);
+			return nullptr;
+		return &m_tokens[m_index + jump];
 	}
-	inline Token consume() {
-		return m_tokens.at(m_index++);
+	inline const Token& consume() {
+		return m_tokens[m_index++];
 	}
 
 	inline Token try_consume_exit(TokenType type) {
-		if (peak().has_value() && peak().value().type == type)
+		if (peak() && peak()->type == type)
 			return consume();
 		
 		EXIT_WARNING(type_to_str(type));
-		return {};
 	}
 
-	inline std::optional<Token> try_consume(TokenType type) {
-		if (peak().has_value() && peak().value().type == type)
-			return consume();
-		return std::nullopt;
+	inline const Token* try_consume(TokenType type) {
+		if (peak() && peak()->type == type)
+			return &consume();
+		return nullptr;
 	}
 
-	inline void EXIT_WARNING(const std::string& expected) {
-		std::cerr << "[Parser] |LINE <" << peak(-1).value().line << ">| Expected " << expected << '\n';
+	[[noreturn]] inline void EXIT_WARNING(const std::string& expected) {
+		const Token* prev = peak(-1);
+		std::cerr << "[Parser] |LINE <" << (prev ? prev->line : 1) << ">| Expected " << expected << '\n';
 		exit(EXIT_FAILURE);
 	}	
 
 	//EXPRESSION PARSE
+	//Expressions are parsed without recursion. Operands and pending binary operators sit on
+	//explicit stacks, and every construct that wraps a nested expression (parentheses and the
+	//unary operators) opens a frame that is closed once its inner expression ends.
 
-	inline std::optional<NodeTerm*> parse_term() {
-		if (auto tok_int = try_consume(TokenType::int_lit))
-		{
-			auto term_int = m_allocater.alloc<NodeTermInt>();
-			term_int->int_lit = tok_int.value();
-			auto term = m_allocater.alloc<NodeTerm>();
-			term->var = term_int;
+	enum class ExprFrameKind : uint8_t
+	{
+		root,
+		paren,
+		dref_target,
+		dref_offset,        //node: dref target
+		inc_target,
+		inc_amount,         //node: increment target
+		addr_target
+	};
+
+	struct ExprFrame
+	{
+		ExprFrameKind kind;
+		uint32_t node;
+		size_t operators;   //operator stack height when the frame was opened
+	};
 
-			return term;
-		}
+	std::vector<uint32_t> m_operands;
+	std::vector<Token> m_operators;
+	std::vector<ExprFrame> m_frames;
 
-		if (auto tok_char = try_consume(TokenType::char_lit))
+	inline uint32_t make_expr_bin(uint32_t lhs, uint32_t rhs, const Token& op) {
+		switch (op.type)
 		{
-			auto term_char = m_allocater.alloc<NodeTermChar>();
-			term_char->char_lit = tok_char.value();
-			auto term = m_allocater.alloc<NodeTerm>();
-			term->var = term_char;
-
-			return term;
+			case TokenType::plus:
+				return m_ast.add(NodeKind::bin_add, lhs, rhs);
+			case TokenType::minus:
+				return m_ast.add(NodeKind::bin_sub, lhs, rhs);
+			case TokenType::star:
+				return m_ast.add(NodeKind::bin_multi, lhs, rhs);
+			case TokenType::fslash:
+				return m_ast.add(NodeKind::bin_div, lhs, rhs);
+			case TokenType::modulo:
+				return m_ast.add(NodeKind::bin_mod, lhs, rhs);
+			case TokenType::g_than:
+			case TokenType::l_than:
+			case TokenType::eq_to:
+			case TokenType::not_eq_to:
+				return m_ast.add(NodeKind::bin_cmp, lhs, rhs, (uint32_t)op.type);
+			default:
+				std::cerr << "Unreachable edge case, how tf you get here? anyways expected binary expression :(\n";
+				exit(EXIT_FAILURE);
 		}
+	}
 
-		else if (auto tok_ident = try_consume(TokenType::ident))
-		{
-			auto term_ident = m_allocater.alloc<NodeTermIdent>();
-			term_ident->ident = tok_ident.value();
-			auto term = m_allocater.alloc<NodeTerm>();
-			term->var = term_ident;
-
-			return term;
-		}
+	inline void open_frame(ExprFrameKind kind, uint32_t node = NO_NODE) {
+		m_frames.push_back({kind, node, m_operators.size()});
+	}
 
-		else if (auto tok_paren = try_consume(TokenType::open_paren))
+	//Folds the operators of the innermost frame that bind at least as tight as min_prec
+	inline void reduce_operators(int min_prec) {
+		while (m_operators.size() > m_frames.back().operators
+		       && bin_op_prec(m_operators.back()).value() >= min_prec)
 		{
-			auto expr = parse_expr();
-			if (!expr.has_value()) {
-				EXIT_WARNING("expression");
-			}
+			const Token op = m_operators.back();
+			m_operators.pop_back();
 
-			try_consume_exit(TokenType::close_paren);
-			
-			auto term_paren = m_allocater.alloc<NodeTermParen>();
-			term_paren->expr = expr.value();
-			auto term = m_allocater.alloc<NodeTerm>();
-			term->var = term_paren;
+			const uint32_t rhs = m_operands.back();
+			m_operands.pop_back();
+			const uint32_t lhs = m_operands.back();
 
-			return term;
+			m_operands.back() = make_expr_bin(lhs, rhs, op);
 		}
-
-		return std::nullopt;
 	}
 
-	inline NodeExpr* make_expr_bin(NodeExpr* lhs, NodeExpr* rhs, const Token& op) {
-		NodeExpr* out = m_allocater.alloc<NodeExpr>();
-		NodeBinExpr* bin_expr = m_allocater.alloc<NodeBinExpr>();
-
-		if (op.type == TokenType::plus)
-		{
-			auto bin_expr_add = m_allocater.alloc<NodeBinExprAdd>();	
-			bin_expr_add->lhs = lhs;
-			bin_expr_add->rhs = rhs;
-		
-			bin_expr->var = bin_expr_add;
-			out->var = bin_expr;
+	//Tries to push a literal, identifier or the start of a wrapping construct.
+	//Returns false if the next token cannot begin an operand.
+	inline bool parse_operand() {
+		if (auto tok_int = try_consume(TokenType::int_lit))
+			m_operands.push_back(m_ast.add(NodeKind::term_int, m_ast.add_token(*tok_int)));
 
-			return out;
-		}				
-		
-		else if (op.type == TokenType::minus)
-		{
-			auto bin_expr_sub = m_allocater.alloc<NodeBinExprSub>();
-			bin_expr_sub->lhs = lhs;
-			bin_expr_sub->rhs = rhs;
-				
-			bin_expr->var = bin_expr_sub;
-			out->var = bin_expr;
-				
-			return out;
-		}
-		
-		else if (op.type == TokenType::star)
-		{
-			auto bin_expr_multi = m_allocater.alloc<NodeBinExprMulti>();
-			bin_expr_multi->lhs = lhs;
-			bin_expr_multi->rhs = rhs;
-			
-			bin_expr->var = bin_expr_multi;
-			out->var = bin_expr;
-				
-			return out;
-		}
+		else if (auto tok_char = try_consume(TokenType::char_lit))
+			m_operands.push_back(m_ast.add(NodeKind::term_char, m_ast.add_token(*tok_char)));
 
-		else if (op.type == TokenType::fslash)		
-		{
-			auto bin_expr_fslash = m_allocater.alloc<NodeBinExprDiv>();
-			bin_expr_fslash->lhs = lhs;
-			bin_expr_fslash->rhs = rhs;
-				
-			bin_expr->var = bin_expr_fslash;	
-			out->var = bin_expr;
-			
-			return out;
-		}
+		else if (auto tok_ident = try_consume(TokenType::ident))
+			m_operands.push_back(m_ast.add(NodeKind::term_ident, m_ast.add_token(*tok_ident)));
 
-		else if (op.type == TokenType::modulo)
-		{
-			auto bin_expr_mod = m_allocater.alloc<NodeBinExprMod>();
-			bin_expr_mod->lhs = lhs;
-			bin_expr_mod->rhs = rhs;
+		else if (try_consume(TokenType::open_paren))
+			open_frame(ExprFrameKind::paren);
 
-			bin_expr->var = bin_expr_mod;
-			out->var = bin_expr;
+		else if (try_consume(TokenType::dref))
+			open_frame(ExprFrameKind::dref_target);
 
-			return out;
+		else if (try_consume(TokenType::plus))
+		{
+			try_consume_exit(TokenType::plus);
+			open_frame(ExprFrameKind::inc_target);
 		}
 
-		else if (op.type == TokenType::g_than ||
-			 op.type == TokenType::l_than ||
-			 op.type == TokenType::eq_to  ||
-			 op.type == TokenType::not_eq_to)
-		{
-			auto bin_expr_cmp = m_allocater.alloc<NodeBinExprCmp>();
-			bin_expr_cmp->cmp_op = op.type;
-			bin_expr_cmp->lhs = lhs;
-			bin_expr_cmp->rhs = rhs;
+		else if (try_consume(TokenType::addr_of))
+			open_frame(ExprFrameKind::addr_target);
 
-			bin_expr->var = bin_expr_cmp;
-			out->var = bin_expr;
+		else return false;
 
-			return out;
-		}
+		return true;
+	}
+
+	[[noreturn]] inline void missing_operand() {
+		const ExprFrame& frame = m_frames.back();
+		if (m_operators.size() > frame.operators)
+			EXIT_WARNING("Expression");
 
-		else {
-			std::cerr << "Unreachable edge case, how tf you get here? anyways expected binary expression :(\n";
-			exit(EXIT_FAILURE);
+		switch (frame.kind)
+		{
+			case ExprFrameKind::paren:
+				EXIT_WARNING("expression");
+			case ExprFrameKind::dref_target:
+				EXIT_WARNING("Target Expression");
+			case ExprFrameKind::dref_offset:
+				EXIT_WARNING("Offset Expression");
+			default:
+				EXIT_WARNING("Expression");
 		}
 	}
 
-	inline std::optional<NodeUnExpr*> parse_un_expr() {
-			
-			NodeUnExpr* un_expr = m_allocater.alloc<NodeUnExpr>();
+	inline std::optional<uint32_t> parse_expr(EXPRTYPE type = EXPRTYPE::RVALUE) {
+		const size_t base = m_frames.size();
+		open_frame(ExprFrameKind::root);
+		bool want_operand = true;
 
-			if (try_consume(TokenType::dref))
+		while (true)
+		{
+			if (want_operand)
 			{
-				auto dref = m_allocater.alloc<NodeUnExprDref>();
-			
-				if (auto expr = parse_expr())
-					dref->lvalue_expr = expr.value();
-				else EXIT_WARNING("Target Expression");
-
-				if (try_consume(TokenType::tilde))
+				const size_t frames = m_frames.size();
+				if (!parse_operand())
 				{
-					if (auto expr = parse_expr())
+					if (m_frames.size() == base + 1 && m_operators.size() == m_frames.back().operators)
 					{
-						try_consume_exit(TokenType::tilde);
-						dref->rvalue_expr = expr.value();
-					} else {
-						EXIT_WARNING("Offset Expression");
-				  	  }
-
-					dref->lvalue_expr->expr_type = EXPRTYPE::LVALUE;
+						m_frames.pop_back();
+						return std::nullopt;
+					}
+					missing_operand();
 				}
-			
-				un_expr->var = dref;
+
+				//a new frame still needs its first operand
+				want_operand = m_frames.size() != frames;
+				continue;
 			}
 
-			else if (try_consume(TokenType::plus))
+			const Token* cur = peak();
+			if (auto prec = cur ? bin_op_prec(*cur) : std::nullopt)
 			{
-				try_consume_exit(TokenType::plus);
-
-				auto increment = m_allocater.alloc<NodeUnExprIncrement>();
-				if (auto expr = parse_expr(0, EXPRTYPE::LVALUE))
-					increment->lvalue_expr = expr.value();
-				else EXIT_WARNING("Expression");
-
-				if (try_consume(TokenType::l_than))
-				{
-					if (auto expr = parse_expr())
-						increment->rvalue_expr = expr.value();
-					else EXIT_WARNING("Expression");
+				//left associative, equal precedence folds before the new operator goes on
+				reduce_operators(prec.value());
+				m_operators.push_back(consume());
+				want_operand = true;
+				continue;
+			}
 
-					try_consume_exit(TokenType::g_than);
-				}
+			//the innermost expression ended, hand its value to the frame that opened it
+			reduce_operators(0);
+			const uint32_t expr = m_operands.back();
+			m_operands.pop_back();
 
-				un_expr->var = increment;
-			}
+			const ExprFrame frame = m_frames.back();
+			m_frames.pop_back();
 
-			else if (try_consume(TokenType::addr_of))
+			switch (frame.kind)
 			{
-				auto addr = m_allocater.alloc<NodeUnExprAddr>();
-			       	if (auto expr = parse_expr(0, EXPRTYPE::LVALUE))
-					addr->lvalue_expr = expr.value();
-				else EXIT_WARNING("Expression");
+				case ExprFrameKind::root:
+					m_ast.expr_type[expr] = type;
+					return expr;
 
-				un_expr->var = addr;
-			}
+				case ExprFrameKind::paren:
+					try_consume_exit(TokenType::close_paren);
+					m_operands.push_back(m_ast.add(NodeKind::term_paren, expr));
+					break;
 
-			else return std::nullopt;
+				case ExprFrameKind::dref_target:
+					if (try_consume(TokenType::tilde))
+					{
+						m_ast.expr_type[expr] = EXPRTYPE::LVALUE;
+						open_frame(ExprFrameKind::dref_offset, expr);
+						want_operand = true;
+					}
+					else m_operands.push_back(m_ast.add(NodeKind::un_dref, expr));
+					break;
 
-			return un_expr;
-		}
+				case ExprFrameKind::dref_offset:
+					try_consume_exit(TokenType::tilde);
+					m_operands.push_back(m_ast.add(NodeKind::un_dref, frame.node, expr));
+					break;
 
-	inline std::optional<NodeExpr*> parse_expr(int min_prec = 0, EXPRTYPE type = EXPRTYPE::RVALUE) {        //TODO Unary Expression support			
-		auto lhs_expr = m_allocater.alloc<NodeExpr>();
+				case ExprFrameKind::inc_target:
+					m_ast.expr_type[expr] = EXPRTYPE::LVALUE;
+					if (try_consume(TokenType::l_than))
+					{
+						open_frame(ExprFrameKind::inc_amount, expr);
+						want_operand = true;
+					}
+					else m_operands.push_back(m_ast.add(NodeKind::un_increment, expr));
+					break;
 
-		if (auto lhs_term = parse_term())
-		{
-			lhs_expr->var = lhs_term.value();
+				case ExprFrameKind::inc_amount:
+					try_consume_exit(TokenType::g_than);
+					m_operands.push_back(m_ast.add(NodeKind::un_increment, frame.node, expr));
+					break;
 
-			while(true)
-			{
-				auto cur = peak();
-				if (cur.has_value())
-				{
-					auto prec = bin_op_prec(cur.value());
-					if (!prec.has_value() || prec < min_prec)
-						break;
-				} else {
+				case ExprFrameKind::addr_target:
+					m_ast.expr_type[expr] = EXPRTYPE::LVALUE;
+					m_operands.push_back(m_ast.add(NodeKind::un_addr, expr));
 					break;
-				  }
-				
-				consume();
-
-				if (auto rhs_expr = parse_expr(min_prec + 1))
-				{	
-					NodeExpr* expr_bin = make_expr_bin(lhs_expr, rhs_expr.value(), cur.value());
-					lhs_expr = expr_bin;
-				} else {
-					EXIT_WARNING("Expression");
-				  }
-			}	
-		}
-	       
-		else if	(auto un_expr = parse_un_expr())
-		{
-			lhs_expr->var = un_expr.value();
+			}
 		}
-		
-		else {
-			return std::nullopt;
-		  }
-
-		lhs_expr->expr_type = type;
-		return lhs_expr;
 	}
 	
 	//STATEMENTS PARSE
 
-	inline std::optional<NodeIfChain*> parse_if_chain() {
+	inline std::optional<uint32_t> parse_if_chain() {
 		if (try_consume(TokenType::elif))
 		{
-			auto elif = m_allocater.alloc<NodeChainElif>();
+			uint32_t expr_node = NO_NODE;
+			uint32_t stmt_node = NO_NODE;
+			uint32_t chain_node = NO_NODE;
+
 			try_consume_exit(TokenType::v_bar);
 			
 			if (auto expr = parse_expr())
-				elif->expr = expr.value();
+				expr_node = expr.value();
 			else {
 				EXIT_WARNING("expression in elif statemnet");
 			}
@@ -485,65 +347,59 @@ private:
 			try_consume_exit(TokenType::v_bar);
 
 			if (auto stmt = parse_stmt())
-				elif->stmt = stmt.value();
+				stmt_node = stmt.value();
 			else {
 				EXIT_WARNING("Statment");
 			}
 
 			if (auto elif_chain = parse_if_chain())
-				elif->chain = elif_chain.value();
+				chain_node = elif_chain.value();
 
-			auto chain = m_allocater.alloc<NodeIfChain>();
-			chain->var = elif;
-
-			return chain;
+			return m_ast.add(NodeKind::chain_elif, expr_node, stmt_node, chain_node);
 		}
 
 		else if (try_consume(TokenType::_else))
 		{
-			auto _else = m_allocater.alloc<NodeChainElse>();
+			uint32_t stmt_node = NO_NODE;
 			if (auto stmt = parse_stmt())
-				_else->stmt = stmt.value();
+				stmt_node = stmt.value();
 			else {
 				EXIT_WARNING("Statement");
 			}
 
-			auto chain = m_allocater.alloc<NodeIfChain>();
-			chain->var = _else;
-
-			return chain;
+			return m_ast.add(NodeKind::chain_else, NO_NODE, stmt_node);
 		}
 
 		return std::nullopt;
 	}
 
 	//MAIN STATEMENT FUNCTION
-	inline std::optional<NodeStmt *> parse_stmt() {
-		NodeStmt* stmt = m_allocater.alloc<NodeStmt>();
+	inline std::optional<uint32_t> parse_stmt() {
 
 		if (try_consume(TokenType::exit))
 		{
-			NodeStmtExit* exit = m_allocater.alloc<NodeStmtExit>();
+			uint32_t expr_node = NO_NODE;
 
 			try_consume_exit(TokenType::open_paren);
 			
 			if (auto expr = parse_expr())
-				exit->expr = expr.value();
+				expr_node = expr.value();
 			else EXIT_WARNING("Expression");
 			
 			try_consume_exit(TokenType::close_paren);
 			try_consume_exit(TokenType::semi);
 
-			stmt->var = exit;
-			return stmt;
+			return m_ast.add(NodeKind::stmt_exit, expr_node);
 		}
 
 		else if (auto data_type = try_consume(TokenType::data_type))
 		{
-			auto declare = m_allocater.alloc<NodeStmtDeclare>();
-			
 			DataType type;
-			const std::string type_name = data_type.value().value.value();
+			DataType decl_type;
+			uint32_t pointed_type = NO_NODE;
+			size_t count = 1;
+
+			const std::string_view type_name = token_str(*data_type, m_src);
 			if      (type_name == "int")
 					type = INT;
 			else if (type_name == "char")
@@ -551,68 +407,71 @@ private:
 
 			if (try_consume(TokenType::ptr))	
 			{
-				declare->type = PTR;
-				declare->pointed_type = type;
+				decl_type = PTR;
+				pointed_type = type;
 			}
-			else {declare->type = type;}
+			else {decl_type = type;}
 			
 			if (try_consume(TokenType::tilde))     
 			{
-				auto int_lit = try_consume_exit(TokenType::int_lit);
+				const Token int_lit = try_consume_exit(TokenType::int_lit);
 				try_consume_exit(TokenType::tilde);
 
-				declare->count = (size_t)std::stoi(int_lit.value.value());
-			} else {
-				declare->count = 1;
-			  }
+				const std::string_view count_str = token_str(int_lit, m_src);
+				std::from_chars(count_str.data(), count_str.data() + count_str.size(), count);
+			}
 
-			declare->ident = try_consume_exit(TokenType::ident);
+			const Token ident = try_consume_exit(TokenType::ident);
 			try_consume_exit(TokenType::semi);
 					
-			stmt->var = declare;
-			return stmt;
+			const uint32_t declare = m_ast.add(NodeKind::stmt_declare, m_ast.add_token(ident), (uint32_t)count, pointed_type);
+			m_ast.type[declare] = decl_type;
+			return declare;
 		}
 
-		else if (auto expr = parse_expr(0, EXPRTYPE::LVALUE))
+		else if (auto expr = parse_expr(EXPRTYPE::LVALUE))
 		{	
-			auto assign = m_allocater.alloc<NodeStmtAssign>();
-			assign->lvalue_expr = expr.value();
+			uint32_t rvalue_node = NO_NODE;
 
 			if (try_consume(TokenType::eq))
 			{
 				if (auto rvalue_expr = parse_expr())
-					assign->rvalue_expr = rvalue_expr.value();
+					rvalue_node = rvalue_expr.value();
 				else
 					EXIT_WARNING("Expression");
 			}
 
 			try_consume_exit(TokenType::semi);
 			
-			stmt->var = assign;
-			return stmt;
+			return m_ast.add(NodeKind::stmt_assign, expr.value(), rvalue_node);
 		}
 
 		else if (try_consume(TokenType::open_curly))
 		{
-			NodeStmtScope* scope = m_allocater.alloc<NodeStmtScope>();
+			const size_t first = m_list_stack.size();
 			while (auto stmt = parse_stmt())
-				scope->stmts.push_back(stmt.value());
+				m_list_stack.push_back(stmt.value());
 
 			try_consume_exit(TokenType::close_curly);
 
-			stmt->var = scope;
+			const uint32_t begin = m_ast.lists.size();
+			const uint32_t count = m_list_stack.size() - first;
+			m_ast.lists.insert(m_ast.lists.end(), m_list_stack.begin() + first, m_list_stack.end());
+			m_list_stack.resize(first);
 
-			return stmt;
+			return m_ast.add(NodeKind::stmt_scope, begin, count);
 		}
 
 		else if (try_consume(TokenType::_if))
 		{
+			uint32_t expr_node = NO_NODE;
+			uint32_t stmt_node = NO_NODE;
+			uint32_t chain_node = NO_NODE;
+
 			try_consume_exit(TokenType::v_bar);     
 			
-			NodeStmtIf* if_stmt = m_allocater.alloc<NodeStmtIf>();
-			
 			if (auto expr = parse_expr())
-				if_stmt->expr = expr.value();
+				expr_node = expr.value();
 			else {
 				EXIT_WARNING("Expression");
 			}
@@ -620,66 +479,69 @@ private:
 			try_consume_exit(TokenType::v_bar);
 
 			if (auto stmt = parse_stmt())
-				if_stmt->stmt = stmt.value();
+				stmt_node = stmt.value();
 			else {
 				EXIT_WARNING("Statement");
 			}
 
 			if (auto chain = parse_if_chain())
-				if_stmt->chain = chain.value();
+				chain_node = chain.value();
 
-			stmt->var = if_stmt;
-			
-			return stmt;
+			return m_ast.add(NodeKind::stmt_if, expr_node, stmt_node, chain_node);
 		}
 
 		else if (try_consume(TokenType::loop))
 		{
+			uint32_t expr_node = NO_NODE;
+			uint32_t scope_node = NO_NODE;
+
 			try_consume_exit(TokenType::v_bar);
-			auto loop = m_allocater.alloc<NodeStmtLoop>();
 			
 			if (auto expr = parse_expr())
-				loop->expr = expr.value();
+				expr_node = expr.value();
 			else {
 				EXIT_WARNING("Expression");
 			}
 
 			try_consume_exit(TokenType::v_bar);
 
-			if (!peak().has_value() || peak().value().type != TokenType::open_curly)
+			if (!peak() || peak()->type != TokenType::open_curly)
 			{
 				EXIT_WARNING("Scope");
 			}
 
 			if (auto scope = parse_stmt())
-				loop->scope = scope.value();
+				scope_node = scope.value();
 			else {
 				EXIT_WARNING("Scope");
 			}
 
-			stmt->var = loop;
-			return stmt;
+			return m_ast.add(NodeKind::stmt_loop, expr_node, scope_node);
 		}
 
 		else if (try_consume(TokenType::write))
 		{
-			auto write = m_allocater.alloc<NodeStmtWrite>();
+			NodeKind kind;
+			uint32_t target = NO_NODE;
+			uint32_t bytes = NO_NODE;
 
 			if (auto str_lit = try_consume(TokenType::str_lit))
 			{
-				write->var = str_lit.value().value.value();	
+				kind = NodeKind::stmt_write_str;
+				target = m_ast.add_token(*str_lit);	
 			}
 
 			else if (try_consume(TokenType::v_bar))
 			{
-				if (auto expr = parse_expr(0, EXPRTYPE::LVALUE))
-					write->var = expr.value();
+				kind = NodeKind::stmt_write_expr;
+				if (auto expr = parse_expr(EXPRTYPE::LVALUE))
+					target = expr.value();
 				else EXIT_WARNING("Expression");
 
 				if (try_consume(TokenType::comma))
 				{
 					if (auto expr = parse_expr())
-						write->no_of_bytes = expr.value();
+						bytes = expr.value();
 					else EXIT_WARNING("Expression");
 				}
 
@@ -689,15 +551,15 @@ private:
 				EXIT_WARNING("String literal or an Expression");
 			  }
 			
+			bool nl;
 			if (try_consume(TokenType::l_than) && try_consume(TokenType::g_than))
-				write->nl = true;
+				nl = true;
 			else
-				write->nl = false;
+				nl = false;
 			
 			try_consume_exit(TokenType::semi);
 
-			stmt->var = write;
-			return stmt;
+			return m_ast.add(kind, target, bytes, nl);
 		}
 
 		return std::nullopt;
@@ -0,0 +1,338 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+#include "./ir.hpp"
+#include "./x86.hpp"
+
+//Rewrites short windows of the Emitter's instructions, rule by rule over the whole list,
+//until a pass changes nothing. Deleted instructions become nops and are dropped between
+//passes.
+//
+//Flags only ever live from a cmp or test to the jcc or set right after it, so a rule may
+//drop or change a flag writer as long as the next instruction does not read flags.
+class Peephole {
+public:
+	inline void run(std::vector<X86Inst>& code) {
+		m_code = &code;
+
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			m_passes++;
+			index_labels();
+
+			for (size_t i = 0; i < code.size(); i++)
+			{
+				for (size_t r = 0; r < NO_OF_RULES && code[i].op != X86Op::nop; r++)
+				{
+					if ((this->*s_rules[r].apply)(i))
+					{
+						m_hits[r]++;
+						changed = true;
+					}
+				}
+			}
+
+			std::erase_if(code, [](const X86Inst& inst) {
+				return inst.op == X86Op::nop;
+			});
+		}
+	}
+
+	inline void report(std::ostream& out) const {
+		out << "peephole: " << m_passes << " passes\n";
+		for (size_t r = 0; r < NO_OF_RULES; r++)
+			out << "  " << s_rules[r].name << ": " << m_hits[r] << '\n';
+	}
+
+private:
+	struct Rule
+	{
+		const char* name;
+		bool (Peephole::*apply)(size_t i);
+	};
+
+	static constexpr size_t NO_OF_RULES = 12;
+	static const Rule s_rules[NO_OF_RULES];
+
+	std::vector<X86Inst>* m_code = nullptr;
+	std::vector<size_t> m_label_at;         //block -> index of its label, SIZE_MAX once it is gone
+	std::vector<uint32_t> m_refs;           //block -> jumps to it
+	size_t m_hits[NO_OF_RULES] = {};
+	uint32_t m_passes = 0;
+
+	inline X86Inst& at(size_t i) {
+		return (*m_code)[i];
+	}
+
+	//Index of the first instruction after i that is still there, SIZE_MAX at the end
+	inline size_t next(size_t i) {
+		for (i++; i < m_code->size(); i++)
+			if (at(i).op != X86Op::nop)
+				return i;
+		return SIZE_MAX;
+	}
+
+	inline bool next_reads_flags(size_t i) {
+		const size_t j = next(i);
+		return j != SIZE_MAX && at(j).reads_flags();
+	}
+
+	inline bool is_jump(const X86Inst& inst) const {
+		return inst.op == X86Op::jmp || inst.op == X86Op::jcc;
+	}
+
+	inline void index_labels() {
+		m_label_at.clear();
+		m_refs.clear();
+		for (size_t i = 0; i < m_code->size(); i++)
+		{
+			const X86Inst& inst = at(i);
+			if (inst.op != X86Op::label && !is_jump(inst))
+				continue;
+
+			const size_t block = inst.dst.value;
+			if (block >= m_label_at.size())
+			{
+				m_label_at.resize(block + 1, SIZE_MAX);
+				m_refs.resize(block + 1, 0);
+			}
+			if (inst.op == X86Op::label)
+				m_label_at[block] = i;
+			else
+				m_refs[block]++;
+		}
+	}
+
+	inline void remove(size_t i) {
+		if (is_jump(at(i)))
+			m_refs[at(i).dst.value]--;
+		at(i).op = X86Op::nop;
+	}
+
+	inline void retarget(size_t i, uint32_t block) {
+		m_refs[at(i).dst.value]--;
+		m_refs[block]++;
+		at(i).dst = x86_block(block);
+	}
+
+	//Where a jump to block ends up when the block starts with a jmp, NO_BLOCK when it does not
+	inline uint32_t forwarded(uint32_t block) {
+		uint32_t target = block;
+		for (int hops = 0; hops < 8; hops++)
+		{
+			if (target >= m_label_at.size() || m_label_at[target] == SIZE_MAX)
+				return NO_BLOCK;
+
+			size_t j = next(m_label_at[target]);
+			while (j != SIZE_MAX && at(j).op == X86Op::label)
+				j = next(j);
+			if (j == SIZE_MAX || at(j).op != X86Op::jmp)
+				return target == block ? NO_BLOCK : target;
+
+			target = at(j).dst.value;
+			if (target == block)
+				return NO_BLOCK;        //a loop of jumps
+		}
+		return NO_BLOCK;
+	}
+
+	//RULES
+
+	//mov r, r
+	inline bool self_move(size_t i) {
+		const X86Inst& inst = at(i);
+		if (inst.op != X86Op::mov || inst.dst.kind != X86Operand::Kind::reg || inst.dst != inst.src || inst.dst.size != 8)
+			return false;
+		remove(i);
+		return true;
+	}
+
+	//mov r, x followed by something that writes all of r without reading it
+	inline bool dead_move(size_t i) {
+		const X86Inst& inst = at(i);
+		if ((inst.op != X86Op::mov && inst.op != X86Op::movzx && inst.op != X86Op::lea) || inst.dst.kind != X86Operand::Kind::reg || inst.dst.size < 4)
+			return false;
+
+		const size_t j = next(i);
+		if (j == SIZE_MAX)
+			return false;
+		const X86Inst& after = at(j);
+		if ((after.op != X86Op::mov && after.op != X86Op::movzx && after.op != X86Op::lea)
+		    || after.dst.kind != X86Operand::Kind::reg || after.dst.reg != inst.dst.reg || after.dst.size < 4
+		    || after.src.uses(inst.dst.reg))
+			return false;
+
+		remove(i);
+		return true;
+	}
+
+	//mov a, b then mov b, a, qwords only since a dword mov clears the upper half
+	inline bool move_back(size_t i) {
+		const X86Inst& inst = at(i);
+		if (inst.op != X86Op::mov || inst.dst.size != 8 || inst.src.size != 8
+		    || (inst.src.kind != X86Operand::Kind::reg && inst.src.kind != X86Operand::Kind::mem))
+			return false;
+
+		const size_t j = next(i);
+		if (j == SIZE_MAX)
+			return false;
+		const X86Inst& after = at(j);
+		if (after.op != X86Op::mov || after.dst != inst.src || after.src != inst.dst)
+			return false;
+		if (inst.dst.kind == X86Operand::Kind::mem && inst.dst.uses(inst.src.reg))
+			return false;
+
+		remove(j);
+		return true;
+	}
+
+	//mov [m], r then a load of [m] at the same width takes r instead
+	inline bool store_forward(size_t i) {
+		const X86Inst& inst = at(i);
+		if (inst.op != X86Op::mov || inst.dst.kind != X86Operand::Kind::mem || inst.src.kind != X86Operand::Kind::reg)
+			return false;
+
+		const size_t j = next(i);
+		if (j == SIZE_MAX)
+			return false;
+		X86Inst& after = at(j);
+		if ((after.op != X86Op::mov && after.op != X86Op::movzx) || after.src != inst.dst || after.dst.kind != X86Operand::Kind::reg)
+			return false;
+
+		if (after.op == X86Op::mov && after.dst.size == inst.src.size && after.dst.reg == inst.src.reg && after.dst.size == 8)
+		{
+			remove(j);
+			return true;
+		}
+
+		after.src = inst.src;
+		return true;
+	}
+
+	//jmp to the label right after it
+	inline bool jump_to_next(size_t i) {
+		const X86Inst& inst = at(i);
+		if (inst.op != X86Op::jmp)
+			return false;
+
+		for (size_t j = next(i); j != SIZE_MAX && at(j).op == X86Op::label; j = next(j))
+		{
+			if (at(j).dst.value == inst.dst.value)
+			{
+				remove(i);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//jcc a, jmp b, a: becomes jncc b, a:
+	inline bool branch_over(size_t i) {
+		X86Inst& inst = at(i);
+		if (inst.op != X86Op::jcc)
+			return false;
+
+		const size_t j = next(i);
+		if (j == SIZE_MAX || at(j).op != X86Op::jmp)
+			return false;
+		const size_t k = next(j);
+		if (k == SIZE_MAX || at(k).op != X86Op::label || at(k).dst.value != inst.dst.value)
+			return false;
+
+		retarget(i, at(j).dst.value);
+		inst.cond = invert(inst.cond);
+		remove(j);
+		return true;
+	}
+
+	//jump to a block that only jumps on
+	inline bool jump_thread(size_t i) {
+		if (!is_jump(at(i)))
+			return false;
+
+		const uint32_t target = forwarded(at(i).dst.value);
+		if (target == NO_BLOCK || target == at(i).dst.value)
+			return false;
+
+		retarget(i, target);
+		return true;
+	}
+
+	//anything between a jmp and the next label
+	inline bool unreachable(size_t i) {
+		if (at(i).op != X86Op::jmp)
+			return false;
+
+		const size_t j = next(i);
+		if (j == SIZE_MAX || at(j).op == X86Op::label)
+			return false;
+
+		remove(j);
+		return true;
+	}
+
+	inline bool unused_label(size_t i) {
+		const X86Inst& inst = at(i);
+		if (inst.op != X86Op::label || m_refs[inst.dst.value] != 0)
+			return false;
+
+		m_label_at[inst.dst.value] = SIZE_MAX;
+		remove(i);
+		return true;
+	}
+
+	//add x, 0, sub x, 0 and imul r, 1
+	inline bool identity(size_t i) {
+		const X86Inst& inst = at(i);
+		if (inst.src.kind != X86Operand::Kind::imm || next_reads_flags(i))
+			return false;
+		if (!((inst.op == X86Op::add || inst.op == X86Op::sub) && inst.src.value == 0) && !(inst.op == X86Op::imul && inst.src.value == 1))
+			return false;
+
+		remove(i);
+		return true;
+	}
+
+	//mov r, 0 becomes xor r32, r32
+	inline bool zero_idiom(size_t i) {
+		X86Inst& inst = at(i);
+		if (inst.op != X86Op::mov || inst.dst.kind != X86Operand::Kind::reg || inst.dst.size < 4
+		    || inst.src.kind != X86Operand::Kind::imm || inst.src.value != 0 || next_reads_flags(i))
+			return false;
+
+		inst.op = X86Op::xor_;
+		inst.dst.size = 4;
+		inst.src = inst.dst;
+		return true;
+	}
+
+	//cmp r, 0 becomes test r, r, same flags
+	inline bool compare_zero(size_t i) {
+		X86Inst& inst = at(i);
+		if (inst.op != X86Op::cmp || inst.dst.kind != X86Operand::Kind::reg || inst.src.kind != X86Operand::Kind::imm || inst.src.value != 0)
+			return false;
+
+		inst.op = X86Op::test;
+		inst.src = inst.dst;
+		return true;
+	}
+};
+
+inline const Peephole::Rule Peephole::s_rules[Peephole::NO_OF_RULES] = {
+	{"self_move",     &Peephole::self_move},
+	{"dead_move",     &Peephole::dead_move},
+	{"move_back",     &Peephole::move_back},
+	{"store_forward", &Peephole::store_forward},
+	{"jump_to_next",  &Peephole::jump_to_next},
+	{"branch_over",   &Peephole::branch_over},
+	{"jump_thread",   &Peephole::jump_thread},
+	{"unreachable",   &Peephole::unreachable},
+	{"unused_label",  &Peephole::unused_label},
+	{"identity",      &Peephole::identity},
+	{"zero_idiom",    &Peephole::zero_idiom},
+	{"compare_zero",  &Peephole::compare_zero},
+};
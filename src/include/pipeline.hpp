@@ -0,0 +1,175 @@
+#pragma once
+
+#include <thread>
+#include <utility>
+
+#include "./source.hpp"
+#include "./spsc.hpp"
+#include "./constfold.hpp"
+#include "./generator.hpp"
+
+#define PIPELINE_TOKEN_CHUNK 1024      //tokens per lexer hand-off
+#define PIPELINE_CHUNKS      16        //token chunks in circulation
+#define PIPELINE_STMTS       16        //statement Asts in circulation
+
+//Opt-in three stage front end built on the streaming pieces. The lexer and the parser each
+//get a thread, type checking and codegen run on the caller's. Token chunks and parsed
+//statements travel downstream through SPSC queues and come back empty through return
+//queues, so every buffer is reused and at most a fixed number are in flight.
+class Pipeline {
+public:
+	inline Pipeline(SourceFile& source) : m_source(source)
+	{
+		for (size_t i = 0; i < PIPELINE_CHUNKS; i++)
+		{
+			std::vector<Token> chunk;
+			chunk.reserve(PIPELINE_TOKEN_CHUNK);
+			m_free_chunks.push(std::move(chunk));
+		}
+
+		for (Ast& ast : m_asts)
+			m_free_asts.push(&ast);
+	}
+
+	inline Pipeline(const Pipeline& other) = delete;
+	inline Pipeline operator=(const Pipeline& other) = delete;
+
+	inline void run(std::ostream& out) {
+		std::thread lexer([this] { lex_stage(); });
+		std::thread parser([this] { parse_stage(); });
+
+		emit_stage(out);
+
+		lexer.join();
+		parser.join();
+	}
+
+	struct Stats
+	{
+		size_t tokens;
+		size_t nodes;
+		size_t ast_bytes;       //all statement Asts in circulation
+	};
+
+	//valid once run() returned
+	inline Stats stats() const {
+		Stats stats = {m_token_count, m_node_count, m_current_bytes};
+		for (const Ast& ast : m_asts)
+			stats.ast_bytes += ast.bytes();
+		return stats;
+	}
+
+private:
+	struct ParsedStmt
+	{
+		Ast* ast;               //nullptr marks the end of input
+		uint32_t stmt;
+	};
+
+	//Feeds the parser thread from the lexer's chunks, an empty chunk marks the end
+	class ChunkSource : public TokenSource {
+	public:
+		inline ChunkSource(Pipeline& pipeline) : m_pipeline(pipeline) {}
+
+		//Whole chunks until count tokens came, so a chunk is never split
+		inline bool pull(std::vector<Token>& output, size_t count) override {
+			const size_t before = output.size();
+			while (!m_done && output.size() - before < count)
+			{
+				std::vector<Token> chunk = m_pipeline.m_chunks.pop();
+				if (chunk.empty())
+				{
+					m_done = true;
+					break;
+				}
+
+				output.insert(output.end(), chunk.begin(), chunk.end());
+				chunk.clear();
+				m_pipeline.m_free_chunks.push(std::move(chunk));
+			}
+			return output.size() != before;
+		}
+
+	private:
+		Pipeline& m_pipeline;
+		bool m_done = false;
+	};
+
+	SourceFile& m_source;
+	Interner m_interner;                //only touched by the lexer thread
+
+	size_t m_token_count = 0;           //written by the lexer thread
+	size_t m_node_count = 0;
+	size_t m_current_bytes = 0;
+
+	SpscQueue<std::vector<Token>, PIPELINE_CHUNKS> m_chunks;
+	SpscQueue<std::vector<Token>, PIPELINE_CHUNKS> m_free_chunks;
+
+	Ast m_asts[PIPELINE_STMTS];
+	SpscQueue<ParsedStmt, PIPELINE_STMTS> m_stmts;
+	SpscQueue<Ast*, PIPELINE_STMTS> m_free_asts;
+
+	inline void lex_stage() {
+		Tokenizer tokenizer(m_source.view(), m_interner);
+
+		while (true)
+		{
+			std::vector<Token> chunk = m_free_chunks.pop();
+			tokenizer.pull(chunk, PIPELINE_TOKEN_CHUNK);
+
+			const bool end = chunk.empty();
+			m_chunks.push(std::move(chunk));
+			if (end)
+				break;
+		}
+
+		m_token_count = tokenizer.pulled();
+	}
+
+	inline void parse_stage() {
+		ChunkSource source(*this);
+		Parser parser(source, m_source.view());
+
+		while (auto stmt = parser.parse_next())
+		{
+			//hand the statement downstream, the parser carries on in a recycled Ast
+			Ast* ast = m_free_asts.pop();
+			std::swap(*ast, *parser.ast());
+			m_stmts.push({ast, stmt.value()});
+		}
+
+		m_stmts.push({nullptr, 0});
+	}
+
+	inline void emit_stage(std::ostream& out) {
+		Ast current;
+		Resolver resolver(m_source.view());
+		TypeChecker checker(resolver.get_symbols(), m_source.view());
+		ConstFolder folder(resolver.get_symbols(), m_source.view());
+		Generator generator(&current, resolver.get_symbols(), m_source.view());
+
+		generator.gen_begin();
+		while (true)
+		{
+			const ParsedStmt parsed = m_stmts.pop();
+			if (!parsed.ast)
+				break;
+
+			std::swap(current, *parsed.ast);
+			resolver.resolve(&current, parsed.stmt);
+			checker.check(&current, parsed.stmt);
+			folder.fold(&current, parsed.stmt);
+			generator.gen_top(parsed.stmt);
+			generator.flush(out);
+			m_node_count += current.size();
+
+			if (!current.tokens.empty())
+				m_source.release(current.tokens.front().offset);
+
+			std::swap(current, *parsed.ast);
+			m_free_asts.push(parsed.ast);
+		}
+		generator.gen_end(out);
+		m_current_bytes = current.bytes();
+	}
+};
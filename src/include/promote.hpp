@@ -0,0 +1,182 @@
+#pragma once
+
+#include <vector>
+
+#include "./ir.hpp"
+#include "./types.hpp"
+
+//Moves scalar slots whose address is never taken into virtual registers. Such a slot gets
+//one virtual register for its whole life: a store becomes a zext into it, a load a copy out
+//of it, and the copy is dropped when the variable is not assigned again before the loaded
+//value's last use. Arrays and anything behind -> or & stay in memory.
+class SlotPromoter {
+public:
+	inline SlotPromoter(IrProgram& prog) : m_prog(prog) {}
+
+	//Returns the number of slots promoted
+	inline uint32_t promote() {
+		find_candidates();
+		if (!m_promoted)
+			return 0;
+
+		for (IrBlock& block : m_prog.blocks)
+			rewrite(block);
+
+		find_escapes();
+		m_subst.assign(m_prog.vregs.size(), NO_VREG);
+		m_last_use.assign(m_prog.vregs.size(), NO_POS);
+		m_next_def.assign(m_prog.vregs.size(), {NO_BLOCK, NO_POS});
+		for (uint32_t b = 0; b < m_prog.blocks.size(); b++)
+			forward(b);
+
+		return m_promoted;
+	}
+
+	//Virtual register of a slot, NO_VREG if it stayed in memory
+	inline uint32_t var(uint32_t slot) const {
+		return m_var[slot];
+	}
+
+private:
+	static constexpr uint32_t NO_POS = UINT32_MAX;
+
+	IrProgram& m_prog;
+	uint32_t m_promoted = 0;
+
+	std::vector<uint32_t> m_var;                                    //slot -> its virtual register
+	std::vector<bool> m_is_var;                                     //virtual register -> holds a promoted slot
+	std::vector<bool> m_escapes;                                    //used outside the block that defines it
+	std::vector<uint32_t> m_subst;                                  //loaded copy -> variable it can be read from
+	std::vector<uint32_t> m_last_use;
+	std::vector<std::pair<uint32_t, uint32_t>> m_next_def;          //variable -> {block, position} of its next assignment
+	TypeTable m_Table;
+
+	inline void find_candidates() {
+		//address taken, or read or written at another width than declared
+		std::vector<bool> taken(m_prog.slots.size(), false);
+		for (const IrBlock& block : m_prog.blocks)
+			for (const IrInst& inst : block.insts)
+				if (inst.op == IrOp::slot_addr)
+					taken[inst.imm] = true;
+				else if ((inst.op == IrOp::load_slot || inst.op == IrOp::store_slot) && inst.type != m_prog.slots[inst.imm].type)
+					taken[inst.imm] = true;
+
+		m_var.assign(m_prog.slots.size(), NO_VREG);
+		for (uint32_t s = 0; s < m_prog.slots.size(); s++)
+		{
+			const IrSlot& slot = m_prog.slots[s];
+			if (taken[s] || slot.size != m_Table[slot.type].type_size)
+				continue;
+
+			m_var[s] = m_prog.new_vreg(slot.type);
+			m_promoted++;
+		}
+
+		m_is_var.assign(m_prog.vregs.size(), false);
+		for (const uint32_t v : m_var)
+			if (v != NO_VREG)
+				m_is_var[v] = true;
+	}
+
+	inline void rewrite(IrBlock& block) {
+		for (IrInst& inst : block.insts)
+		{
+			if (inst.op != IrOp::load_slot && inst.op != IrOp::store_slot)
+				continue;
+
+			const uint32_t v = m_var[inst.imm];
+			if (v == NO_VREG)
+				continue;
+
+			if (inst.op == IrOp::load_slot)
+				inst = {.op = IrOp::copy, .type = inst.type, .dst = inst.dst, .a = v};
+			else
+				inst = {.op = inst.type == PTR ? IrOp::copy : IrOp::zext, .type = inst.type, .dst = v, .a = inst.a};
+		}
+	}
+
+	inline void find_escapes() {
+		std::vector<uint32_t> def_block(m_prog.vregs.size(), NO_BLOCK);
+		m_escapes.assign(m_prog.vregs.size(), false);
+
+		for (uint32_t b = 0; b < m_prog.blocks.size(); b++)
+		{
+			auto use = [&](uint32_t v) {
+				if (v != NO_VREG && def_block[v] != b)
+					m_escapes[v] = true;
+			};
+
+			for (const IrInst& inst : m_prog.blocks[b].insts)
+			{
+				use(inst.a);
+				use(inst.b);
+				use(inst.index);
+				if (inst.dst != NO_VREG)
+					def_block[inst.dst] = b;
+			}
+			use(m_prog.blocks[b].term.a);
+			use(m_prog.blocks[b].term.b);
+		}
+	}
+
+	//Drops the copies out of variables whose value is still in the variable at every use
+	inline void forward(uint32_t b) {
+		IrBlock& block = m_prog.blocks[b];
+		auto seen = [&](uint32_t v, uint32_t pos) {
+			if (v != NO_VREG && m_last_use[v] == NO_POS)
+				m_last_use[v] = pos;
+		};
+
+		const uint32_t count = block.insts.size();
+		seen(block.term.a, count);
+		seen(block.term.b, count);
+
+		bool dropped = false;
+		for (uint32_t i = count; i-- > 0;)
+		{
+			IrInst& inst = block.insts[i];
+			if (inst.op == IrOp::copy && m_is_var[inst.a] && !m_is_var[inst.dst] && !m_escapes[inst.dst])
+			{
+				const auto [def_block, def_pos] = m_next_def[inst.a];
+				const uint32_t next_def = def_block == b ? def_pos : NO_POS;
+				const uint32_t last_use = m_last_use[inst.dst];
+				if (last_use == NO_POS || last_use <= next_def)
+				{
+					m_subst[inst.dst] = inst.a;
+					inst.dst = NO_VREG;
+					dropped = true;
+					continue;
+				}
+			}
+
+			if (inst.dst != NO_VREG && m_is_var[inst.dst])
+				m_next_def[inst.dst] = {b, i};
+			seen(inst.a, i);
+			seen(inst.b, i);
+			seen(inst.index, i);
+		}
+
+		if (!dropped)
+			return;
+
+		auto subst = [&](uint32_t& v) {
+			if (v != NO_VREG && m_subst[v] != NO_VREG)
+				v = m_subst[v];
+		};
+
+		std::vector<IrInst> kept;
+		kept.reserve(count);
+		for (IrInst& inst : block.insts)
+		{
+			if (inst.op == IrOp::copy && inst.dst == NO_VREG)
+				continue;
+			subst(inst.a);
+			subst(inst.b);
+			subst(inst.index);
+			kept.push_back(inst);
+		}
+		block.insts = std::move(kept);
+		subst(block.term.a);
+		subst(block.term.b);
+	}
+};
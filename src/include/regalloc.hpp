@@ -0,0 +1,419 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "./ir.hpp"
+#include "./x86.hpp"
+
+struct LiveInterval
+{
+	uint32_t vreg;
+	uint32_t start;
+	uint32_t end;
+};
+
+//Linear scan over live intervals (Poletto and Sarkar). Instruction i of a block starting at
+//position n reads its operands at n + 2i and writes its result at n + 2i + 1, the terminator
+//comes after the last instruction, and blocks follow each other in layout order.
+//
+//A virtual register used in one block lives from its definition to its last use. Promoted
+//variables live across blocks, for those the blocks they are live into are found by walking
+//predecessors back from every use that is not preceded by a definition in its block, and the
+//interval stretches over all of them. One interval per virtual register and no splitting: when
+//no register is free the interval that ends last goes to a frame qword for its whole life.
+//
+//A virtual register set once by an imm that fits in 32 bits is never allocated, the Emitter
+//uses the value as an immediate.
+//
+//The vector registers of the v ops get a scan of their own over the xmm registers. They never
+//spill, LoopVectorizer keeps a loop's vectors within NO_OF_VECTOR_REGS.
+class RegAlloc {
+public:
+	inline RegAlloc(const IrProgram& prog) : m_prog(prog) {}
+
+	inline void allocate() {
+		const uint32_t count = m_prog.vregs.size();
+		m_reg.assign(count, NO_REG);
+		m_spill.assign(count, UINT32_MAX);
+		m_const.assign(count, false);
+		m_vector.assign(count, false);
+
+		number_blocks();
+		scan_refs();
+		extend_live_ranges();
+		linear_scan(false);
+		linear_scan(true);
+		assign_spill_slots();
+	}
+
+	inline uint8_t reg(uint32_t v) const {
+		return m_reg[v];
+	}
+
+	//qword index of a spilled virtual register
+	inline uint32_t spill(uint32_t v) const {
+		return m_spill[v];
+	}
+
+	inline bool is_const(uint32_t v) const {
+		return m_const[v];
+	}
+
+	inline int64_t const_value(uint32_t v) const {
+		return m_value[v];
+	}
+
+	inline uint32_t spill_slots() const {
+		return m_spill_slots;
+	}
+
+	//Live into the entry block, read before any assignment on some path. They start out 0
+	inline const std::vector<uint32_t>& zero_init() const {
+		return m_zero_init;
+	}
+
+	//{start, end} of the intervals that got register r, in order
+	inline const std::vector<std::pair<uint32_t, uint32_t>>& ranges(uint8_t r) const {
+		return m_ranges[r];
+	}
+
+	inline void report(std::ostream& out, uint32_t promoted) const {
+		uint32_t spilled_vars = 0;
+		for (const uint32_t v : m_spilled)
+			if (m_global[v])
+				spilled_vars++;
+
+		out << "regalloc: " << m_intervals.size() << " intervals over " << (int)NO_OF_REGS << " registers, "
+		    << m_spilled.size() << " spilled (" << spilled_vars << " live across blocks) into "
+		    << m_spill_slots << " frame qwords, " << promoted << " of " << m_prog.slots.size()
+		    << " slots promoted to registers\n";
+	}
+
+private:
+	static constexpr uint32_t NO_POS = UINT32_MAX;
+
+	const IrProgram& m_prog;
+
+	std::vector<uint32_t> m_block_start;
+	std::vector<uint32_t> m_block_end;              //one past the terminator's read position
+	std::vector<uint32_t> m_pred_start;             //predecessors of b are m_preds[m_pred_start[b], m_pred_start[b + 1])
+	std::vector<uint32_t> m_preds;
+
+	std::vector<uint32_t> m_start;
+	std::vector<uint32_t> m_end;
+	std::vector<uint32_t> m_defs;                   //number of definitions
+	std::vector<int64_t> m_value;                   //imm of a single definition
+	std::vector<std::pair<uint32_t, uint32_t>> m_hint;      //operands whose register suits the result
+	std::vector<bool> m_global;
+	std::vector<bool> m_vector;                     //set by a v op, lives in an xmm register
+	std::vector<std::pair<uint32_t, uint32_t>> m_exposed;   //{vreg, block} read before written in block
+	std::vector<std::pair<uint32_t, uint32_t>> m_def_in;    //{vreg, block} written in block
+
+	std::vector<uint8_t> m_reg;
+	std::vector<uint32_t> m_spill;
+	std::vector<bool> m_const;
+	std::vector<uint32_t> m_zero_init;
+	std::vector<LiveInterval> m_intervals;
+	std::vector<uint32_t> m_spilled;
+	std::vector<std::pair<uint32_t, uint32_t>> m_ranges[NO_OF_REGS];
+	uint32_t m_spill_slots = 0;
+
+	inline void number_blocks() {
+		const uint32_t blocks = m_prog.blocks.size();
+		m_block_start.resize(blocks);
+		m_block_end.resize(blocks);
+
+		uint32_t pos = 0;
+		for (uint32_t b = 0; b < blocks; b++)
+		{
+			m_block_start[b] = pos;
+			pos += 2 * m_prog.blocks[b].insts.size();
+			m_block_end[b] = pos + 1;
+			pos += 2;
+		}
+
+		m_pred_start.assign(blocks + 1, 0);
+		for (uint32_t b = 0; b < blocks; b++)
+		{
+			const auto [first, second] = m_prog.successors(b);
+			if (first != NO_BLOCK)
+				m_pred_start[first + 1]++;
+			if (second != NO_BLOCK && second != first)
+				m_pred_start[second + 1]++;
+		}
+		for (uint32_t b = 0; b < blocks; b++)
+			m_pred_start[b + 1] += m_pred_start[b];
+
+		m_preds.resize(m_pred_start[blocks]);
+		std::vector<uint32_t> fill(m_pred_start.begin(), m_pred_start.end() - 1);
+		for (uint32_t b = 0; b < blocks; b++)
+		{
+			const auto [first, second] = m_prog.successors(b);
+			if (first != NO_BLOCK)
+				m_preds[fill[first]++] = b;
+			if (second != NO_BLOCK && second != first)
+				m_preds[fill[second]++] = b;
+		}
+	}
+
+	inline void touch(uint32_t v, uint32_t pos) {
+		m_start[v] = std::min(m_start[v], pos);
+		if (m_end[v] == NO_POS || pos > m_end[v])
+			m_end[v] = pos;
+	}
+
+	//Ranges inside blocks, plus which blocks read a register before writing it
+	inline void scan_refs() {
+		const uint32_t count = m_prog.vregs.size();
+		m_start.assign(count, NO_POS);
+		m_end.assign(count, NO_POS);
+		m_defs.assign(count, 0);
+		m_value.assign(count, 0);
+		m_hint.assign(count, {NO_VREG, NO_VREG});
+		m_global.assign(count, false);
+
+		std::vector<uint32_t> first_block(count, NO_BLOCK);
+		std::vector<uint32_t> seen_in(count, NO_BLOCK);
+		std::vector<uint32_t> def_in(count, NO_BLOCK);
+
+		for (uint32_t b = 0; b < m_prog.blocks.size(); b++)
+		{
+			auto ref = [&](uint32_t v, uint32_t pos, bool def) {
+				if (v == NO_VREG)
+					return;
+				if (first_block[v] == NO_BLOCK)
+					first_block[v] = b;
+				else if (first_block[v] != b)
+					m_global[v] = true;
+
+				if (seen_in[v] != b)
+				{
+					seen_in[v] = b;
+					if (!def)
+						m_exposed.push_back({v, b});
+				}
+				if (def && def_in[v] != b)
+				{
+					def_in[v] = b;
+					m_def_in.push_back({v, b});
+				}
+				touch(v, pos);
+			};
+
+			uint32_t pos = m_block_start[b];
+			for (const IrInst& inst : m_prog.blocks[b].insts)
+			{
+				ref(inst.a, pos, false);
+				ref(inst.b, pos, false);
+				ref(inst.index, pos, false);
+				if (inst.dst != NO_VREG)
+				{
+					ref(inst.dst, pos + 1, true);
+					if (m_defs[inst.dst]++ == 0)
+						m_value[inst.dst] = inst.imm;
+					if (inst.op != IrOp::imm)
+						m_value[inst.dst] = INT64_MAX;
+					if (vector_result(inst.op))
+						m_vector[inst.dst] = true;
+
+					switch (inst.op)
+					{
+						case IrOp::copy:
+						case IrOp::zext:
+						case IrOp::load:
+						case IrOp::sub:
+						case IrOp::shl:
+						case IrOp::shr:
+							m_hint[inst.dst] = {inst.a, NO_VREG};
+							break;
+						case IrOp::add:
+						case IrOp::mul:
+						case IrOp::and_:
+						case IrOp::vadd:
+						case IrOp::vmul:
+						case IrOp::vand:
+							m_hint[inst.dst] = {inst.a, inst.b};
+							break;
+						case IrOp::vsub:
+						case IrOp::vshl:
+						case IrOp::vsad:
+							m_hint[inst.dst] = {inst.a, NO_VREG};
+							break;
+						default:
+							break;
+					}
+				}
+				pos += 2;
+			}
+			ref(m_prog.blocks[b].term.a, pos, false);
+			ref(m_prog.blocks[b].term.b, pos, false);
+		}
+
+		for (uint32_t v = 0; v < count; v++)
+			m_const[v] = m_defs[v] == 1 && m_value[v] >= INT32_MIN && m_value[v] <= INT32_MAX;
+	}
+
+	//Stretches every register read before written in some block over the blocks it is live
+	//into and out of
+	inline void extend_live_ranges() {
+		std::sort(m_exposed.begin(), m_exposed.end());
+		std::sort(m_def_in.begin(), m_def_in.end());
+
+		const uint32_t blocks = m_prog.blocks.size();
+		std::vector<uint32_t> defines(blocks, NO_VREG);
+		std::vector<uint32_t> live_in(blocks, NO_VREG);
+		std::vector<uint32_t> work;
+
+		size_t d = 0;
+		for (size_t e = 0; e < m_exposed.size();)
+		{
+			const uint32_t v = m_exposed[e].first;
+			for (; d < m_def_in.size() && m_def_in[d].first <= v; d++)
+				if (m_def_in[d].first == v)
+					defines[m_def_in[d].second] = v;
+
+			for (; e < m_exposed.size() && m_exposed[e].first == v; e++)
+			{
+				live_in[m_exposed[e].second] = v;
+				work.push_back(m_exposed[e].second);
+			}
+
+			bool entry = false;
+			while (!work.empty())
+			{
+				const uint32_t b = work.back();
+				work.pop_back();
+				touch(v, m_block_start[b]);
+				if (b == 0)
+					entry = true;
+
+				for (uint32_t p = m_pred_start[b]; p < m_pred_start[b + 1]; p++)
+				{
+					const uint32_t pred = m_preds[p];
+					touch(v, m_block_end[pred]);
+					if (defines[pred] != v && live_in[pred] != v)
+					{
+						live_in[pred] = v;
+						work.push_back(pred);
+					}
+				}
+			}
+
+			if (entry)
+			{
+				m_zero_init.push_back(v);
+				m_const[v] = false;
+			}
+		}
+	}
+
+	//The general registers, or the vector ones
+	inline void linear_scan(bool vectors) {
+		std::vector<LiveInterval> intervals;
+		for (uint32_t v = 0; v < m_prog.vregs.size(); v++)
+			if (m_start[v] != NO_POS && !m_const[v] && m_vector[v] == vectors)
+				intervals.push_back({v, m_start[v], m_end[v]});
+		std::sort(intervals.begin(), intervals.end(), [](const LiveInterval& l, const LiveInterval& r) {
+			return l.start < r.start;
+		});
+
+		const uint8_t first = vectors ? XMM0 : 0;
+		const uint8_t last = vectors ? XMM0 + NO_OF_VECTOR_REGS : NO_OF_REGS;
+		std::vector<LiveInterval> active;       //sorted by end
+		bool free[XMM15 + 1];
+		std::fill(free, free + XMM15 + 1, true);
+
+		for (const LiveInterval& current : intervals)
+		{
+			while (!active.empty() && active.front().end < current.start)
+			{
+				free[m_reg[active.front().vreg]] = true;
+				active.erase(active.begin());
+			}
+
+			uint8_t reg = NO_REG;
+			const auto [hint_a, hint_b] = m_hint[current.vreg];
+			if (hint_a != NO_VREG && m_reg[hint_a] != NO_REG && free[m_reg[hint_a]] && m_end[hint_a] < current.start)
+				reg = m_reg[hint_a];
+			else if (hint_b != NO_VREG && m_reg[hint_b] != NO_REG && free[m_reg[hint_b]] && m_end[hint_b] < current.start)
+				reg = m_reg[hint_b];
+			for (uint8_t r = first; r < last && reg == NO_REG; r++)
+				if (free[r])
+					reg = r;
+
+			LiveInterval placed = current;
+			if (reg == NO_REG && vectors)
+			{
+				std::cerr << "RegAlloc: more than " << (int)NO_OF_VECTOR_REGS << " vector registers live at once\n";
+				exit(EXIT_FAILURE);
+			}
+			if (reg == NO_REG)
+			{
+				//the one that ends last gives way
+				const LiveInterval& last = active.back();
+				if (last.end <= current.end)
+				{
+					m_spilled.push_back(current.vreg);
+					continue;
+				}
+
+				reg = m_reg[last.vreg];
+				m_reg[last.vreg] = NO_REG;
+				m_spilled.push_back(last.vreg);
+				active.pop_back();
+			}
+
+			free[reg] = false;
+			m_reg[placed.vreg] = reg;
+			const auto at = std::upper_bound(active.begin(), active.end(), placed, [](const LiveInterval& l, const LiveInterval& r) {
+				return l.end < r.end;
+			});
+			active.insert(at, placed);
+		}
+
+		for (const LiveInterval& interval : intervals)
+			if (m_reg[interval.vreg] != NO_REG && !vectors)
+				m_ranges[m_reg[interval.vreg]].push_back({interval.start, interval.end});
+		m_intervals.insert(m_intervals.end(), intervals.begin(), intervals.end());
+	}
+
+	//Spilled intervals share qwords once they are over
+	inline void assign_spill_slots() {
+		std::sort(m_spilled.begin(), m_spilled.end(), [&](uint32_t l, uint32_t r) {
+			return m_start[l] < m_start[r];
+		});
+
+		std::vector<std::pair<uint32_t, uint32_t>> busy;        //{end, qword}, min heap on end
+		std::vector<uint32_t> free;
+		auto later = [](const std::pair<uint32_t, uint32_t>& l, const std::pair<uint32_t, uint32_t>& r) {
+			return l.first > r.first;
+		};
+
+		for (const uint32_t v : m_spilled)
+		{
+			while (!busy.empty() && busy.front().first < m_start[v])
+			{
+				free.push_back(busy.front().second);
+				std::pop_heap(busy.begin(), busy.end(), later);
+				busy.pop_back();
+			}
+
+			uint32_t slot;
+			if (free.empty())
+				slot = m_spill_slots++;
+			else {
+				slot = free.back();
+				free.pop_back();
+			  }
+
+			m_spill[v] = slot;
+			busy.push_back({m_end[v], slot});
+			std::push_heap(busy.begin(), busy.end(), later);
+		}
+	}
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+//Per phase wall and CPU time plus size counters for --time-report.
+//CPU time covers every thread of the compiler and the nasm/ld children it waited for.
+class TimeReport {
+public:
+	struct Phase
+	{
+		std::string_view name;
+		double wall_ms;
+		double cpu_ms;
+	};
+
+	struct Counters
+	{
+		std::string_view mode = "default";
+		size_t tokens = 0;
+		size_t nodes = 0;
+		size_t ast_bytes = 0;           //peak column memory of the Ast
+		size_t asm_bytes = 0;
+		size_t binary_bytes = 0;
+	};
+
+	Counters counters;
+
+	inline void begin(std::string_view name) {
+		m_name = name;
+		m_wall = wall_now();
+		m_cpu = cpu_now();
+	}
+
+	inline void end() {
+		m_phases.push_back({m_name, wall_now() - m_wall, cpu_now() - m_cpu});
+	}
+
+	//size of a file the compiler wrote, 0 if it is missing
+	static inline size_t file_size(const char* path) {
+		struct stat st;
+		return stat(path, &st) == 0 ? st.st_size : 0;
+	}
+
+	inline void print(std::ostream& out) const {
+		char line[128];
+		out << "=== forke time report (" << counters.mode << ") ===\n";
+		out << "phase                  wall ms      cpu ms\n";
+		for (const Phase& phase : m_phases)
+		{
+			snprintf(line, sizeof(line), "%-18.*s %11.3f %11.3f\n", (int)phase.name.size(), phase.name.data(), phase.wall_ms, phase.cpu_ms);
+			out << line;
+		}
+		snprintf(line, sizeof(line), "%-18s %11.3f %11.3f\n", "total", total_wall(), total_cpu());
+		out << line;
+
+		print_count(out, "tokens", counters.tokens, "");
+		print_count(out, "ast nodes", counters.nodes, "");
+		print_count(out, "ast bytes", counters.ast_bytes, "");
+		print_count(out, "peak rss", peak_rss_kb(RUSAGE_SELF), " KiB");
+		print_count(out, "peak rss nasm/ld", peak_rss_kb(RUSAGE_CHILDREN), " KiB");
+		print_count(out, "asm bytes", counters.asm_bytes, "");
+		print_count(out, "binary bytes", counters.binary_bytes, "");
+	}
+
+	inline void print_json(std::ostream& out) const {
+		char num[64];
+		out << "{\"mode\":\"" << counters.mode << "\",\"phases\":[";
+		for (size_t i = 0; i < m_phases.size(); i++)
+		{
+			snprintf(num, sizeof(num), "%.3f,\"cpu_ms\":%.3f", m_phases[i].wall_ms, m_phases[i].cpu_ms);
+			out << (i ? "," : "") << "{\"name\":\"" << m_phases[i].name << "\",\"wall_ms\":" << num << '}';
+		}
+		snprintf(num, sizeof(num), "%.3f,\"cpu_ms\":%.3f", total_wall(), total_cpu());
+		out << "],\"total\":{\"wall_ms\":" << num << '}'
+		    << ",\"tokens\":"            << counters.tokens
+		    << ",\"ast_nodes\":"         << counters.nodes
+		    << ",\"ast_bytes\":"         << counters.ast_bytes
+		    << ",\"peak_rss_kb\":"       << peak_rss_kb(RUSAGE_SELF)
+		    << ",\"child_peak_rss_kb\":" << peak_rss_kb(RUSAGE_CHILDREN)
+		    << ",\"asm_bytes\":"         << counters.asm_bytes
+		    << ",\"binary_bytes\":"      << counters.binary_bytes
+		    << "}\n";
+	}
+
+private:
+	std::vector<Phase> m_phases;
+	std::string_view m_name;
+	double m_wall = 0;
+	double m_cpu = 0;
+
+	static inline double wall_now() {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static inline double cpu_ms(int who) {
+		struct rusage usage;
+		getrusage(who, &usage);
+		return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3
+		     + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+	}
+
+	static inline double cpu_now() {
+		return cpu_ms(RUSAGE_SELF) + cpu_ms(RUSAGE_CHILDREN);
+	}
+
+	static inline long peak_rss_kb(int who) {
+		struct rusage usage;
+		getrusage(who, &usage);
+		return usage.ru_maxrss;
+	}
+
+	static inline void print_count(std::ostream& out, const char* name, size_t count, const char* unit) {
+		char line[128];
+		snprintf(line, sizeof(line), "%-18s %zu%s\n", name, count, unit);
+		out << line;
+	}
+
+	inline double total_wall() const {
+		double total = 0;
+		for (const Phase& phase : m_phases)
+			total += phase.wall_ms;
+		return total;
+	}
+
+	inline double total_cpu() const {
+		double total = 0;
+		for (const Phase& phase : m_phases)
+			total += phase.cpu_ms;
+		return total;
+	}
+};
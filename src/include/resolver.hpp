@@ -0,0 +1,217 @@
+#pragma once
+
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "./ast.hpp"
+#include "./types.hpp"
+#include "./mod_map.hpp"
+
+struct VarType
+{
+	DataType type;
+	std::optional<DataType> pointed_type;
+};
+
+//A declared variable. loc is the frame size once it was allocated, its bytes end there and
+//sibling scopes reuse them. The Generator addresses it at [rbp-loc], the IR path only keeps
+//loc and size for FrameLayout, which gives the slot its offset from rsp.
+struct Symbol
+{
+	VarType types;
+	uint32_t loc;
+	uint32_t size;                  //bytes, element size times count
+	std::string_view name;
+};
+
+//Binds every identifier to its declaration, scope by scope, before any other pass runs.
+//term_ident nodes get b: symbol and c: frame location, so later passes never look a name
+//up again. A name may be redeclared in an inner scope and reused once its scope closed.
+class Resolver {
+public:
+	inline Resolver(std::string_view src) : m_src(src) {}
+
+	inline void resolve(Ast* ast) {
+		m_ast = ast;
+		for (const uint32_t stmt : ast->stmts)
+		{
+			resolve_stmt(stmt);
+		}
+	}
+
+	//Streaming: resolves one top level statement, global bindings carry over to the next call
+	inline void resolve(Ast* ast, uint32_t stmt) {
+		m_ast = ast;
+		resolve_stmt(stmt);
+	}
+
+	inline const std::vector<Symbol>& get_symbols() const {
+		return m_symbols;
+	}
+
+private:
+	struct Binding
+	{
+		uint32_t symbol;
+		uint32_t depth;         //scope depth of the declaration, a second one at the same depth is an error
+	};
+
+	struct Scope
+	{
+		size_t bindings;        //m_bindings.size() when the scope opened
+		uint32_t frame;         //m_frame when the scope opened
+	};
+
+	std::string_view m_src;
+	Ast* m_ast = nullptr;
+
+	std::vector<Symbol> m_symbols;
+	Modded_map<Binding> m_bindings;
+	std::vector<Scope> m_scopes;
+	std::vector<uint32_t> m_worklist;
+	uint32_t m_frame = 0;
+	TypeTable m_Table;
+
+	inline void begin_scope() {
+		m_scopes.push_back({m_bindings.size(), m_frame});
+	}
+
+	inline void end_scope() {
+		while (m_bindings.size() > m_scopes.back().bindings)
+			m_bindings.pop_back();
+
+		m_frame = m_scopes.back().frame;
+		m_scopes.pop_back();
+	}
+
+	inline void declare(uint32_t stmt) {
+		Ast& ast = *m_ast;
+		const uint32_t ident = ast.token(stmt).id;
+		const uint32_t depth = m_scopes.size();
+
+		if (m_bindings.contains(ident) && m_bindings.at(ident).depth == depth)
+		{
+			std::cerr << "Cannot Redeclare: '" << token_str(ast.token(stmt), m_src) << "'\n";
+			exit(EXIT_FAILURE);
+		}
+
+		//Implement Better Pointer chaining
+		VarType types;
+		if (ast.b[stmt] > 1)
+			types = VarType{.type = PTR, .pointed_type = ast.type[stmt]};
+		else if (ast.type[stmt] == PTR)
+			types = VarType{.type = PTR, .pointed_type = (DataType)ast.c[stmt]};
+		else
+			types = VarType{.type = ast.type[stmt], .pointed_type = {}};
+
+		const uint32_t size = m_Table[ast.type[stmt]].type_size * ast.b[stmt];
+		m_frame += size;
+		m_symbols.push_back({types, m_frame, size, token_str(ast.token(stmt), m_src)});
+		m_bindings.insert(ident, {(uint32_t)m_symbols.size() - 1, depth});
+	}
+
+	inline void resolve_stmt(uint32_t stmt) {
+		Ast& ast = *m_ast;
+		const uint32_t a = ast.a[stmt];
+		const uint32_t b = ast.b[stmt];
+		const uint32_t c = ast.c[stmt];
+
+		switch (ast.kind[stmt])
+		{
+			case NodeKind::stmt_exit:
+				resolve_expr(a);
+				break;
+
+			case NodeKind::stmt_declare:
+				declare(stmt);
+				break;
+
+			case NodeKind::stmt_assign:
+				resolve_expr(a);
+				if (b != NO_NODE)
+					resolve_expr(b);
+				break;
+
+			case NodeKind::stmt_scope:
+				begin_scope();
+				for (uint32_t i = a; i < a + b; i++)
+				{
+					resolve_stmt(ast.lists[i]);
+				}
+				end_scope();
+				break;
+
+			case NodeKind::stmt_if:
+			case NodeKind::chain_elif:
+				resolve_expr(a);
+				resolve_stmt(b);
+				if (c != NO_NODE)
+					resolve_stmt(c);
+				break;
+
+			case NodeKind::chain_else:
+				resolve_stmt(b);
+				break;
+
+			case NodeKind::stmt_loop:
+				resolve_expr(a);
+				resolve_stmt(b);
+				break;
+
+			case NodeKind::stmt_write_expr:
+				resolve_expr(a);
+				if (b != NO_NODE)
+					resolve_expr(b);
+				break;
+
+			case NodeKind::stmt_write_str:
+				break;
+
+			default:
+				std::cerr << "Expected a statement node\n";
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	//Expressions declare nothing, so their identifiers are resolved in any order from a worklist
+	inline void resolve_expr(uint32_t expr) {
+		Ast& ast = *m_ast;
+		m_worklist.push_back(expr);
+
+		while (!m_worklist.empty())
+		{
+			const uint32_t node = m_worklist.back();
+			m_worklist.pop_back();
+
+			switch (ast.kind[node])
+			{
+				case NodeKind::term_int:
+				case NodeKind::term_char:
+					break;
+
+				case NodeKind::term_ident:
+				{
+					const uint32_t ident = ast.token(node).id;
+					if (!m_bindings.contains(ident))
+					{
+						std::cerr << "'" << token_str(ast.token(node), m_src) << "' was NEVER declared fucknigga\n";
+						exit(EXIT_FAILURE);
+					}
+
+					const uint32_t symbol = m_bindings.at(ident).symbol;
+					ast.b[node] = symbol;
+					ast.c[node] = m_symbols[symbol].loc;
+					break;
+				}
+
+				default:
+					if (ast.a[node] != NO_NODE)
+						m_worklist.push_back(ast.a[node]);
+					//bin_cmp keeps its comparison in c, every child sits in a or b
+					if (ast.b[node] != NO_NODE)
+						m_worklist.push_back(ast.b[node]);
+			}
+		}
+	}
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+//Vectorized run scanning for the tokenizer. Every scan starts at index i and returns the
+//index of the first byte that stops the run, counting the '\n' bytes it skipped into lines.
+//SSE2 is the baseline on x86-64, AVX2 is picked at runtime, and the scalar loop handles
+//tails and every other target. Build with -DNO_SIMD to force the scalar path.
+
+#if defined(__x86_64__) && !defined(NO_SIMD)
+#define SCAN_SIMD
+#include <immintrin.h>
+#endif
+
+enum class ScanClass
+{
+	space,          //run of whitespace
+	alnum,          //rest of an identifier
+	digit,          //rest of an integer literal
+	until           //everything up to a given character
+};
+
+constexpr bool scan_is_space(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+constexpr bool scan_is_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+constexpr bool scan_is_alpha(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr bool scan_is_alnum(char c) {
+	return scan_is_alpha(c) || scan_is_digit(c);
+}
+
+template <ScanClass cls>
+inline bool scan_stop(char ch, char until) {
+	if constexpr (cls == ScanClass::space)
+		return !scan_is_space(ch);
+	else if constexpr (cls == ScanClass::alnum)
+		return !scan_is_alnum(ch);
+	else if constexpr (cls == ScanClass::digit)
+		return !scan_is_digit(ch);
+	else
+		return ch == until;
+}
+
+template <ScanClass cls>
+inline size_t scan_scalar(const char* src, size_t i, size_t n, char until, uint32_t& lines) {
+	while (i < n && !scan_stop<cls>(src[i], until))
+	{
+		if (src[i] == '\n')
+			lines++;
+		i++;
+	}
+	return i;
+}
+
+#ifdef SCAN_SIMD
+
+#define SCAN_SCALAR_HEAD 8
+
+//signed byte range check, bytes >= 0x80 are negative so they never fall in an ASCII range
+#define SCAN_RANGE_128(v, lo, hi) _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((lo) - 1)), \
+					       _mm_cmplt_epi8(v, _mm_set1_epi8((hi) + 1)))
+#define SCAN_RANGE_256(v, lo, hi) _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((lo) - 1)), \
+						  _mm256_cmpgt_epi8(_mm256_set1_epi8((hi) + 1), v))
+
+template <ScanClass cls>
+inline size_t scan_sse2(const char* src, size_t i, size_t n, char until, uint32_t& lines) {
+	const __m128i nl = _mm_set1_epi8('\n');
+
+	while (i + 16 <= n)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i match;
+
+		if constexpr (cls == ScanClass::space)
+			match = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), SCAN_RANGE_128(v, '\t', '\r'));
+		else if constexpr (cls == ScanClass::alnum)
+			match = _mm_or_si128(SCAN_RANGE_128(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z'),
+					     SCAN_RANGE_128(v, '0', '9'));
+		else if constexpr (cls == ScanClass::digit)
+			match = SCAN_RANGE_128(v, '0', '9');
+		else
+			match = _mm_cmpeq_epi8(v, _mm_set1_epi8(until));
+
+		uint32_t stop = (uint32_t)_mm_movemask_epi8(match);
+		if constexpr (cls != ScanClass::until)
+			stop = ~stop & 0xFFFF;
+
+		const uint32_t newlines = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+		if (stop == 0)
+		{
+			lines += __builtin_popcount(newlines);
+			i += 16;
+			continue;
+		}
+
+		const int k = __builtin_ctz(stop);
+		lines += __builtin_popcount(newlines & ((1u << k) - 1));
+		return i + k;
+	}
+
+	return scan_scalar<cls>(src, i, n, until, lines);
+}
+
+template <ScanClass cls>
+__attribute__((target("avx2")))
+inline size_t scan_avx2(const char* src, size_t i, size_t n, char until, uint32_t& lines) {
+	const __m256i nl = _mm256_set1_epi8('\n');
+
+	while (i + 32 <= n)
+	{
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		__m256i match;
+
+		if constexpr (cls == ScanClass::space)
+			match = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), SCAN_RANGE_256(v, '\t', '\r'));
+		else if constexpr (cls == ScanClass::alnum)
+			match = _mm256_or_si256(SCAN_RANGE_256(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z'),
+						SCAN_RANGE_256(v, '0', '9'));
+		else if constexpr (cls == ScanClass::digit)
+			match = SCAN_RANGE_256(v, '0', '9');
+		else
+			match = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(until));
+
+		uint32_t stop = (uint32_t)_mm256_movemask_epi8(match);
+		if constexpr (cls != ScanClass::until)
+			stop = ~stop;
+
+		const uint32_t newlines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+		if (stop == 0)
+		{
+			lines += __builtin_popcount(newlines);
+			i += 32;
+			continue;
+		}
+
+		const int k = __builtin_ctz(stop);
+		lines += __builtin_popcount(newlines & ((1u << k) - 1));
+		return i + k;
+	}
+
+	return scan_sse2<cls>(src, i, n, until, lines);
+}
+
+#undef SCAN_RANGE_128
+#undef SCAN_RANGE_256
+
+inline bool scan_has_avx2() {
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	return has_avx2;
+}
+
+#endif
+
+template <ScanClass cls>
+inline size_t scan(std::string_view src, size_t i, uint32_t& lines, char until = '\0') {
+#ifdef SCAN_SIMD
+	//most runs are a few bytes long, settle those before paying for a vector load
+	const size_t head = i + SCAN_SCALAR_HEAD < src.size() ? i + SCAN_SCALAR_HEAD : src.size();
+	i = scan_scalar<cls>(src.data(), i, head, until, lines);
+	if (i < head)
+		return i;
+
+	if (scan_has_avx2())
+		return scan_avx2<cls>(src.data(), i, src.size(), until, lines);
+	return scan_sse2<cls>(src.data(), i, src.size(), until, lines);
+#else
+	return scan_scalar<cls>(src.data(), i, src.size(), until, lines);
+#endif
+}
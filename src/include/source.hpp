@@ -0,0 +1,77 @@
+#pragma once
+
+#include <iostream>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SOURCE_RELEASE_CHUNK (1 << 20)
+
+//Read-only memory mapping of a source file. Tokens point into this buffer by offset,
+//so it has to outlive every phase that reads token text.
+class SourceFile {
+public:
+	inline SourceFile(const char* path) {
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+		{
+			std::cerr << "Could not open source file: '" << path << "'\n";
+			exit(EXIT_FAILURE);
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) < 0)
+		{
+			std::cerr << "Could not stat source file: '" << path << "'\n";
+			exit(EXIT_FAILURE);
+		}
+
+		m_size = st.st_size;
+		if (m_size > 0)
+		{
+			void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED)
+			{
+				std::cerr << "Could not map source file: '" << path << "'\n";
+				exit(EXIT_FAILURE);
+			}
+
+			madvise(data, m_size, MADV_SEQUENTIAL);
+			m_data = static_cast<const char*>(data);
+		}
+
+		close(fd);
+	}
+
+	inline ~SourceFile() {
+		if (m_data)
+			munmap(const_cast<char*>(m_data), m_size);
+	}
+
+	inline SourceFile(const SourceFile& other) = delete;
+	inline SourceFile operator=(const SourceFile& other) = delete;
+
+	inline std::string_view view() const {
+		return std::string_view(m_data ? m_data : "", m_size);
+	}
+
+	//Drops the resident pages before offset. The mapping is private and never written, so a
+	//later read of that range faults the bytes back in from the file, views stay valid.
+	inline void release(size_t offset) {
+		if (offset < m_released + SOURCE_RELEASE_CHUNK)
+			return;
+
+		const size_t page = sysconf(_SC_PAGESIZE);
+		const size_t end = offset / page * page;
+		madvise(const_cast<char*>(m_data) + m_released, end - m_released, MADV_DONTNEED);
+		m_released = end;
+	}
+
+private:
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+	size_t m_released = 0;
+};
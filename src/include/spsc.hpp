@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+
+#define SPSC_CACHE_LINE 64
+#define SPSC_SPINS      64
+
+//Bounded single producer / single consumer ring buffer, no locks. Each side owns one index
+//and keeps a cached copy of the other's, so the shared cache lines only bounce when the
+//cached view says full or empty. A blocked side polls a few times, then yields its core.
+template <typename T, size_t N>
+class SpscQueue {
+	static_assert(N && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+public:
+	inline SpscQueue() = default;
+
+	inline SpscQueue(const SpscQueue& other) = delete;
+	inline SpscQueue operator=(const SpscQueue& other) = delete;
+
+	//producer side
+	inline void push(T value) {
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		unsigned spins = 0;
+		while (tail - m_head_cache == N)
+		{
+			m_head_cache = m_head.load(std::memory_order_acquire);
+			if (tail - m_head_cache == N)
+				backoff(spins);
+		}
+
+		m_slots[tail & (N - 1)] = std::move(value);
+		m_tail.store(tail + 1, std::memory_order_release);
+	}
+
+	//consumer side
+	inline T pop() {
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		unsigned spins = 0;
+		while (head == m_tail_cache)
+		{
+			m_tail_cache = m_tail.load(std::memory_order_acquire);
+			if (head == m_tail_cache)
+				backoff(spins);
+		}
+
+		T value = std::move(m_slots[head & (N - 1)]);
+		m_head.store(head + 1, std::memory_order_release);
+		return value;
+	}
+
+private:
+	//consumer owned
+	alignas(SPSC_CACHE_LINE) std::atomic<size_t> m_head = 0;
+	size_t m_tail_cache = 0;
+
+	//producer owned
+	alignas(SPSC_CACHE_LINE) std::atomic<size_t> m_tail = 0;
+	size_t m_head_cache = 0;
+
+	alignas(SPSC_CACHE_LINE) T m_slots[N];
+
+	static inline void backoff(unsigned& spins) {
+		if (++spins > SPSC_SPINS)
+			std::this_thread::yield();
+	}
+};
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <algorithm>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "./ir.hpp"
+
+//Pruned SSA over the registers SlotPromoter sets more than once (Cooper, Harvey and Kennedy
+//dominators). destroy() maps versions back to their variable, so passes in between must not
+//add reads of a version.
+class SsaBuilder {
+public:
+	inline SsaBuilder(IrProgram& prog) : m_prog(prog) {}
+
+	//Returns the number of phis placed
+	inline uint32_t build() {
+		m_count = m_prog.vregs.size();
+		count_defs();
+		number_preds();
+		dominators();
+		frontiers();
+		place_phis();
+		rename();
+		return m_phis;
+	}
+
+	inline void destroy() {
+		auto back = [&](uint32_t& v) {
+			if (v != NO_VREG)
+				v = origin(v);
+		};
+
+		for (IrBlock& block : m_prog.blocks)
+		{
+			block.phis.clear();
+			for (IrInst& inst : block.insts)
+			{
+				back(inst.dst);
+				back(inst.a);
+				back(inst.b);
+				back(inst.index);
+			}
+			back(block.term.a);
+			back(block.term.b);
+		}
+		m_prog.vregs.resize(m_count);
+	}
+
+	//Variable a version belongs to, the register itself for anything else
+	inline uint32_t origin(uint32_t v) const {
+		return v < m_count ? v : m_origin[v - m_count];
+	}
+
+	inline bool is_var(uint32_t v) const {
+		return m_defs[origin(v)] > 1;
+	}
+
+	//Immediate dominator, NO_BLOCK for the entry and blocks it does not reach
+	inline uint32_t idom(uint32_t b) const {
+		return b == 0 ? NO_BLOCK : m_idom[b];
+	}
+
+	inline std::span<const uint32_t> preds(uint32_t b) const {
+		return {m_preds.data() + m_pred_start[b], m_preds.data() + m_pred_start[b + 1]};
+	}
+
+	//Blocks b immediately dominates
+	inline std::span<const uint32_t> children(uint32_t b) const {
+		return {m_children.data() + m_child_start[b], m_children.data() + m_child_start[b + 1]};
+	}
+
+private:
+	IrProgram& m_prog;
+	uint32_t m_count = 0;                   //virtual registers before build()
+	uint32_t m_phis = 0;
+
+	std::vector<uint32_t> m_defs;           //virtual register -> number of definitions
+	std::vector<uint32_t> m_origin;         //version - m_count -> its variable
+
+	std::vector<uint32_t> m_pred_start;     //predecessors of b are m_preds[m_pred_start[b], m_pred_start[b + 1])
+	std::vector<uint32_t> m_preds;
+	std::vector<uint32_t> m_rpo;            //reverse postorder of the blocks the entry reaches
+	std::vector<uint32_t> m_idom;
+	std::vector<uint32_t> m_child_start;
+	std::vector<uint32_t> m_children;
+	std::vector<uint32_t> m_df_start;       //dominance frontier of b is m_df[m_df_start[b], m_df_start[b + 1])
+	std::vector<uint32_t> m_df;
+
+	inline void count_defs() {
+		m_defs.assign(m_count, 0);
+		for (const IrBlock& block : m_prog.blocks)
+			for (const IrInst& inst : block.insts)
+				if (inst.dst != NO_VREG)
+					m_defs[inst.dst]++;
+	}
+
+	inline void number_preds() {
+		const uint32_t blocks = m_prog.blocks.size();
+		m_pred_start.assign(blocks + 1, 0);
+		for (uint32_t b = 0; b < blocks; b++)
+		{
+			const auto [first, second] = m_prog.successors(b);
+			if (first != NO_BLOCK)
+				m_pred_start[first + 1]++;
+			if (second != NO_BLOCK && second != first)
+				m_pred_start[second + 1]++;
+		}
+		for (uint32_t b = 0; b < blocks; b++)
+			m_pred_start[b + 1] += m_pred_start[b];
+
+		m_preds.resize(m_pred_start[blocks]);
+		std::vector<uint32_t> fill(m_pred_start.begin(), m_pred_start.end() - 1);
+		for (uint32_t b = 0; b < blocks; b++)
+		{
+			const auto [first, second] = m_prog.successors(b);
+			if (first != NO_BLOCK)
+				m_preds[fill[first]++] = b;
+			if (second != NO_BLOCK && second != first)
+				m_preds[fill[second]++] = b;
+		}
+	}
+
+	inline void dominators() {
+		const uint32_t blocks = m_prog.blocks.size();
+
+		//postorder with an explicit stack
+		std::vector<uint32_t> post;
+		std::vector<uint8_t> looked(blocks, 0);     //successors looked at, a block is visited once it is 1
+		std::vector<uint32_t> stack = {0};
+		while (!stack.empty())
+		{
+			const uint32_t b = stack.back();
+			const auto [first, second] = m_prog.successors(b);
+			if (looked[b] == 2)
+			{
+				stack.pop_back();
+				post.push_back(b);
+				continue;
+			}
+			const uint32_t next = looked[b]++ == 0 ? first : second;
+			if (next != NO_BLOCK && next != 0 && looked[next] == 0)
+				stack.push_back(next);
+		}
+		m_rpo.assign(post.rbegin(), post.rend());
+
+		std::vector<uint32_t> order(blocks, NO_BLOCK);
+		for (uint32_t i = 0; i < m_rpo.size(); i++)
+			order[m_rpo[i]] = i;
+
+		auto intersect = [&](uint32_t l, uint32_t r) {
+			while (l != r)
+			{
+				while (order[l] > order[r])
+					l = m_idom[l];
+				while (order[r] > order[l])
+					r = m_idom[r];
+			}
+			return l;
+		};
+
+		m_idom.assign(blocks, NO_BLOCK);
+		m_idom[0] = 0;
+		for (bool changed = true; changed;)
+		{
+			changed = false;
+			for (size_t i = 1; i < m_rpo.size(); i++)
+			{
+				const uint32_t b = m_rpo[i];
+				uint32_t idom = NO_BLOCK;
+				for (const uint32_t p : preds(b))
+					if (m_idom[p] != NO_BLOCK)
+						idom = idom == NO_BLOCK ? p : intersect(p, idom);
+				if (m_idom[b] != idom)
+				{
+					m_idom[b] = idom;
+					changed = true;
+				}
+			}
+		}
+
+		m_child_start.assign(blocks + 1, 0);
+		for (uint32_t b = 1; b < blocks; b++)
+			if (m_idom[b] != NO_BLOCK)
+				m_child_start[m_idom[b] + 1]++;
+		for (uint32_t b = 0; b < blocks; b++)
+			m_child_start[b + 1] += m_child_start[b];
+
+		m_children.resize(m_child_start[blocks]);
+		std::vector<uint32_t> fill(m_child_start.begin(), m_child_start.end() - 1);
+		for (uint32_t b = 1; b < blocks; b++)
+			if (m_idom[b] != NO_BLOCK)
+				m_children[fill[m_idom[b]]++] = b;
+	}
+
+	inline void frontiers() {
+		const uint32_t blocks = m_prog.blocks.size();
+		std::vector<std::pair<uint32_t, uint32_t>> df;          //{block, block in its frontier}
+		std::vector<uint32_t> last(blocks, NO_BLOCK);
+
+		for (const uint32_t b : m_rpo)
+		{
+			if (m_pred_start[b + 1] - m_pred_start[b] < 2)
+				continue;
+			for (const uint32_t p : preds(b))
+				for (uint32_t runner = p; m_idom[runner] != NO_BLOCK && runner != m_idom[b]; runner = m_idom[runner])
+				{
+					if (last[runner] == b)
+						break;
+					last[runner] = b;
+					df.push_back({runner, b});
+				}
+		}
+		std::sort(df.begin(), df.end());
+
+		m_df_start.assign(blocks + 1, 0);
+		m_df.resize(df.size());
+		for (size_t i = 0; i < df.size(); i++)
+		{
+			m_df_start[df[i].first + 1]++;
+			m_df[i] = df[i].second;
+		}
+		for (uint32_t b = 0; b < blocks; b++)
+			m_df_start[b + 1] += m_df_start[b];
+	}
+
+	//Pruned SSA: a phi only where the variable is live in
+	inline void place_phis() {
+		const uint32_t blocks = m_prog.blocks.size();
+		std::vector<std::pair<uint32_t, uint32_t>> exposed;     //{variable, block reading it before setting it}
+		std::vector<std::pair<uint32_t, uint32_t>> def_in;      //{variable, block setting it}
+		std::vector<uint32_t> def_block(m_count, NO_BLOCK);
+		std::vector<uint32_t> seen_in(m_count, NO_BLOCK);
+
+		for (const uint32_t b : m_rpo)
+		{
+			auto use = [&](uint32_t v) {
+				if (v != NO_VREG && m_defs[v] > 1 && def_block[v] != b && seen_in[v] != b)
+				{
+					seen_in[v] = b;
+					exposed.push_back({v, b});
+				}
+			};
+
+			for (const IrInst& inst : m_prog.blocks[b].insts)
+			{
+				use(inst.a);
+				use(inst.b);
+				use(inst.index);
+				if (inst.dst != NO_VREG && m_defs[inst.dst] > 1 && def_block[inst.dst] != b)
+				{
+					def_block[inst.dst] = b;
+					def_in.push_back({inst.dst, b});
+				}
+			}
+			use(m_prog.blocks[b].term.a);
+			use(m_prog.blocks[b].term.b);
+		}
+
+		std::sort(exposed.begin(), exposed.end());
+		std::sort(def_in.begin(), def_in.end());
+
+		std::vector<uint32_t> defines(blocks, NO_VREG);
+		std::vector<uint32_t> live_in(blocks, NO_VREG);
+		std::vector<uint32_t> has_phi(blocks, NO_VREG);
+		std::vector<uint32_t> work;
+
+		size_t e = 0;
+		for (size_t d = 0; d < def_in.size();)
+		{
+			const uint32_t v = def_in[d].first;
+			for (; e < exposed.size() && exposed[e].first < v; e++)
+				;
+			for (; e < exposed.size() && exposed[e].first == v; e++)
+			{
+				live_in[exposed[e].second] = v;
+				work.push_back(exposed[e].second);
+			}
+			const size_t first_def = d;
+			for (; d < def_in.size() && def_in[d].first == v; d++)
+				defines[def_in[d].second] = v;
+
+			while (!work.empty())
+			{
+				const uint32_t b = work.back();
+				work.pop_back();
+				for (const uint32_t p : preds(b))
+					if (defines[p] != v && live_in[p] != v)
+					{
+						live_in[p] = v;
+						work.push_back(p);
+					}
+			}
+
+			for (size_t i = first_def; i < d; i++)
+				work.push_back(def_in[i].second);
+			while (!work.empty())
+			{
+				const uint32_t x = work.back();
+				work.pop_back();
+				for (uint32_t i = m_df_start[x]; i < m_df_start[x + 1]; i++)
+				{
+					const uint32_t y = m_df[i];
+					if (has_phi[y] == v || live_in[y] != v)
+						continue;
+					has_phi[y] = v;
+					m_prog.blocks[y].phis.push_back({v, {}});
+					m_phis++;
+					if (defines[y] != v)
+					{
+						defines[y] = v;
+						work.push_back(y);
+					}
+				}
+			}
+		}
+	}
+
+	inline uint32_t new_version(uint32_t v) {
+		m_origin.push_back(v);
+		return m_prog.new_vreg(m_prog.vregs[v]);
+	}
+
+	inline void rename() {
+		std::vector<uint32_t> top(m_count, NO_VREG);                    //variable -> its latest version
+		std::vector<std::pair<uint32_t, uint32_t>> undo;                //{variable, version it had}
+		std::vector<size_t> mark(m_prog.blocks.size(), 0);
+
+		auto read = [&](uint32_t& v) {
+			if (v != NO_VREG && m_defs[v] > 1 && top[v] != NO_VREG)
+				v = top[v];
+		};
+		auto set = [&](uint32_t& v) {
+			undo.push_back({v, top[v]});
+			top[v] = new_version(v);
+			v = top[v];
+		};
+
+		//b to enter a block, ~b to leave it
+		std::vector<uint32_t> walk = {0};
+		while (!walk.empty())
+		{
+			const uint32_t step = walk.back();
+			walk.pop_back();
+			if (step >= m_prog.blocks.size())
+			{
+				const size_t to = mark[~step];
+				for (size_t i = undo.size(); i-- > to;)
+					top[undo[i].first] = undo[i].second;
+				undo.resize(to);
+				continue;
+			}
+
+			const uint32_t b = step;
+			mark[b] = undo.size();
+			IrBlock& block = m_prog.blocks[b];
+			for (IrPhi& phi : block.phis)
+				set(phi.dst);
+			for (IrInst& inst : block.insts)
+			{
+				read(inst.a);
+				read(inst.b);
+				read(inst.index);
+				if (inst.dst != NO_VREG && m_defs[inst.dst] > 1)
+					set(inst.dst);
+			}
+			read(block.term.a);
+			read(block.term.b);
+
+			const auto [first, second] = m_prog.successors(b);
+			for (const uint32_t succ : {first, second})
+			{
+				if (succ == NO_BLOCK || (succ == second && second == first))
+					continue;
+				for (IrPhi& phi : m_prog.blocks[succ].phis)
+				{
+					uint32_t value = origin(phi.dst);
+					read(value);
+					phi.args.push_back({b, value});
+				}
+			}
+
+			walk.push_back(~b);
+			for (size_t i = children(b).size(); i-- > 0;)
+				walk.push_back(children(b)[i]);
+		}
+	}
+};
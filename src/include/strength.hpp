@@ -0,0 +1,185 @@
+#pragma once
+
+#include <bit>
+#include <vector>
+
+#include "./ir.hpp"
+
+//Replaces multiplication, division and modulo by a constant with cheaper operations, runs
+//right after IrBuilder while every virtual register still has a single definition.
+//
+//	x * 2^k                 shl x, k
+//	x * m * 2^k             mul x, m then shl, m of 3, 5 or 9 is a single lea to the Emitter
+//	x / 2^k, x % 2^k        shr x, k and and x, 2^k - 1
+//	x / d                   mulhi x, magic then shr (Granlund and Montgomery)
+//	x % d                   x - x / d * d
+//
+//Division is unsigned on all 64 bits like the div it replaces. Division by 0 is left alone.
+class StrengthReducer {
+public:
+	inline StrengthReducer(IrProgram& prog) : m_prog(prog) {}
+
+	//Returns the number of instructions replaced
+	inline uint32_t reduce() {
+		find_constants();
+		for (IrBlock& block : m_prog.blocks)
+			rewrite(block);
+		return m_reduced;
+	}
+
+private:
+	IrProgram& m_prog;
+	uint32_t m_reduced = 0;
+
+	std::vector<bool> m_known;              //virtual register -> only ever set by an imm
+	std::vector<int64_t> m_value;
+	std::vector<IrInst> m_out;              //the block being rewritten
+
+	inline void find_constants() {
+		std::vector<uint32_t> defs(m_prog.vregs.size(), 0);
+		m_known.assign(m_prog.vregs.size(), false);
+		m_value.assign(m_prog.vregs.size(), 0);
+
+		for (const IrBlock& block : m_prog.blocks)
+			for (const IrInst& inst : block.insts)
+				if (inst.dst != NO_VREG && defs[inst.dst]++ == 0 && inst.op == IrOp::imm)
+				{
+					m_known[inst.dst] = true;
+					m_value[inst.dst] = inst.imm;
+				}
+
+		for (uint32_t v = 0; v < defs.size(); v++)
+			if (defs[v] > 1)
+				m_known[v] = false;
+	}
+
+	inline uint32_t emit(const IrInst& inst, DataType type) {
+		IrInst placed = inst;
+		placed.dst = m_prog.new_vreg(type);
+		m_out.push_back(placed);
+		return placed.dst;
+	}
+
+	inline uint32_t constant(int64_t value) {
+		return emit({.op = IrOp::imm, .imm = value}, PTR);
+	}
+
+	inline void rewrite(IrBlock& block) {
+		m_out.clear();
+		m_out.reserve(block.insts.size());
+
+		for (const IrInst& inst : block.insts)
+		{
+			bool reduced = false;
+			switch (inst.op)
+			{
+				case IrOp::mul:
+					if (m_known[inst.b])
+						reduced = reduce_mul(inst.dst, inst.a, m_value[inst.b]);
+					else if (m_known[inst.a])
+						reduced = reduce_mul(inst.dst, inst.b, m_value[inst.a]);
+					break;
+
+				case IrOp::div:
+				case IrOp::mod:
+					if (m_known[inst.b] && m_value[inst.b] != 0)
+					{
+						reduce_div(inst, m_value[inst.b]);
+						reduced = true;
+					}
+					break;
+
+				default:
+					break;
+			}
+
+			if (reduced)
+				m_reduced++;
+			else
+				m_out.push_back(inst);
+		}
+
+		block.insts.swap(m_out);
+	}
+
+	//dst = a * c, false when a plain mul is as good
+	inline bool reduce_mul(uint32_t dst, uint32_t a, int64_t c) {
+		const uint64_t factor = c;
+		if (factor == 0)
+			return false;
+
+		const int shift = std::countr_zero(factor);
+		const uint64_t odd = factor >> shift;
+		if (shift == 0 || (odd != 1 && odd != 3 && odd != 5 && odd != 9))
+			return false;
+
+		if (odd != 1)
+			a = emit({.op = IrOp::mul, .a = a, .b = constant(odd)}, m_prog.vregs[dst]);
+		m_out.push_back({.op = IrOp::shl, .dst = dst, .a = a, .imm = shift});
+		return true;
+	}
+
+	inline void reduce_div(const IrInst& inst, int64_t c) {
+		const uint64_t d = c;
+		const DataType type = m_prog.vregs[inst.dst];
+
+		if (std::has_single_bit(d))
+		{
+			if (inst.op == IrOp::div)
+				m_out.push_back({.op = d == 1 ? IrOp::copy : IrOp::shr, .dst = inst.dst, .a = inst.a, .imm = std::countr_zero(d)});
+			else
+				m_out.push_back({.op = IrOp::and_, .dst = inst.dst, .a = inst.a, .b = constant(d - 1)});
+			return;
+		}
+
+		if (inst.op == IrOp::div)
+		{
+			divide(inst.dst, inst.a, d);
+			return;
+		}
+
+		const uint32_t quotient = m_prog.new_vreg(type);
+		divide(quotient, inst.a, d);
+		const uint32_t product = m_prog.new_vreg(type);
+		if (!reduce_mul(product, quotient, d))
+			m_out.push_back({.op = IrOp::mul, .dst = product, .a = quotient, .b = constant(d)});
+		m_out.push_back({.op = IrOp::sub, .dst = inst.dst, .a = inst.a, .b = product});
+	}
+
+	//dst = a / d for d not a power of two
+	inline void divide(uint32_t dst, uint32_t a, uint64_t d) {
+		using u128 = unsigned __int128;
+		const DataType type = m_prog.vregs[dst];
+
+		//the smallest p with a magic number in 64 bits, m = ceil(2^(64 + p) / d) works
+		//when m * d overshoots 2^(64 + p) by at most 2^p
+		for (int p = 0; p < 64; p++)
+		{
+			const u128 power = (u128)1 << (64 + p);
+			const u128 magic = (power + d - 1) / d;
+			if (magic >> 64)
+				break;
+			if (magic * d - power > ((u128)1 << p))
+				continue;
+
+			if (p == 0)
+			{
+				m_out.push_back({.op = IrOp::mulhi, .dst = dst, .a = a, .b = constant((int64_t)magic)});
+				return;
+			}
+			const uint32_t high = emit({.op = IrOp::mulhi, .a = a, .b = constant((int64_t)magic)}, type);
+			m_out.push_back({.op = IrOp::shr, .dst = dst, .a = high, .imm = p});
+			return;
+		}
+
+		//the magic number needs 65 bits, its top bit is added back as (a - t) / 2 + t
+		const int bits = 64 - std::countl_zero(d - 1);
+		const u128 magic = ((u128)1 << 64) * (((u128)1 << bits) - d) / d + 1;
+
+		const uint32_t high = emit({.op = IrOp::mulhi, .a = a, .b = constant((int64_t)magic)}, type);
+		const uint32_t rest = emit({.op = IrOp::sub, .a = a, .b = high}, type);
+		const uint32_t half = emit({.op = IrOp::shr, .a = rest, .imm = 1}, type);
+		const uint32_t sum = emit({.op = IrOp::add, .a = half, .b = high}, type);
+		m_out.push_back({.op = IrOp::shr, .dst = dst, .a = sum, .imm = bits - 1});
+	}
+};
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <cstdint>
+#include <string_view>
 
-enum class TokenType 
+#include "./scan.hpp"
+#include "./intern.hpp"
+
+
+enum class TokenType : uint8_t
 {
 	exit,
 	open_paren,
@@ -37,13 +43,21 @@ enum class TokenType
 	dref
 };
 
+//Tokens do not own their text, they index into the source buffer.
+//Identifiers also carry their Interner id.
 struct Token 
 {
 	TokenType type; 
-	size_t line;
-	std::optional<std::string> value;	
+	uint32_t line;
+	size_t offset;
+	uint32_t length;
+	uint32_t id = 0;
 };
 
+inline std::string_view token_str(const Token& tok, std::string_view src) {
+	return src.substr(tok.offset, tok.length);
+}
+
 std::optional<int> bin_op_prec(const Token& tok) {
 	switch(tok.type)
 	{
@@ -124,236 +138,375 @@ std::string type_to_str(TokenType type) {
 }
 
 
-class Tokenizer {
-public:
-	inline Tokenizer (std::string p_src) : m_src(std::move(p_src)), m_index(0), m_line(1) {};
+//LEXER TABLES
+//Everything below is built at compile time from the two spelling lists. A new operator or
+//keyword only needs a row in LEX_OPS or LEX_KEYWORDS.
 
-	inline std::vector<Token> tokenize() {
-		std::vector<Token> output;
+#define LEX_REJECT          0xFF
+#define LEX_LINE_COMMENT    0xFE
+#define LEX_BLOCK_COMMENT   0xFD
+#define LEX_MAX_STATES      32
+#define LEX_KEYWORD_BITS    5
+
+struct LexOp
+{
+	std::string_view spelling;
+	uint8_t accept;             //TokenType, or one of the LEX_ codes above
+};
+
+#define LEX_TOK(t) static_cast<uint8_t>(TokenType::t)
+
+constexpr LexOp LEX_OPS[] = {
+	{";",  LEX_TOK(semi)},      {"|",  LEX_TOK(v_bar)},       {",",  LEX_TOK(comma)},
+	{"(",  LEX_TOK(open_paren)},{")",  LEX_TOK(close_paren)}, {"{",  LEX_TOK(open_curly)},
+	{"}",  LEX_TOK(close_curly)},
+	{"=",  LEX_TOK(eq)},        {"==", LEX_TOK(eq_to)},       {"!=", LEX_TOK(not_eq_to)},
+	{"+",  LEX_TOK(plus)},      {"-",  LEX_TOK(minus)},       {"->", LEX_TOK(dref)},
+	{"*",  LEX_TOK(star)},      {"/",  LEX_TOK(fslash)},      {"%",  LEX_TOK(modulo)},
+	{">",  LEX_TOK(g_than)},    {"<",  LEX_TOK(l_than)},      {"^",  LEX_TOK(ptr)},
+	{"~",  LEX_TOK(tilde)},     {"&",  LEX_TOK(addr_of)},
+	{"//", LEX_LINE_COMMENT},   {"/*", LEX_BLOCK_COMMENT}
+};
+
+struct LexKeyword
+{
+	std::string_view word;
+	TokenType type;
+};
+
+constexpr LexKeyword LEX_KEYWORDS[] = {
+	{"exit", TokenType::exit},      {"if",    TokenType::_if},
+	{"elif", TokenType::elif},      {"else",  TokenType::_else},
+	{"loop", TokenType::loop},      {"write", TokenType::write},
+	{"char", TokenType::data_type}, {"int",   TokenType::data_type},
+	{"intptr", TokenType::data_type}, {"charptr", TokenType::data_type}
+};
+
+//Operator DFA, a trie over LEX_OPS. State 0 is the start state and no edge leads back to it,
+//so next == 0 means "no transition".
+struct LexDfa
+{
+	uint8_t next[LEX_MAX_STATES][256];
+	uint8_t accept[LEX_MAX_STATES];
+};
+
+constexpr LexDfa lex_build_dfa() {
+	LexDfa dfa{};
+	int states = 1;
 
-		std::string buf;
-		while(peak().has_value())
+	for (int s = 0; s < LEX_MAX_STATES; s++)
+		dfa.accept[s] = LEX_REJECT;
+
+	for (const LexOp& op : LEX_OPS)
+	{
+		int state = 0;
+		for (char c : op.spelling)
 		{
-			char current = peak().value();
-			if (isspace(current))
+			uint8_t& edge = dfa.next[state][(uint8_t)c];
+			if (edge == 0)
 			{
-				if (current == '\n')
-					m_line++;
-				consume();
+				if (states == LEX_MAX_STATES)
+					throw "LEX_MAX_STATES too small for LEX_OPS";
+				edge = states++;
 			}
-			else if (isalpha(current))
-			{
-				buf.push_back(consume());
-				while (peak().has_value() && isalnum(peak().value()))
-					buf.push_back(consume());
-
-				if (buf == "exit")
-					output.push_back({TokenType::exit, m_line});
-				else if (buf == "if")
-					output.push_back({TokenType::_if, m_line});
-				else if (buf == "elif")
-					output.push_back({TokenType::elif, m_line});
-				else if (buf == "else")
-					output.push_back({TokenType::_else, m_line});
-				else if (buf == "loop")
-					output.push_back({TokenType::loop, m_line});
-				else if (buf == "write")
-					output.push_back({TokenType::write, m_line});
-				else if (buf == "char"   ||
-					 buf == "int"    ||
-					 buf == "intptr" ||
-					 buf == "charptr" )
-					output.push_back({TokenType::data_type, m_line, buf});			
-				else {
-					output.push_back({TokenType::ident, m_line, buf});
-				}
+			state = edge;
+		}
+		dfa.accept[state] = op.accept;
+	}
 
-				buf.clear();
-			}
+	return dfa;
+}
 
-			else if (isdigit(current)) 
-			{
-				while (peak().has_value() && isdigit(peak().value()))
-					buf.push_back(consume());
+constexpr LexDfa LEX_DFA = lex_build_dfa();
 
-				output.push_back({TokenType::int_lit, m_line, buf});
+//What the first byte of a token decides
+enum class LexClass : uint8_t
+{
+	invalid,
+	space,
+	alpha,
+	digit,
+	quote,
+	dquote,
+	op
+};
 
-			    	buf.clear();
-			}
+struct LexClassTable
+{
+	LexClass cls[256];
+};
 
-			else if (current == '\'' && peak(2).has_value() && peak(2).value() == '\'') 
-			{
-				consume();
-				buf.push_back(consume());
-				output.push_back({TokenType::char_lit, m_line, buf});
-				consume();
+constexpr LexClassTable lex_build_classes() {
+	LexClassTable table{};
+	for (int c = 0; c < 256; c++)
+	{
+		const char ch = (char)c;
+		if (scan_is_space(ch))         table.cls[c] = LexClass::space;
+		else if (scan_is_alpha(ch))    table.cls[c] = LexClass::alpha;
+		else if (scan_is_digit(ch))    table.cls[c] = LexClass::digit;
+		else if (ch == '\'')           table.cls[c] = LexClass::quote;
+		else if (ch == '\"')           table.cls[c] = LexClass::dquote;
+		else if (LEX_DFA.next[0][c])   table.cls[c] = LexClass::op;
+		else                           table.cls[c] = LexClass::invalid;
+	}
+	return table;
+}
 
-				buf.clear();
-			}
+constexpr LexClassTable LEX_CLASSES = lex_build_classes();
 
-			else if (current == '\"' )
-			{
-				consume();
-				while (peak().has_value() && peak().value() != '\"')
-					buf.push_back(consume());
-				consume();
+//Keyword perfect hash: multiplicative hash of (length, first, last byte), with the multiplier
+//searched at compile time so that every keyword lands in its own slot.
+constexpr uint32_t lex_keyword_key(std::string_view word) {
+	return (uint32_t)word.size() | (uint32_t)(uint8_t)word.front() << 8 | (uint32_t)(uint8_t)word.back() << 16;
+}
 
-				output.push_back({TokenType::str_lit, m_line, buf});
+constexpr uint32_t lex_keyword_hash(uint32_t key, uint32_t seed) {
+	return (key * seed) >> (32 - LEX_KEYWORD_BITS);
+}
 
-				buf.clear();
-			}
+constexpr uint32_t lex_find_seed() {
+	for (uint32_t seed = 0x9E3779B1; seed < 0x9E3779B1 + 2 * 4096; seed += 2)
+	{
+		bool used[1 << LEX_KEYWORD_BITS] = {};
+		bool collision = false;
+		for (const LexKeyword& kw : LEX_KEYWORDS)
+		{
+			const uint32_t slot = lex_keyword_hash(lex_keyword_key(kw.word), seed);
+			if (used[slot]) { collision = true; break; }
+			used[slot] = true;
+		}
+		if (!collision)
+			return seed;
+	}
+	throw "No perfect hash seed for LEX_KEYWORDS, raise LEX_KEYWORD_BITS";
+}
 
-			else if (current == '=' && peak(1).has_value() && peak(1).value() == '=')
-			{
-				consume();
-				consume();
-				output.push_back({TokenType::eq_to, m_line});
-			}
+struct LexKeywordSlot
+{
+	uint32_t key;               //0 for an empty slot, no word has length 0
+	LexKeyword kw;
+};
 
-			else if (current == '!' && peak(1).has_value() && peak(1).value() == '=')
-			{	
-				consume();
-				consume();
-				output.push_back({TokenType::not_eq_to, m_line});
-			}
+struct LexKeywordTable
+{
+	uint32_t seed;
+	LexKeywordSlot slots[1 << LEX_KEYWORD_BITS];
+};
 
-			else if (current == '-' && peak(1).has_value() && peak(1).value() == '>')
-			{
-				consume();
-				consume();
-				output.push_back({TokenType::dref, m_line});
-			}
+constexpr LexKeywordTable lex_build_keywords() {
+	LexKeywordTable table{};
+	table.seed = lex_find_seed();
+	for (LexKeywordSlot& slot : table.slots)
+		slot = {0, {"", TokenType::ident}};
+	for (const LexKeyword& kw : LEX_KEYWORDS)
+	{
+		const uint32_t key = lex_keyword_key(kw.word);
+		table.slots[lex_keyword_hash(key, table.seed)] = {key, kw};
+	}
+	return table;
+}
 
-			else if (current == '/' && peak(1).has_value() && peak(1).value() == '/')	//Single line comments	
-			{
-				consume(); consume();
-				while (peak().has_value() && peak().value() != '\n')
-					consume();
-			}
+constexpr LexKeywordTable LEX_KEYWORD_TABLE = lex_build_keywords();
+
+//One hash probe. The stored key rejects nearly every identifier with a single integer
+//compare, only a key match looks at the middle bytes. The length in the key is not masked,
+//so words of 256 bytes or more can match one and are rejected by their size.
+inline TokenType lex_keyword(std::string_view word) {
+	const uint32_t key = lex_keyword_key(word);
+	const LexKeywordSlot& slot = LEX_KEYWORD_TABLE.slots[lex_keyword_hash(key, LEX_KEYWORD_TABLE.seed)];
+	if (slot.key != key || slot.kw.word.size() != word.size())
+		return TokenType::ident;
+
+	for (size_t i = 1; i + 1 < word.size(); i++)
+		if (slot.kw.word[i] != word[i])
+			return TokenType::ident;
+
+	return slot.kw.type;
+}
+
+#undef LEX_TOK
+
+
+//Where a streaming Parser pulls its tokens from
+class TokenSource {
+public:
+	virtual ~TokenSource() = default;
+
+	//Appends more tokens to output, about count of them.
+	//Returns false once the input is exhausted and nothing was appended.
+	virtual bool pull(std::vector<Token>& output, size_t count) = 0;
+};
+
+class Tokenizer : public TokenSource {
+public:
+	inline Tokenizer (std::string_view p_src, Interner& p_interner) 
+		: m_src(p_src), m_interner(p_interner), m_index(0), m_line(1) {};
+
+	inline std::vector<Token> tokenize() {
+		std::vector<Token> output;
+		lex(output, SIZE_MAX);
+
+		//a tokenizer used again starts over at the first line
+		m_index = 0;
+		m_line = 1;
+		return output;
+	}
 
-			else if (current == '/' && peak(1).has_value() && peak(1).value() == '*')        /*multi line comments*/
+	//Lazy tokenizing for streaming, appends at most count tokens
+	inline bool pull(std::vector<Token>& output, size_t count) override {
+		const size_t before = output.size();
+		lex(output, before + count);
+		m_pulled += output.size() - before;
+		return output.size() != before;
+	}
+
+	inline size_t pulled() const {
+		return m_pulled;
+	}
+	
+private:
+	const std::string_view m_src;
+	Interner& m_interner;
+	size_t m_index;
+	uint32_t m_line;
+	size_t m_pulled = 0;
+
+	//Lexes until output holds limit tokens or the source ends
+	inline void lex(std::vector<Token>& output, size_t limit) {
+		while(m_index < m_src.size() && output.size() < limit)
+		{
+			const char current = m_src[m_index];
+			const size_t start = m_index;
+
+			switch (LEX_CLASSES.cls[(uint8_t)current])
 			{
-				consume(); consume();
-				auto p1 = peak();
-				auto p2 = peak(1);
-				while (p1.has_value())
+				case LexClass::space:
+					m_index = scan<ScanClass::space>(m_src, m_index, m_line);
+					break;
+
+				case LexClass::alpha:
 				{
-					if (p1.value() == '*' && p2.has_value() && p2.value() == '/')
+					m_index = scan<ScanClass::alnum>(m_src, m_index + 1, m_line);
+
+					const std::string_view word = m_src.substr(start, m_index - start);
+					const TokenType type = lex_keyword(word);
+					if (type == TokenType::ident)
+						output.push_back({type, m_line, start, (uint32_t)word.size(), m_interner.intern(word)});
+					else
+						push_token(output, type, start);
+					break;
+				}
+
+				case LexClass::digit:
+					m_index = scan<ScanClass::digit>(m_src, m_index + 1, m_line);
+					push_token(output, TokenType::int_lit, start);
+					break;
+
+				case LexClass::quote:
+					if (peak(2) != '\'')
+						invalid_char();
+
+					output.push_back({TokenType::char_lit, m_line, start + 1, 1});
+					m_index += 3;
+					break;
+
+				case LexClass::dquote:
+				{
+					const uint32_t line = m_line;
+					m_index = scan<ScanClass::until>(m_src, m_index + 1, m_line, '\"');
+					if (m_index >= m_src.size())
 					{
-						consume(); consume();
-						break;
+						std::cerr << "[Tokenizer] |LINE <" << line << ">| Unterminated string literal\n";
+						exit(EXIT_FAILURE);
 					}
-					
-					consume();
 
-					p1 = p2;
-					p2 = peak(1);
+					output.push_back({TokenType::str_lit, line, start + 1, (uint32_t)(m_index - start - 1)});
+					consume();
+					break;
 				}
+
+				case LexClass::op:
+					lex_op(output);
+					break;
+
+				case LexClass::invalid:
+					invalid_char();
 			}
-	
+		}
+	}
+
+	//Longest match through LEX_DFA, one table lookup per byte
+	inline void lex_op(std::vector<Token>& output) {
+		const size_t start = m_index;
+		uint8_t state = 0;
+		uint8_t accept = LEX_REJECT;
+		size_t accept_end = start;
 
-			else 
+		while (m_index < m_src.size())
+		{
+			const uint8_t next = LEX_DFA.next[state][(uint8_t)m_src[m_index]];
+			if (next == 0)
+				break;
+
+			state = next;
+			m_index++;
+			if (LEX_DFA.accept[state] != LEX_REJECT)
 			{
-				switch(current)
+				accept = LEX_DFA.accept[state];
+				accept_end = m_index;
+			}
+		}
+
+		m_index = accept_end;
+		switch (accept)
+		{
+			case LEX_REJECT:
+				invalid_char();
+
+			case LEX_LINE_COMMENT:
+				m_index = scan<ScanClass::until>(m_src, m_index, m_line, '\n');
+				break;
+
+			case LEX_BLOCK_COMMENT:
+				while (m_index < m_src.size())
 				{
-					case ';':
-						consume();
-						output.push_back({TokenType::semi, m_line});
-						break;
-					case '|': 
-						consume();
-						output.push_back({TokenType::v_bar, m_line});
-						break;
-					case ',':
-						consume();
-						output.push_back({TokenType::comma, m_line});
-						break;
-					case '(':
-						consume();
-						output.push_back({TokenType::open_paren, m_line});
-						break;
-					case ')':
-						consume();
-						output.push_back({TokenType::close_paren, m_line});
-						break;
-					case '{':
-						consume();
-						output.push_back({TokenType::open_curly, m_line});
-						break;
-					case '}':
-						consume();
-						output.push_back({TokenType::close_curly, m_line});
-						break;
-					case '=':
-						consume();
-						output.push_back({TokenType::eq, m_line});
-						break;
-					case '+':
-						consume();
-						output.push_back({TokenType::plus, m_line});
-						break;
-					case '*':
-						consume();
-						output.push_back({TokenType::star, m_line});
-						break;
-					case '-':
-						consume();
-						output.push_back({TokenType::minus, m_line});
-						break;
-					case '/':
-						consume();
-						output.push_back({TokenType::fslash, m_line});
-						break;
-					case '%':
-						consume();
-						output.push_back({TokenType::modulo, m_line});
-					   	break;	
-					case '>':
-						consume();
-						output.push_back({TokenType::g_than, m_line});
-						break;
-					case '<':
-						consume();
-						output.push_back({TokenType::l_than, m_line});
-						break;
-					case '^':
-						consume();
-						output.push_back({TokenType::ptr, m_line});
-						break;
-					case '~':
-						consume();
-						output.push_back({TokenType::tilde, m_line});
+					m_index = scan<ScanClass::until>(m_src, m_index, m_line, '*');
+					if (peak() == '*' && peak(1) == '/')
+					{
+						consume(); consume();
 						break;
-					case '&':
+					}
+
+					if (m_index < m_src.size())
 						consume();
-						output.push_back({TokenType::addr_of, m_line});
-						break;
-					default:
-						std::cerr<<"try something valid next time bitchass mf\n";
-						exit(EXIT_FAILURE);
 				}
-			}	
+				break;
+
+			default:
+				push_token(output, static_cast<TokenType>(accept), start);
 		}
+	}
 
-		m_index = 0;
-		return output;
-	
+	[[noreturn]] inline void invalid_char() const {
+		std::cerr<<"try something valid next time bitchass mf\n";
+		exit(EXIT_FAILURE);
 	}
-	
-private:
-	const std::string m_src;
-	size_t m_index;
-	size_t m_line;
 
-	inline std::optional<char> peak(int jump = 0) const {
+	//'\0' past the end, every caller compares against a printable character
+	inline char peak(size_t jump = 0) const {
 		if (m_index + jump >= m_src.length())
-			return std::nullopt; 
+			return '\0'; 
 
-		return m_src.at(m_index + jump);
+		return m_src[m_index + jump];
 	}
 
 	inline char consume() {  
-		return m_src.at(m_index++);
+		return m_src[m_index++];
+	}
+
+	//token text is everything consumed since start
+	inline void push_token(std::vector<Token>& output, TokenType type, size_t start) const {
+		output.push_back({type, m_line, start, (uint32_t)(m_index - start)});
 	}
 
 };
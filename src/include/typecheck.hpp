@@ -1,28 +1,31 @@
 #pragma once
 
 #include "parser.hpp"
-#include "arena.hpp"
+#include "ast.hpp"
 #include "types.hpp"
+#include "resolver.hpp"
 
 #include <utility>
 
 class TypeChecker {
 public:	
-	struct VarType
-	{
-		DataType type;
-		std::optional<DataType> pointed_type;
-	};
+	using VarType = ::VarType;
+
+	//symbols come from the Resolver, which has already bound every identifier
+	inline TypeChecker(const std::vector<Symbol>& symbols, std::string_view src) : m_symbols(symbols), m_src(src) {}
 	
-	inline void check(const NodeProg* prog) {
-		for (const NodeStmt* stmt : prog->stmts)
+	inline void check(Ast* ast) {
+		m_ast = ast;
+		for (const uint32_t stmt : ast->stmts)
 		{
 			check_stmt(stmt);
 		}	
 	}
 
-	inline const std::unordered_map<std::string, VarType>& get_sym_table() {
-		return m_sym_table;
+	//Streaming: checks one top level statement
+	inline void check(Ast* ast, uint32_t stmt) {
+		m_ast = ast;
+		check_stmt(stmt);
 	}
 
 private:
@@ -33,7 +36,9 @@ private:
 		RET_PTED_TYPE
 	}; //STUPID workaround bit sleepy rn
 	
-	std::unordered_map<std::string, VarType> m_sym_table;
+	const std::vector<Symbol>& m_symbols;
+	std::string_view m_src;
+	Ast* m_ast = nullptr;
 	
 	#define NO_INCOMP_OP_TYPES   2
 	#define NO_INCOMP_CNV_TYPES  4
@@ -68,272 +73,189 @@ private:
 
 
 	//STMTS
-	inline void check_stmt(const NodeStmt* stmt) {
-		struct stmt_Visitor 
-		{
-			TypeChecker* tc;
+	inline void check_stmt(uint32_t stmt) {
+		Ast& ast = *m_ast;
+		const uint32_t a = ast.a[stmt];
+		const uint32_t b = ast.b[stmt];
+		const uint32_t c = ast.c[stmt];
 
-			void operator()(const NodeStmtExit* exit) const {
+		switch (ast.kind[stmt])
+		{
+			case NodeKind::stmt_exit:
 				//Implement a way to verify RVALUE or LVALUE
-				exit->expr->type = tc->check_expr(exit->expr);
-			}
+				ast.type[a] = check_expr(a);
+				break;
 
-			void operator()(const NodeStmtDeclare* declare) const {
-				//Implement Better Pointer chaining
-				std::string ident = declare->ident.value.value();
-				if (tc->m_sym_table.contains(ident))
-				{
-					std::cerr << "Cannot Redeclare: '" << ident << "'\n";
-					exit(EXIT_FAILURE);	
-				}
+			case NodeKind::stmt_declare:
+				break;
 
-				if (declare->count > 1)
-				{
-					tc->m_sym_table.insert({ident, VarType{.type = PTR, .pointed_type = declare->type}});
-				}
-			 	else if (declare->type == PTR)
-				{
-					tc->m_sym_table.insert({ident, 
-							   VarType{.type = PTR, .pointed_type = declare->pointed_type.value()}});
-				} else {
-					tc->m_sym_table.insert({ident, VarType{.type = declare->type}});
-				  }
-			}
-
-			void operator()(const NodeStmtAssign* assign) const {
+			case NodeKind::stmt_assign:
+			{
 				//Implement Rvalue vs Lvalue check
 				
-				DataType t1 = tc->check_expr(assign->lvalue_expr);
-				assign->lvalue_expr->type = t1;
+				DataType t1 = check_expr(a);
+				ast.type[a] = t1;
 
-				if (assign->rvalue_expr.has_value())
+				if (b != NO_NODE)
 				{
-					DataType t2 = tc->check_expr(assign->rvalue_expr.value());
-					assign->rvalue_expr.value()->type = t2;
+					DataType t2 = check_expr(b);
+					ast.type[b] = t2;
 
 					if (t1 != t2)
 					{
-						assign->rvalue_expr.value()->type = tc->implicit_convert(t1, t2);
+						ast.type[b] = implicit_convert(t1, t2);
 					}
 				}
+				break;
 			}
 
-			void operator()(const NodeStmtScope* scope) const {
-				for (const NodeStmt* stmt : scope->stmts)
+			case NodeKind::stmt_scope:
+				for (uint32_t i = a; i < a + b; i++)
 				{
-					tc->check_stmt(stmt);
+					check_stmt(ast.lists[i]);
 				}
-			}
+				break;
 
-			void operator()(const NodeStmtIf* if_stmt) const {
+			case NodeKind::stmt_if:
+			case NodeKind::chain_elif:
 				//Implement Rvalue Lvalue check
-				if_stmt->expr->type = tc->check_expr(if_stmt->expr);
-				tc->check_stmt(if_stmt->stmt);
+				ast.type[a] = check_expr(a);
+				check_stmt(b);
 
-				if (if_stmt->chain.has_value())
+				if (c != NO_NODE)
 				{
-					tc->check_if_chain(if_stmt->chain.value());
+					check_stmt(c);
 				}
-			}
-
-			void operator()(const NodeStmtLoop* loop) const {
-				loop->expr->type = tc->check_expr(loop->expr);
-				tc->check_stmt(loop->scope);
-			}
+				break;
 
-			void operator()(const NodeStmtWrite* write) const {
-				tc->check_write_stmt(write);
-			}
-		};
+			case NodeKind::chain_else:
+				check_stmt(b);
+				break;
 
-		stmt_Visitor visitor{.tc = this};
-		std::visit(visitor, stmt->var);
-	}
+			case NodeKind::stmt_loop:
+				ast.type[a] = check_expr(a);
+				check_stmt(b);
+				break;
 
-	inline void check_if_chain(const NodeIfChain* chain) {
-		struct chain_Visitor 
-		{
-			TypeChecker* tc;
+			case NodeKind::stmt_write_expr:
+				check_write_stmt(stmt);
+				break;
 
-			void operator()(NodeChainElif* elif) const {
-				elif->expr->type = tc->check_expr(elif->expr);
-				tc->check_stmt(elif->stmt);
+			case NodeKind::stmt_write_str:
+				break;
 
-				if (elif->chain.has_value())
-				{
-					tc->check_if_chain(elif->chain.value());
-				}
-			}
-
-			void operator()(NodeChainElse* _else) const {
-				tc->check_stmt(_else->stmt);
-			}
-		};
-
-		chain_Visitor visitor{.tc = this};
-		std::visit(visitor, chain->var);
+			default:
+				std::cerr << "Expected a statement node\n";
+				exit(EXIT_FAILURE);
+		}
 	}
 
-	inline void check_write_stmt(const NodeStmtWrite* write) {
-		struct write_Visitor 
-		{
-			TypeChecker* tc;
-			std::optional<NodeExpr*> bytes;
-
-			void operator()(NodeExpr* const expr) const {
-				expr->type = tc->check_expr(expr);
-				
-				if (expr->type != CHAR)
-				{
-					if (tc->check_expr(expr, RET_PTED_TYPE) != CHAR)
-					{
-						std::cerr << "WRITE WRITES CHARACTER RETARD\n";
-						exit(EXIT_FAILURE);
-					}
-				}
+	inline void check_write_stmt(uint32_t write) {
+		Ast& ast = *m_ast;
+		const uint32_t expr = ast.a[write];
+		const uint32_t bytes = ast.b[write];
 
-				if (bytes.has_value())
-				{
-					bytes.value()->type = tc->check_expr(bytes.value());
-					if (bytes.value()->type != INT)
-					{
-						std::cerr << "Give me the number of characters to print fuckface\n";
-						exit(EXIT_FAILURE);
-					}
-				}
+		ast.type[expr] = check_expr(expr);
+		
+		if (ast.type[expr] != CHAR)
+		{
+			if (check_expr(expr, RET_PTED_TYPE) != CHAR)
+			{
+				std::cerr << "WRITE WRITES CHARACTER RETARD\n";
+				exit(EXIT_FAILURE);
 			}
+		}
 
-			void operator()(const std::string str) const {
-				return;
+		if (bytes != NO_NODE)
+		{
+			ast.type[bytes] = check_expr(bytes);
+			if (ast.type[bytes] != INT)
+			{
+				std::cerr << "Give me the number of characters to print fuckface\n";
+				exit(EXIT_FAILURE);
 			}
-		};
-
-		write_Visitor visitor{.tc = this, .bytes = write->no_of_bytes};
-		std::visit(visitor, write->var);
+		}
 	}
 
 	//Exprs
-	inline DataType check_expr(const NodeExpr* expr, Flag flag = RET_TYPE) {
-		struct expr_Visitor 
-		{
-			TypeChecker* tc;
-			Flag flag;
+	inline DataType check_expr(uint32_t expr, Flag flag = RET_TYPE) {
+		Ast& ast = *m_ast;
+		const uint32_t a = ast.a[expr];
+		const uint32_t b = ast.b[expr];
 
-			DataType operator()(NodeTerm* const term) const {
-				return tc->check_term(term, flag);
-			}
-
-			DataType operator()(NodeBinExpr* const bin_expr) const {
-				return tc->check_bin_expr(bin_expr);
-			}
-
-			DataType operator()(NodeUnExpr* const un_expr) const {
-				return tc->check_un_expr(un_expr);
-			}
-		};
-
-		expr_Visitor visitor{.tc = this, .flag = flag};
-		return std::visit(visitor, expr->var);
-	}
-
-	inline DataType check_term(const NodeTerm* term, Flag flag) {
-		struct term_Visitor
+		switch (ast.kind[expr])
 		{
-			TypeChecker* tc;
-			Flag flag;
-
-			DataType operator()(const NodeTermInt* int_lit) const {
+			case NodeKind::term_int:
 				return INT;
-			}
 
-			DataType operator()(const NodeTermChar* char_lit) const {
+			case NodeKind::term_char:
 				return CHAR;
-			}
 
-			DataType operator()(const NodeTermIdent* ident_term) const {
-				const std::string ident = ident_term->ident.value.value();
-				if (!tc->m_sym_table.contains(ident))
-				{
-					std::cerr << "'" << ident << "' was NEVER declared fucknigga\n";
-					exit(EXIT_FAILURE);
-				}
-				
+			case NodeKind::term_ident:
+			{
+				const VarType& types = m_symbols[b].types;
+
 				if (flag == RET_PTED_TYPE)                   //BAD workaround. Implement pointers better
 				{
-					if (tc->m_sym_table[ident].type == PTR)
-						return tc->m_sym_table[ident].pointed_type.value();
+					if (types.type == PTR)
+						return types.pointed_type.value();
 					else 
 					{
 						std::cerr << "Trying to access pointed type of a non pointer :(\n";
 						exit(EXIT_FAILURE);
 					} 
 				} else 
-					 return tc->m_sym_table[ident].type;
-			}
-
-			DataType operator()(const NodeTermParen* paren) const {
-				return tc->check_expr(paren->expr);
+					 return types.type;
 			}
-		};
-
-		term_Visitor visitor{.tc = this, .flag = flag};
-		return std::visit(visitor, term->var);
-	}
 
-	inline DataType check_bin_expr(const NodeBinExpr* bin_expr) {	
-		return std::visit	
-			([this](auto obj) 
-			{
-				obj->lhs->type = check_expr(obj->lhs);
-				obj->rhs->type = check_expr(obj->rhs);
+			case NodeKind::term_paren:
+				return check_expr(a);
 
-				return compatible_type( obj->lhs->type, obj->rhs->type );
-			},bin_expr->var);
-	}
+			case NodeKind::bin_add:
+			case NodeKind::bin_sub:
+			case NodeKind::bin_multi:
+			case NodeKind::bin_div:
+			case NodeKind::bin_mod:
+			case NodeKind::bin_cmp:
+				ast.type[a] = check_expr(a);
+				ast.type[b] = check_expr(b);
 
-	inline DataType check_un_expr(const NodeUnExpr* un_expr) {
-		struct un_Visitor
-		{
-			TypeChecker* tc;
+				return compatible_type( ast.type[a], ast.type[b] );
 
-			DataType operator()(const NodeUnExprDref* dref) const {
-				if (dref->rvalue_expr.has_value())
+			case NodeKind::un_dref:
+				if (b != NO_NODE)
 				{
-					if ((dref->rvalue_expr.value()->type = tc->check_expr(dref->rvalue_expr.value())) != INT)
+					if ((ast.type[b] = check_expr(b)) != INT)
 					{
 						std::cerr << "fuck u tryna do\n";
 						exit(EXIT_FAILURE);
 					}
 				}
 
-				dref->lvalue_expr->type = tc->check_expr(dref->lvalue_expr);
+				ast.type[a] = check_expr(a);
 
-				return tc->check_expr(dref->lvalue_expr, RET_PTED_TYPE);
-			}
+				return check_expr(a, RET_PTED_TYPE);
 
-			DataType operator()(const NodeUnExprIncrement* increment) const {
-				if (increment->rvalue_expr.has_value())
+			case NodeKind::un_increment:
+				if (b != NO_NODE)
 				{
-					if ((increment->rvalue_expr.value()->type = tc->check_expr(increment->rvalue_expr.value())) != INT)
+					if ((ast.type[b] = check_expr(b)) != INT)
 					{
 						std::cerr << "not very sigma :(\n";
 						exit(EXIT_FAILURE);
 					}
 				}
 
-				return increment->lvalue_expr->type = tc->check_expr(increment->lvalue_expr);
-			}
+				return ast.type[a] = check_expr(a);
 
-			DataType operator()(const NodeUnExprAddr* addr) const {
-				addr->lvalue_expr->type = tc->check_expr(addr->lvalue_expr);
+			case NodeKind::un_addr:
+				ast.type[a] = check_expr(a);
 				
 				return PTR;
-			}
-		};
 
-		un_Visitor visitor{.tc = this};
-		return std::visit(visitor, un_expr->var);
+			default:
+				std::cerr << "Expected an expression node\n";
+				exit(EXIT_FAILURE);
+		}
 	}
-
-	
 };
@@ -6,7 +6,7 @@
 
 #define BITMASK(x) (UINT32_C(1) << (x*8)) - 1
 
-enum DataType 
+enum DataType : uint8_t
 {
 	CHAR,
 	INT,
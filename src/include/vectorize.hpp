@@ -0,0 +1,662 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "./ir.hpp"
+#include "./types.hpp"
+#include "./x86.hpp"
+
+//Runs counted loops over arrays a vector of elements at a time. Runs after LoopHoister, on
+//loops of a single block as IrBuilder lays them out: a preheader that only jumps to the block
+//and the block branching back to itself.
+//
+//	- the counter i is an int set in the loop only by i = i + 1, after every other read of
+//	  it, and the loop goes on while i < n for an n set outside the loop
+//	- every load and store is of [base + i * size + imm] with the base set outside the loop,
+//	  all of them of the same type, int or char, which gives the lanes
+//	- in between there is add, sub, and, copy, zext and imm, with int lanes also mul and shl.
+//	  The low bytes of their results only depend on the low bytes of their operands, so the
+//	  lanes get what the stores keep
+//	- what the loop sets is only read later in the same trip, except sums s = s + x, which
+//	  are kept as partial sums in a vector. With char lanes x has to be a load, its bytes are
+//	  summed up into dwords
+//
+//The vector loop goes in front of the original one, which runs what is left over. It is also
+//what runs when there is not a whole vector's worth of trips, or when arrays reached through
+//different bases overlap:
+//
+//	preheader       br i < n ? check : scalar, signed like the loop itself
+//	check           n32 = zext.int n, br i + lanes - 1 < n32 ? alias : scalar. The loop only
+//	                looks at the low 32 bits of n, and once i < n held signed, i and n32 are
+//	                on the same side of 2^31 or this fails, so unsigned compares with n32
+//	                from here on agree with the loop
+//	alias           br the bytes the loop reaches through two bases overlap ? scalar : setup,
+//	                for every pair of bases where one side stores, frame slots included
+//	                since an index is not checked against its array. Left out when no
+//	                such pair exists
+//	setup           splats of the invariants, lane numbers, zeroed partial sums
+//	vector          the loop on vectors, br i < n32 - lanes + 1 ? vector : remainder
+//	remainder       partial sums added up into their variables, br i < n ? scalar : exit
+//	scalar          jmp loop
+//
+//Accesses through the same base are checked when the loop is compiled instead: they must not
+//reach an element another lane of the same vector reaches first in the original order.
+class LoopVectorizer {
+public:
+	//vector_bytes is 16 for SSE2, 32 for AVX2
+	inline LoopVectorizer(IrProgram& prog, uint32_t vector_bytes) : m_prog(prog) {
+		m_prog.vector_bytes = vector_bytes;
+	}
+
+	//Returns the number of loops vectorized
+	inline uint32_t vectorize() {
+		scan();
+
+		std::vector<Plan> plans;
+		const uint32_t blocks = m_prog.blocks.size();
+		for (uint32_t h = 1; h < blocks; h++)
+		{
+			if (!is_loop(h))
+				continue;
+
+			const size_t vregs = m_prog.vregs.size();
+			Plan plan;
+			if (build(h, plan))
+				plans.push_back(std::move(plan));
+			else
+				m_prog.vregs.resize(vregs);
+		}
+
+		if (!plans.empty())
+			rebuild(plans);
+		return plans.size();
+	}
+
+private:
+	static constexpr uint32_t MANY = NO_BLOCK - 1;
+
+	struct Access
+	{
+		uint32_t base;
+		int64_t base_key;               //slot + 1 for the address of a slot, -vreg - 1 otherwise
+		int64_t disp;
+		bool store;
+	};
+
+	struct Plan
+	{
+		uint32_t header;
+		uint32_t counter;
+		uint32_t limit;
+		uint32_t narrow;                //low 32 bits of limit, zero extended
+		uint32_t lanes;
+		std::vector<IrInst> check;      //the alias check, empty when it is not needed
+		uint32_t overlaps = NO_VREG;    //non zero when some ranges overlap
+		std::vector<IrInst> setup;
+		std::vector<IrInst> body;
+		std::vector<IrInst> finish;
+	};
+
+	IrProgram& m_prog;
+	TypeTable m_Table;
+
+	std::vector<uint32_t> m_defs;           //virtual register -> number of definitions
+	std::vector<uint32_t> m_uses;
+	std::vector<uint32_t> m_use_block;      //block it is read in, MANY for more than one
+	std::vector<uint32_t> m_slot;           //slot of a single slot_addr, NO_BLOCK otherwise
+	std::vector<int64_t> m_imm;             //value of a single imm
+	std::vector<bool> m_const;
+
+	//Per loop, stamped with the header so nothing needs clearing between loops
+	std::vector<uint32_t> m_here;           //set in the loop
+	std::vector<uint32_t> m_def_at;         //index of the definition in the loop
+	std::vector<uint32_t> m_vector_stamp;
+	std::vector<uint32_t> m_vector;         //the vector register that stands for it
+	uint32_t m_vectors = 0;
+
+	inline uint8_t size_of(DataType type) const {
+		return m_Table[type].type_size;
+	}
+
+	inline void scan() {
+		const uint32_t count = m_prog.vregs.size();
+		m_defs.assign(count, 0);
+		m_uses.assign(count, 0);
+		m_use_block.assign(count, NO_BLOCK);
+		m_slot.assign(count, NO_BLOCK);
+		m_imm.assign(count, 0);
+		m_const.assign(count, false);
+		m_here.assign(count, NO_BLOCK);
+		m_def_at.assign(count, 0);
+		m_vector_stamp.assign(count, NO_BLOCK);
+		m_vector.assign(count, NO_VREG);
+
+		for (uint32_t b = 0; b < m_prog.blocks.size(); b++)
+		{
+			auto use = [&](uint32_t v) {
+				if (v == NO_VREG)
+					return;
+				m_uses[v]++;
+				m_use_block[v] = m_use_block[v] == NO_BLOCK || m_use_block[v] == b ? b : MANY;
+			};
+
+			for (const IrInst& inst : m_prog.blocks[b].insts)
+			{
+				use(inst.a);
+				use(inst.b);
+				use(inst.index);
+				if (inst.dst == NO_VREG)
+					continue;
+
+				m_defs[inst.dst]++;
+				m_const[inst.dst] = m_defs[inst.dst] == 1 && inst.op == IrOp::imm;
+				m_imm[inst.dst] = inst.imm;
+				m_slot[inst.dst] = m_defs[inst.dst] == 1 && inst.op == IrOp::slot_addr ? inst.imm : NO_BLOCK;
+			}
+			use(m_prog.blocks[b].term.a);
+			use(m_prog.blocks[b].term.b);
+		}
+	}
+
+	//h branches back to itself and is otherwise only entered from the preheader right before it
+	inline bool is_loop(uint32_t h) const {
+		const IrTerm& term = m_prog.blocks[h].term;
+		const IrTerm& preheader = m_prog.blocks[h - 1].term;
+		if (term.kind != IrTermKind::br || term.target != h || term.other == h
+		    || preheader.kind != IrTermKind::jmp || preheader.target != h)
+			return false;
+
+		for (uint32_t b = 0; b < m_prog.blocks.size(); b++)
+		{
+			const auto [first, second] = m_prog.successors(b);
+			if (b != h && b != h - 1 && (first == h || second == h))
+				return false;
+		}
+		return true;
+	}
+
+	inline bool is_const(uint32_t v, int64_t value) const {
+		return v != NO_VREG && m_const[v] && m_imm[v] == value;
+	}
+
+	inline uint32_t new_vector(DataType type) {
+		m_vectors++;
+		return m_prog.new_vreg(type);
+	}
+
+	inline uint32_t new_imm(std::vector<IrInst>& insts, DataType type, int64_t value) {
+		const uint32_t v = m_prog.new_vreg(type);
+		insts.push_back({.op = IrOp::imm, .dst = v, .imm = value});
+		return v;
+	}
+
+	//Reads of v in block h
+	inline uint32_t reads(uint32_t h, uint32_t v) const {
+		const IrBlock& block = m_prog.blocks[h];
+		uint32_t n = (block.term.a == v) + (block.term.b == v);
+		for (const IrInst& inst : block.insts)
+			n += (inst.a == v) + (inst.b == v) + (inst.index == v);
+		return n;
+	}
+
+	//insts[def] of loop h is v = zext.int (add v, x) and the only definition of v there, the
+	//add comes before it and is read nowhere else
+	inline bool sum_of(uint32_t h, size_t def, uint32_t v) const {
+		const std::vector<IrInst>& insts = m_prog.blocks[h].insts;
+		const IrInst& zext = insts[def];
+		if (zext.op != IrOp::zext || zext.type != INT || m_prog.vregs[v] != INT
+		    || m_here[zext.a] != h || m_defs[zext.a] != 1 || m_uses[zext.a] != 1 || m_def_at[zext.a] > def)
+			return false;
+		for (size_t i = 0; i < insts.size(); i++)
+			if (insts[i].dst == v && i != def)
+				return false;
+
+		const IrInst& add = insts[m_def_at[zext.a]];
+		return add.op == IrOp::add && (add.a == v || add.b == v);
+	}
+
+	//A lane may not reach an element that another lane of the same vector reaches first in
+	//the original order, the vector does everything one access does before the next one
+	static inline bool independent(const std::vector<Access>& accesses, uint32_t size, uint32_t lanes) {
+		for (size_t p = 0; p < accesses.size(); p++)
+			for (size_t q = p + 1; q < accesses.size(); q++)
+			{
+				if (accesses[p].base_key != accesses[q].base_key || !(accesses[p].store || accesses[q].store))
+					continue;
+
+				//q reaches what p reaches trips later, q comes first in the loop
+				const int64_t apart = accesses[q].disp - accesses[p].disp;
+				if (apart % size != 0 || (apart > 0 && apart / size < lanes))
+					return false;
+			}
+		return true;
+	}
+
+	//Bytes [base + low + i * size, base + high + n32 * size) for every base, where the loop runs
+	//from i to n32, compared when a store goes through either of them. Even two frame slots are,
+	//an index is not checked against the size of its array.
+	inline void alias_check(Plan& plan, const std::vector<Access>& accesses, uint32_t size) {
+		struct Range
+		{
+			int64_t key;
+			uint32_t base;
+			int64_t low;
+			int64_t high;
+			bool store;
+			uint32_t start = NO_VREG;
+			uint32_t end = NO_VREG;
+		};
+
+		std::vector<Range> ranges;
+		for (const Access& access : accesses)
+		{
+			auto range = std::find_if(ranges.begin(), ranges.end(), [&](const Range& r) {
+				return r.key == access.base_key;
+			});
+			if (range == ranges.end())
+				ranges.push_back({access.base_key, access.base, access.disp, access.disp, access.store});
+			else {
+				range->low = std::min(range->low, access.disp);
+				range->high = std::max(range->high, access.disp);
+				range->store |= access.store;
+			  }
+		}
+
+		std::vector<IrInst>& check = plan.check;
+		uint32_t first = NO_VREG;
+		uint32_t last = NO_VREG;
+		auto bytes = [&](uint32_t v) {
+			if (size == 1)
+				return v;
+			const uint32_t shifted = m_prog.new_vreg(PTR);
+			check.push_back({.op = IrOp::shl, .dst = shifted, .a = v, .imm = size == 4 ? 2 : 0});
+			return shifted;
+		};
+		auto offset = [&](uint32_t base, uint32_t index, int64_t disp) {
+			uint32_t address = m_prog.new_vreg(PTR);
+			check.push_back({.op = IrOp::add, .dst = address, .a = base, .b = index});
+			if (disp)
+			{
+				const uint32_t moved = m_prog.new_vreg(PTR);
+				check.push_back({.op = IrOp::add, .dst = moved, .a = address, .b = new_imm(check, PTR, disp)});
+				address = moved;
+			}
+			return address;
+		};
+		auto bounds = [&](Range& range) {
+			if (range.start != NO_VREG)
+				return;
+			if (first == NO_VREG)
+			{
+				first = bytes(plan.counter);
+				last = bytes(plan.narrow);
+			}
+			range.start = offset(range.base, first, range.low);
+			range.end = offset(range.base, last, range.high);
+		};
+
+		for (size_t p = 0; p < ranges.size(); p++)
+			for (size_t q = p + 1; q < ranges.size(); q++)
+			{
+				Range& l = ranges[p];
+				Range& r = ranges[q];
+				if (!(l.store || r.store))
+					continue;
+
+				bounds(l);
+				bounds(r);
+				const uint32_t below = m_prog.new_vreg(INT);
+				const uint32_t above = m_prog.new_vreg(INT);
+				const uint32_t both = m_prog.new_vreg(INT);
+				check.push_back({.op = IrOp::set, .type = PTR, .cond = IrCond::ult, .dst = below, .a = l.start, .b = r.end});
+				check.push_back({.op = IrOp::set, .type = PTR, .cond = IrCond::ult, .dst = above, .a = r.start, .b = l.end});
+				check.push_back({.op = IrOp::and_, .dst = both, .a = below, .b = above});
+				if (plan.overlaps == NO_VREG)
+					plan.overlaps = both;
+				else {
+					const uint32_t total = m_prog.new_vreg(INT);
+					check.push_back({.op = IrOp::add, .dst = total, .a = plan.overlaps, .b = both});
+					plan.overlaps = total;
+				  }
+			}
+	}
+
+	inline uint32_t inserted(const Plan& plan) const {
+		return plan.check.empty() ? 5 : 6;
+	}
+
+	//Puts the blocks of plan after the loop's preheader, the last block so far
+	inline void insert(Plan& plan, uint32_t exit) {
+		const uint32_t check = m_prog.blocks.size();
+		const uint32_t alias = check + 1;
+		const uint32_t setup = check + inserted(plan) - 4;
+		const uint32_t vector = setup + 1;
+		const uint32_t remainder = vector + 1;
+		const uint32_t scalar = remainder + 1;
+		const uint32_t counter = plan.counter;
+		const uint32_t limit = plan.limit;
+
+		m_prog.blocks.back().term = {.kind = IrTermKind::br, .cond = IrCond::slt, .type = INT, .a = counter, .b = limit, .target = check, .other = scalar};
+
+		IrBlock block;
+		block.insts.push_back({.op = IrOp::zext, .type = INT, .dst = plan.narrow, .a = limit});
+		const uint32_t spare = new_imm(block.insts, PTR, plan.lanes - 1);
+		const uint32_t last = m_prog.new_vreg(PTR);
+		block.insts.push_back({.op = IrOp::add, .dst = last, .a = counter, .b = spare});
+		block.term = {.kind = IrTermKind::br, .cond = IrCond::ult, .type = PTR, .a = last, .b = plan.narrow, .target = alias, .other = scalar};
+		m_prog.blocks.push_back(std::move(block));
+
+		if (!plan.check.empty())
+		{
+			block = {};
+			block.insts = std::move(plan.check);
+			const uint32_t zero = new_imm(block.insts, INT, 0);
+			block.term = {.kind = IrTermKind::br, .cond = IrCond::ne, .type = INT, .a = plan.overlaps, .b = zero, .target = scalar, .other = setup};
+			m_prog.blocks.push_back(std::move(block));
+		}
+
+		block = {};
+		block.insts = std::move(plan.setup);
+		const uint32_t end = m_prog.new_vreg(PTR);
+		const uint32_t step = new_imm(block.insts, PTR, plan.lanes);
+		block.insts.push_back({.op = IrOp::sub, .dst = end, .a = plan.narrow, .b = spare});
+		block.term = {.kind = IrTermKind::jmp, .target = vector};
+		m_prog.blocks.push_back(std::move(block));
+
+		block = {};
+		block.insts = std::move(plan.body);
+		block.insts.push_back({.op = IrOp::add, .dst = counter, .a = counter, .b = step});
+		block.term = {.kind = IrTermKind::br, .cond = IrCond::ult, .type = PTR, .a = counter, .b = end, .target = vector, .other = remainder};
+		m_prog.blocks.push_back(std::move(block));
+
+		block = {};
+		block.insts = std::move(plan.finish);
+		block.term = {.kind = IrTermKind::br, .cond = IrCond::slt, .type = INT, .a = counter, .b = limit, .target = scalar, .other = exit};
+		m_prog.blocks.push_back(std::move(block));
+
+		block = {};
+		block.term = {.kind = IrTermKind::jmp, .target = scalar + 1};
+		m_prog.blocks.push_back(std::move(block));
+	}
+
+	//Lays the blocks out again with the plans in front of their loops
+	inline void rebuild(std::vector<Plan>& plans) {
+		const uint32_t blocks = m_prog.blocks.size();
+		std::vector<uint32_t> renumber(blocks);
+		uint32_t added = 0;
+		for (uint32_t b = 0, p = 0; b < blocks; b++)
+		{
+			if (p < plans.size() && plans[p].header == b)
+				added += inserted(plans[p++]);
+			renumber[b] = b + added;
+		}
+
+		std::vector<IrBlock> old = std::move(m_prog.blocks);
+		m_prog.blocks.clear();
+		m_prog.blocks.reserve(blocks + added);
+		for (uint32_t b = 0, p = 0; b < blocks; b++)
+		{
+			IrTerm& term = old[b].term;
+			if (term.target != NO_BLOCK)
+				term.target = renumber[term.target];
+			if (term.other != NO_BLOCK)
+				term.other = renumber[term.other];
+
+			if (p < plans.size() && plans[p].header == b)
+				insert(plans[p++], term.other);
+			m_prog.blocks.push_back(std::move(old[b]));
+		}
+	}
+
+	inline bool build(uint32_t h, Plan& plan) {
+		const std::vector<IrInst>& insts = m_prog.blocks[h].insts;
+		const IrTerm& term = m_prog.blocks[h].term;
+		if (term.type != INT || (term.cond != IrCond::slt && term.cond != IrCond::sgt))
+			return false;
+
+		const uint32_t counter = term.cond == IrCond::slt ? term.a : term.b;
+		const uint32_t limit = term.cond == IrCond::slt ? term.b : term.a;
+
+		for (size_t i = 0; i < insts.size(); i++)
+			if (insts[i].dst != NO_VREG)
+			{
+				m_here[insts[i].dst] = h;
+				m_def_at[insts[i].dst] = i;
+			}
+		if (m_here[limit] == h || m_prog.vregs[counter] != INT)
+			return false;
+
+		//the lanes are the type of the loads and stores
+		DataType type = INT;
+		bool typed = false;
+		for (const IrInst& inst : insts)
+			if (inst.op == IrOp::load || inst.op == IrOp::store)
+			{
+				if ((inst.type != INT && inst.type != CHAR) || (typed && inst.type != type))
+					return false;
+				type = inst.type;
+				typed = true;
+			}
+		const uint32_t size = size_of(type);
+		const uint32_t lanes = m_prog.vector_bytes / size;
+
+		//i = zext.int (add i, 1) after every other read of i
+		const size_t step = std::find_if(insts.begin(), insts.end(), [&](const IrInst& inst) {
+			return inst.dst == counter;
+		}) - insts.begin();
+		if (step == insts.size() || !sum_of(h, step, counter))
+			return false;
+		const IrInst& add = insts[m_def_at[insts[step].a]];
+		if (!is_const(add.a == counter ? add.b : add.a, 1))
+			return false;
+		for (size_t i = step + 1; i < insts.size(); i++)
+			if (insts[i].a == counter || insts[i].b == counter || insts[i].index == counter)
+				return false;
+
+		plan = {};
+		plan.header = h;
+		plan.counter = counter;
+		plan.limit = limit;
+		plan.narrow = m_prog.new_vreg(INT);
+		plan.lanes = lanes;
+		m_vectors = 0;
+		uint32_t lane_numbers = NO_VREG;
+		uint32_t mask = NO_VREG;
+		std::vector<Access> accesses;
+		bool stores = false;
+
+		//The vector standing for v in the current trip
+		auto lane = [&](uint32_t v) -> uint32_t {
+			if (v == counter)
+			{
+				if (lane_numbers == NO_VREG)
+				{
+					lane_numbers = new_vector(type);
+					plan.setup.push_back({.op = IrOp::vlanes, .type = type, .dst = lane_numbers, .a = counter});
+				}
+				return lane_numbers;
+			}
+			if (m_vector_stamp[v] == h)
+				return m_vector[v];
+			if (m_here[v] == h)
+				return NO_VREG;
+
+			const uint32_t splat = new_vector(type);
+			plan.setup.push_back({.op = IrOp::vsplat, .type = type, .dst = splat, .a = v});
+			m_vector_stamp[v] = h;
+			m_vector[v] = splat;
+			return splat;
+		};
+		auto define = [&](uint32_t v, uint32_t vector) {
+			m_vector_stamp[v] = h;
+			m_vector[v] = vector;
+		};
+		auto address = [&](const IrInst& inst) {
+			if (m_here[inst.a] == h || inst.index != counter || inst.type != type)
+				return false;
+			const int64_t key = m_slot[inst.a] != NO_BLOCK ? (int64_t)m_slot[inst.a] + 1 : -(int64_t)inst.a - 1;
+			accesses.push_back({inst.a, key, inst.imm, inst.op == IrOp::store});
+			return true;
+		};
+
+		//every other variable set in the loop is a sum, its add goes to the partial sums
+		std::vector<bool> skip(insts.size(), false);
+		std::vector<uint32_t> sum_at(insts.size(), NO_VREG);
+		skip[step] = true;
+		skip[m_def_at[insts[step].a]] = true;
+		for (size_t i = 0; i < insts.size(); i++)
+		{
+			const uint32_t v = insts[i].dst;
+			if (v == NO_VREG || v == counter || m_defs[v] == 1)
+				continue;
+			if (!sum_of(h, i, v) || reads(h, v) != 1)
+				return false;
+			skip[i] = true;
+			sum_at[m_def_at[insts[i].a]] = v;
+		}
+
+		for (size_t i = 0; i < insts.size(); i++)
+		{
+			const IrInst& inst = insts[i];
+			if (skip[i])
+				continue;
+
+			if (sum_at[i] != NO_VREG)
+			{
+				const uint32_t sum = sum_at[i];
+				const uint32_t x = inst.a == sum ? inst.b : inst.a;
+				uint32_t part = lane(x);
+				if (part == NO_VREG)
+					return false;
+				if (type == CHAR)
+				{
+					if (m_here[x] != h || insts[m_def_at[x]].op != IrOp::load)
+						return false;
+					const uint32_t bytes = new_vector(INT);
+					plan.body.push_back({.op = IrOp::vsad, .type = INT, .dst = bytes, .a = part});
+					part = bytes;
+				}
+
+				const uint32_t partial = new_vector(INT);
+				plan.setup.push_back({.op = IrOp::vsplat, .type = INT, .dst = partial, .a = new_imm(plan.setup, INT, 0)});
+				plan.body.push_back({.op = IrOp::vadd, .type = INT, .dst = partial, .a = partial, .b = part});
+
+				const uint32_t total = m_prog.new_vreg(INT);
+				const uint32_t added = m_prog.new_vreg(INT);
+				plan.finish.push_back({.op = IrOp::vsum, .type = INT, .dst = total, .a = partial});
+				plan.finish.push_back({.op = IrOp::add, .dst = added, .a = sum, .b = total});
+				plan.finish.push_back({.op = IrOp::zext, .type = INT, .dst = sum, .a = added});
+				continue;
+			}
+
+			//the rest is read in the same trip, after it is set
+			if (inst.dst != NO_VREG && m_use_block[inst.dst] != h && m_use_block[inst.dst] != NO_BLOCK)
+				return false;
+
+			switch (inst.op)
+			{
+				case IrOp::imm:
+				{
+					const uint32_t value = new_imm(plan.setup, m_prog.vregs[inst.dst], inst.imm);
+					const uint32_t splat = new_vector(type);
+					plan.setup.push_back({.op = IrOp::vsplat, .type = type, .dst = splat, .a = value});
+					define(inst.dst, splat);
+					break;
+				}
+
+				case IrOp::copy:
+				case IrOp::zext:
+				{
+					const uint32_t a = lane(inst.a);
+					if (a == NO_VREG)
+						return false;
+					if (inst.op == IrOp::copy || size_of(inst.type) >= size)
+					{
+						define(inst.dst, a);
+						break;
+					}
+
+					//chars in int lanes
+					if (mask == NO_VREG)
+					{
+						mask = new_vector(type);
+						plan.setup.push_back({.op = IrOp::vsplat, .type = type, .dst = mask, .a = new_imm(plan.setup, INT, UINT8_MAX)});
+					}
+					const uint32_t dst = new_vector(type);
+					plan.body.push_back({.op = IrOp::vand, .type = type, .dst = dst, .a = a, .b = mask});
+					define(inst.dst, dst);
+					break;
+				}
+
+				case IrOp::add:
+				case IrOp::sub:
+				case IrOp::and_:
+				case IrOp::mul:
+				{
+					const uint32_t a = lane(inst.a);
+					const uint32_t b = lane(inst.b);
+					if (a == NO_VREG || b == NO_VREG || (inst.op == IrOp::mul && type != INT))
+						return false;
+
+					const IrOp op = inst.op == IrOp::add ? IrOp::vadd : inst.op == IrOp::sub ? IrOp::vsub : inst.op == IrOp::and_ ? IrOp::vand : IrOp::vmul;
+					const uint32_t dst = new_vector(type);
+					plan.body.push_back({.op = op, .type = type, .dst = dst, .a = a, .b = b});
+					define(inst.dst, dst);
+					break;
+				}
+
+				case IrOp::shl:
+				{
+					const uint32_t a = lane(inst.a);
+					if (a == NO_VREG || type != INT || inst.imm >= 32)
+						return false;
+
+					const uint32_t dst = new_vector(type);
+					plan.body.push_back({.op = IrOp::vshl, .type = type, .dst = dst, .a = a, .imm = inst.imm});
+					define(inst.dst, dst);
+					break;
+				}
+
+				case IrOp::load:
+				{
+					if (!address(inst))
+						return false;
+					const uint32_t dst = new_vector(type);
+					plan.body.push_back({.op = IrOp::vload, .type = type, .dst = dst, .a = inst.a, .index = counter, .imm = inst.imm});
+					define(inst.dst, dst);
+					break;
+				}
+
+				case IrOp::store:
+				{
+					const uint32_t b = lane(inst.b);
+					if (b == NO_VREG || !address(inst))
+						return false;
+					plan.body.push_back({.op = IrOp::vstore, .type = type, .a = inst.a, .b = b, .index = counter, .imm = inst.imm});
+					stores = true;
+					break;
+				}
+
+				default:
+					return false;
+			}
+		}
+
+		if ((!stores && plan.finish.empty()) || !independent(accesses, size, lanes))
+			return false;
+
+		if (lane_numbers != NO_VREG)
+		{
+			const uint32_t step = new_vector(type);
+			plan.setup.push_back({.op = IrOp::vsplat, .type = type, .dst = step, .a = new_imm(plan.setup, INT, lanes)});
+			plan.body.push_back({.op = IrOp::vadd, .type = type, .dst = lane_numbers, .a = lane_numbers, .b = step});
+		}
+		if (m_vectors > NO_OF_VECTOR_REGS)
+			return false;
+
+		alias_check(plan, accesses, size);
+		return true;
+	}
+};
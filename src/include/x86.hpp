@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+//Registers. The first NO_OF_REGS are the ones RegAlloc hands out, in the order it prefers
+//them, the ones a syscall touches last. rax, rdx and r11 are scratch for div and mul, spill
+//reloads and syscalls. Vector registers go to xmm0 up to NO_OF_VECTOR_REGS, the rest are
+//scratch for the Emitter. With AVX2 the same numbers name the ymm registers.
+enum X86Reg : uint8_t
+{
+	RBX, R8, R9, R10, R12, R13, R14, R15, RSI, RDI, RCX,
+	NO_OF_REGS,
+	RAX = NO_OF_REGS, RDX, R11, RSP,
+	XMM0,
+	XMM13 = XMM0 + 13, XMM14, XMM15,
+	NO_REG = UINT8_MAX
+};
+
+constexpr uint8_t NO_OF_VECTOR_REGS = XMM13 - XMM0;
+
+enum class X86Op : uint8_t
+{
+	label,              //dst: block
+	mov,
+	movzx,
+	lea,
+	add,
+	sub,
+	imul,
+	mul,                //rdx:rax = rax * dst, unsigned
+	div,                //dst: divisor
+	xor_,
+	and_,
+	shl,
+	shr,
+	cmp,
+	test,
+	set,                //dst = cond
+	jcc,                //dst: block
+	jmp,                //dst: block
+	syscall,
+
+	//SSE2, the AVX2 form when the vector registers are ymm. dst is also the first source
+	//where the SSE2 form has only two operands.
+	movdqu,             //vector load or store
+	movdqa,             //vector register to vector register
+	movd,               //dword between a general register or memory and the low lane
+	movq,               //qword from a general register to the low lane
+	pshufd,             //dst = the dwords of src picked by imm
+	punpcklbw,          //interleave the low halves of dst and src
+	punpcklwd,
+	punpckldq,
+	punpcklqdq,
+	paddb,
+	paddd,
+	psubb,
+	psubd,
+	pand,
+	pxor,
+	pmuludq,            //qword lanes = their low dwords multiplied
+	pmulld,             //AVX2 only
+	pslld,              //src: shift count
+	psadbw,             //qword lanes = sum of absolute byte differences
+	vpbroadcastb,       //AVX2, every lane = the low lane of src
+	vpbroadcastd,
+	vinserti128,        //AVX2, upper half of dst = src, imm 1
+	vextracti128,       //AVX2, dst = upper half of src, imm 1
+
+	nop                 //deleted by Peephole
+};
+
+//Pairs that test the opposite thing sit next to each other, invert flips the low bit
+enum class X86Cond : uint8_t
+{
+	e, ne,
+	b, ae,
+	a, be,
+	l, ge,
+	g, le
+};
+
+inline X86Cond invert(X86Cond cond) {
+	return (X86Cond)((uint8_t)cond ^ 1);
+}
+
+struct X86Operand
+{
+	enum class Kind : uint8_t {none, reg, imm, mem, block, msg};
+
+	Kind kind = Kind::none;
+	uint8_t size = 8;               //bytes a register or memory access covers
+	uint8_t reg = NO_REG;           //the register, or the base of a memory operand
+	uint8_t index = NO_REG;         //memory operand only, added scale times
+	uint8_t scale = 1;
+	int64_t value = 0;              //immediate, displacement, block or message number
+
+	inline bool operator==(const X86Operand&) const = default;
+
+	inline bool uses(uint8_t r) const {
+		return (kind == Kind::reg || kind == Kind::mem) && (reg == r || index == r);
+	}
+};
+
+inline X86Operand x86_reg(uint8_t reg, uint8_t size = 8) {
+	return {.kind = X86Operand::Kind::reg, .size = size, .reg = reg};
+}
+
+inline X86Operand x86_imm(int64_t value) {
+	return {.kind = X86Operand::Kind::imm, .value = value};
+}
+
+inline X86Operand x86_mem(uint8_t base, int64_t disp, uint8_t size) {
+	return {.kind = X86Operand::Kind::mem, .size = size, .reg = base, .value = disp};
+}
+
+inline X86Operand x86_mem(uint8_t base, uint8_t index, uint8_t scale, int64_t disp, uint8_t size) {
+	return {.kind = X86Operand::Kind::mem, .size = size, .reg = base, .index = index, .scale = scale, .value = disp};
+}
+
+inline X86Operand x86_block(uint32_t block) {
+	return {.kind = X86Operand::Kind::block, .value = block};
+}
+
+inline X86Operand x86_msg(uint32_t msg) {
+	return {.kind = X86Operand::Kind::msg, .value = msg};
+}
+
+struct X86Inst
+{
+	X86Op op;
+	X86Operand dst;
+	X86Operand src;
+	X86Cond cond = X86Cond::e;
+	uint8_t imm = 0;                //third operand of pshufd, vinserti128 and vextracti128
+
+	inline bool reads_flags() const {
+		return op == X86Op::jcc || op == X86Op::set;
+	}
+
+	//NASM syntax, one line. vex prints the vector ops in their AVX form.
+	inline void print(std::ostream& out, bool vex = false) const {
+		static const char* ops[] = {"", "mov", "movzx", "lea", "add", "sub", "imul", "mul", "div", "xor", "and", "shl", "shr", "cmp", "test", "set", "j", "jmp", "syscall",
+		                            "movdqu", "movdqa", "movd", "movq", "pshufd", "punpcklbw", "punpcklwd", "punpckldq", "punpcklqdq", "paddb", "paddd", "psubb", "psubd",
+		                            "pand", "pxor", "pmuludq", "pmulld", "pslld", "psadbw", "vpbroadcastb", "vpbroadcastd", "vinserti128", "vextracti128", ""};
+		static const char* conds[] = {"e", "ne", "b", "ae", "a", "be", "l", "ge", "g", "le"};
+
+		if (op == X86Op::label)
+		{
+			out << "block" << dst.value << ":\n";
+			return;
+		}
+
+		out << "    " << (vex && op >= X86Op::movdqu && op < X86Op::vpbroadcastb ? "v" : "") << ops[(int)op];
+		if (op == X86Op::set || op == X86Op::jcc)
+			out << conds[(int)cond];
+		if (dst.kind != X86Operand::Kind::none)
+		{
+			out << ' ';
+			print_operand(out, dst);
+		}
+		if (vex && destructive())
+		{
+			out << ", ";
+			print_operand(out, dst);
+		}
+		if (src.kind != X86Operand::Kind::none)
+		{
+			out << ", ";
+			print_operand(out, src);
+		}
+		if (op == X86Op::pshufd || op == X86Op::vinserti128 || op == X86Op::vextracti128)
+			out << ", " << (int)imm;
+		out << '\n';
+	}
+
+	static inline const char* reg_name(uint8_t reg, uint8_t size) {
+		static const char* vectors[][16] = {
+			{"xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15"},
+			{"ymm0", "ymm1", "ymm2", "ymm3", "ymm4", "ymm5", "ymm6", "ymm7", "ymm8", "ymm9", "ymm10", "ymm11", "ymm12", "ymm13", "ymm14", "ymm15"}
+		};
+		if (reg >= XMM0)
+			return vectors[size == 32][reg - XMM0];
+
+		static const char* names[][3] = {
+			{"rbx", "ebx", "bl"}, {"r8", "r8d", "r8b"}, {"r9", "r9d", "r9b"}, {"r10", "r10d", "r10b"},
+			{"r12", "r12d", "r12b"}, {"r13", "r13d", "r13b"}, {"r14", "r14d", "r14b"}, {"r15", "r15d", "r15b"},
+			{"rsi", "esi", "sil"}, {"rdi", "edi", "dil"}, {"rcx", "ecx", "cl"},
+			{"rax", "eax", "al"}, {"rdx", "edx", "dl"}, {"r11", "r11d", "r11b"}, {"rsp", "esp", "spl"}
+		};
+		return names[reg][size == 8 ? 0 : size == 4 ? 1 : 2];
+	}
+
+private:
+	//Two operand SSE2 ops whose AVX form takes dst as its first source too
+	inline bool destructive() const {
+		return (op >= X86Op::punpcklbw && op <= X86Op::psadbw) || op == X86Op::vinserti128;
+	}
+
+	inline void print_operand(std::ostream& out, const X86Operand& operand) const {
+		switch (operand.kind)
+		{
+			case X86Operand::Kind::reg:
+				out << reg_name(operand.reg, operand.size);
+				break;
+			case X86Operand::Kind::imm:
+				out << operand.value;
+				break;
+			case X86Operand::Kind::mem:
+				if (op != X86Op::lea && operand.size <= 8)
+					out << (operand.size == 1 ? "byte " : operand.size == 4 ? "dword " : "qword ");
+				out << '[' << reg_name(operand.reg, 8);
+				if (operand.index != NO_REG)
+					out << '+' << reg_name(operand.index, 8) << '*' << (int)operand.scale;
+				if (operand.value)
+					out << '+' << operand.value;
+				out << ']';
+				break;
+			case X86Operand::Kind::block:
+				out << "block" << operand.value;
+				break;
+			case X86Operand::Kind::msg:
+				out << "msg" << operand.value;
+				break;
+			case X86Operand::Kind::none:
+				break;
+		}
+	}
+};
@@ -3,50 +3,265 @@
 #include <fstream>
 #include <sstream>
 #include <optional>
+#include <string_view>
 #include <vector>
 
+#include "include/source.hpp"
 #include "include/generator.hpp"
+#include "include/resolver.hpp"
 #include "include/typecheck.hpp"
+#include "include/constfold.hpp"
+#include "include/dce.hpp"
+#include "include/frame.hpp"
+#include "include/gvn.hpp"
+#include "include/irbuilder.hpp"
+#include "include/licm.hpp"
+#include "include/peephole.hpp"
+#include "include/promote.hpp"
+#include "include/regalloc.hpp"
+#include "include/ssa.hpp"
+#include "include/strength.hpp"
+#include "include/vectorize.hpp"
+#include "include/emitter.hpp"
+#include "include/pipeline.hpp"
+#include "include/report.hpp"
 
-int main(int argc, char** argv) {
-	
-	if (argc < 2) {std::cerr << "No source file detected"; return 1;}
-	
-	std::string source;
-	{	
-		std::ifstream sourcefile(argv[1]);
-		std::stringstream buffer;
-		buffer << sourcefile.rdbuf();
-		source = buffer.str();
+//Parses, checks and emits one top level statement at a time, memory tracks the largest statement
+void compile_stream(SourceFile& source, std::ostream& out, TimeReport& report) {
+	Interner interner;
+	Tokenizer tokenizer(source.view(), interner);
+	Parser parser(tokenizer, source.view());
+	Resolver resolver(source.view());
+	TypeChecker checker(resolver.get_symbols(), source.view());
+	ConstFolder folder(resolver.get_symbols(), source.view());
+	Generator generator(parser.ast(), resolver.get_symbols(), source.view());
+
+	report.begin("stream");
+	generator.gen_begin();
+	while (auto stmt = parser.parse_next())
+	{
+		resolver.resolve(parser.ast(), stmt.value());
+		checker.check(parser.ast(), stmt.value());
+		folder.fold(parser.ast(), stmt.value());
+		generator.gen_top(stmt.value());
+		generator.flush(out);
+		source.release(parser.consumed_offset());
+
+		report.counters.nodes += parser.ast()->size();
 	}
+	generator.gen_end(out);
+	report.end();
+
+	report.counters.tokens = tokenizer.pulled();
+	report.counters.ast_bytes = parser.ast()->bytes();
+}
+
+void compile_pipeline(SourceFile& source, std::ostream& out, TimeReport& report) {
+	Pipeline pipeline(source);
+
+	report.begin("pipeline");
+	pipeline.run(out);
+	report.end();
+
+	const Pipeline::Stats stats = pipeline.stats();
+	report.counters.tokens = stats.tokens;
+	report.counters.nodes = stats.nodes;
+	report.counters.ast_bytes = stats.ast_bytes;
+}
+
+//Where the whole program compile reports what it did, each one only when set
+struct CompileReports
+{
+	std::ostream* ir = nullptr;             //dump of the IR
+	std::ostream* spills = nullptr;         //what the register allocator did
+	std::ostream* peephole = nullptr;       //hits per peephole rule
+};
+
+//vector_bytes: 16 for SSE2 vector loops, 32 for AVX2
+void compile(SourceFile& source, std::ostream& out, const CompileReports& reports, uint32_t vector_bytes, TimeReport& report) {
+	Interner interner;
 
-	Tokenizer tokenizer(std::move(source));	
+	report.begin("tokenize");
+	Tokenizer tokenizer(source.view(), interner);
 	std::vector<Token> tokens = tokenizer.tokenize();
+	report.end();
+	report.counters.tokens = tokens.size();
 
-	Parser parser(std::move(tokens));
-	std::optional<NodeProg*> prog = parser.parse_prog();
+	report.begin("parse");
+	Parser parser(std::move(tokens), source.view());
+	std::optional<Ast*> prog = parser.parse_prog();
 	if (!prog.has_value())
 	{
 		std::cerr << "Failed to parse\n";
 		exit(EXIT_FAILURE);
 	}
-		
-	TypeChecker checker;
-	checker.check(prog.value());	
+	report.end();
+	report.counters.nodes = prog.value()->size();
+	report.counters.ast_bytes = prog.value()->bytes();
+
+	report.begin("resolve");
+	Resolver resolver(source.view());
+	resolver.resolve(prog.value());
+	report.end();
+
+	report.begin("check");
+	TypeChecker checker(resolver.get_symbols(), source.view());
+	checker.check(prog.value());
+	report.end();
+
+	report.begin("fold");
+	ConstFolder folder(resolver.get_symbols(), source.view());
+	folder.fold(prog.value());
+	report.end();
+
+	report.begin("lower");
+	IrBuilder builder(prog.value(), resolver.get_symbols(), source.view());
+	IrProgram ir = builder.build();
+	StrengthReducer reducer(ir);
+	reducer.reduce();
+	report.end();
+
+	report.begin("regalloc");
+	SlotPromoter promoter(ir);
+	const uint32_t promoted = promoter.promote();
+	DeadCodeEliminator eliminator(ir);
+	eliminator.eliminate();
+	SsaBuilder ssa(ir);
+	ssa.build();
+	ValueNumbering numbering(ir, ssa);
+	numbering.number();
+	ssa.destroy();
+	LoopHoister hoister(ir);
+	hoister.hoist();
+	LoopVectorizer vectorizer(ir, vector_bytes);
+	vectorizer.vectorize();
+	FrameLayout frame(ir);
+	frame.layout();
+	RegAlloc alloc(ir);
+	alloc.allocate();
+	report.end();
+
+	if (reports.ir)
+		ir.dump(*reports.ir);
+	if (reports.spills)
+		alloc.report(*reports.spills, promoted);
 
-	Generator generator(std::move(prog.value()), checker.get_sym_table());
+	report.begin("generate");
+	Emitter emitter(ir, alloc);
+	std::vector<X86Inst> code = emitter.select();
+	report.end();
+
+	report.begin("peephole");
+	Peephole peephole;
+	peephole.run(code);
+	report.end();
+
+	if (reports.peephole)
+		peephole.report(*reports.peephole);
+
+	report.begin("write");
+	out << emitter.print(code);
+	out.flush();
+	report.end();
+}
+
+int main(int argc, char** argv) {
+
+	const char* path = nullptr;
+	bool stream = false;
+	bool pipeline = false;
+	bool time_report = false;
+	bool time_report_json = false;
+	bool emit_ir = false;
+	bool spill_report = false;
+	bool peephole_report = false;
+	bool avx2 = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string_view arg = argv[i];
+		if (arg == "--stream")
+			stream = true;
+		else if (arg == "--pipeline")
+			pipeline = true;
+		else if (arg == "--time-report")
+			time_report = true;
+		else if (arg == "--time-report=json")
+			time_report_json = true;
+		else if (arg == "--emit-ir")
+			emit_ir = true;
+		else if (arg == "--spill-report")
+			spill_report = true;
+		else if (arg == "--peephole-report")
+			peephole_report = true;
+		else if (arg == "--avx2")
+			avx2 = true;
+		else if (!path)
+			path = argv[i];
+		else {
+			std::cerr << "Unknown argument: '" << arg << "'\n";
+			return 1;
+		  }
+	}
+
+	if (!path) {std::cerr << "No source file detected"; return 1;}
+	if (emit_ir && (stream || pipeline)) {std::cerr << "--emit-ir needs the whole program, not --stream or --pipeline\n"; return 1;}
+	if ((spill_report || peephole_report) && (stream || pipeline)) {std::cerr << "--spill-report and --peephole-report need the whole program, not --stream or --pipeline\n"; return 1;}
+	if (avx2 && (stream || pipeline)) {std::cerr << "--avx2 needs the whole program, not --stream or --pipeline\n"; return 1;}
+
+	TimeReport report;
+
+	report.begin("read");
+	SourceFile source(path);
+	report.end();
 
 	{
 		std::ofstream file ("bin/out.asm");
-		file << generator.gen_prog();
+		if (pipeline)
+		{
+			report.counters.mode = "pipeline";
+			compile_pipeline(source, file, report);
+		}
+		else if (stream)
+		{
+			report.counters.mode = "stream";
+			compile_stream(source, file, report);
+		}
+		else
+		{
+			CompileReports reports;
+			std::ofstream ir_file;
+			if (emit_ir)
+			{
+				ir_file.open("bin/out.ir");
+				reports.ir = &ir_file;
+			}
+			if (spill_report)
+				reports.spills = &std::cerr;
+			if (peephole_report)
+				reports.peephole = &std::cerr;
+
+			compile(source, file, reports, avx2 ? 32 : 16, report);
+		  }
 	}
+	report.counters.asm_bytes = TimeReport::file_size("bin/out.asm");
 
+	report.begin("assemble");
 	system("nasm -f elf64 bin/out.asm");
+	report.end();
+
+	report.begin("link");
 	system("ld bin/out.o -o bin/out");
+	report.end();
+	report.counters.binary_bytes = TimeReport::file_size("bin/out");
+
 	system("rm bin/out.o");
 
+	if (time_report)
+		report.print(std::cerr);
+	if (time_report_json)
+		report.print_json(std::cout);
 
 	return 0;
 
 }
-